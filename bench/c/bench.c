@@ -0,0 +1,151 @@
+/*
+ * Micro-benchmarks of the core arithmetic in `src/arith.h`, reported in
+ * nanoseconds per element. Each primitive is run over a large array of
+ * inputs several times, and the fastest run is reported.
+ *
+ * Usage: `make bench`, or `./warp-bench [reps]`.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "arith.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SIZE (1 << 22)
+
+static int n_reps = 10;
+
+// Results are accumulated here, so the work can't be optimized away
+static volatile int64_t sink;
+
+// The divisor is read at run time, like `every` is in the kernels
+static volatile int divisor = 7;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char* name, double best) {
+  printf("%-40s %8.3f ns/elt\n", name, best / SIZE * 1e9);
+}
+
+#define BENCH(NAME, SETUP, BODY) do {                                  \
+  double best = 1e300;                                                 \
+                                                                       \
+  for (int rep = 0; rep < n_reps; ++rep) {                             \
+    SETUP;                                                             \
+    int64_t acc = 0;                                                   \
+    const double start = now();                                        \
+                                                                       \
+    for (int i = 0; i < SIZE; ++i) {                                   \
+      BODY;                                                            \
+    }                                                                  \
+                                                                       \
+    const double elapsed = now() - start;                              \
+    sink += acc;                                                       \
+                                                                       \
+    if (elapsed < best) {                                              \
+      best = elapsed;                                                  \
+    }                                                                  \
+  }                                                                    \
+                                                                       \
+  report(NAME, best);                                                  \
+} while (0)
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    n_reps = atoi(argv[1]);
+
+    if (n_reps <= 0) {
+      fprintf(stderr, "`reps` must be a positive integer.\n");
+      return 1;
+    }
+  }
+
+  int* ints = malloc(SIZE * sizeof(int));
+  int* days = malloc(SIZE * sizeof(int));
+  int* far_days = malloc(SIZE * sizeof(int));
+  double* seconds = malloc(SIZE * sizeof(double));
+
+  if (ints == NULL || days == NULL || far_days == NULL || seconds == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return 1;
+  }
+
+  uint64_t state = UINT64_C(88172645463325252);
+
+  for (int i = 0; i < SIZE; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    ints[i] = (int) (uint32_t) state;
+
+    // Days between 1900 and 2100, and far outside of the fast range
+    days[i] = (int) (state % 73049) - 25567;
+    far_days[i] = WARP_SMALLEST_DAYS_FROM_EPOCH + (int) (state % 1000000000);
+
+    // Seconds between 1900 and 2100, with microseconds
+    seconds[i] = (double) ((int64_t) (state % UINT64_C(6311433600000000)) - INT64_C(2208988800000000)) / 1e6;
+  }
+
+  const struct warp_divider divider = make_divider(divisor);
+  const int y = divisor;
+
+  BENCH("floor_divmod()", (void) 0, {
+    int quot;
+    int rem;
+    floor_divmod(ints[i], y, &quot, &rem);
+    acc += quot + rem;
+  });
+
+  BENCH("divider_div()", (void) 0, {
+    acc += divider_div(ints[i], &divider);
+  });
+
+  BENCH("divider_divmod()", (void) 0, {
+    int quot;
+    int rem;
+    divider_divmod(ints[i], &divider, &quot, &rem);
+    acc += quot + rem;
+  });
+
+  BENCH("days_to_components(), 1900-2100", (void) 0, {
+    const struct warp_components components = days_to_components(days[i]);
+    acc += components.year_offset + components.month + components.day + components.yday;
+  });
+
+  BENCH("days_to_components_fast(), 1900-2100", (void) 0, {
+    const struct warp_components components = days_to_components_fast(days[i]);
+    acc += components.year_offset + components.month + components.day + components.yday;
+  });
+
+  BENCH("days_to_components_cycles(), 1900-2100", (void) 0, {
+    const struct warp_components components = days_to_components_cycles(days[i]);
+    acc += components.year_offset + components.month + components.day + components.yday;
+  });
+
+  BENCH("days_to_components(), far from epoch", (void) 0, {
+    const struct warp_components components = days_to_components(far_days[i]);
+    acc += components.year_offset + components.month + components.day + components.yday;
+  });
+
+  BENCH("guarded_floor()", (void) 0, {
+    acc += guarded_floor(seconds[i]);
+  });
+
+  BENCH("guarded_floor_to_millisecond()", (void) 0, {
+    acc += guarded_floor_to_millisecond(seconds[i]);
+  });
+
+  free(ints);
+  free(days);
+  free(far_days);
+  free(seconds);
+
+  return 0;
+}
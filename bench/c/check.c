@@ -0,0 +1,420 @@
+/*
+ * Exhaustive equivalence checks of the core arithmetic in `src/arith.h`
+ * against simple reference implementations.
+ *
+ * - `floor_divmod()` and `divider_div()` against 64-bit floor division, for
+ *   every `int` and the divisors used by the calendar arithmetic. Other
+ *   divisors are checked on a sample of `int`s.
+ *
+ * - `days_to_components()` against a day by day walk of the proleptic
+ *   Gregorian calendar, for every `int` `n`. The walk is seeded, and
+ *   regularly re-checked, with Hinnant's `civil_from_days()` in 64-bit
+ *   arithmetic. `days_from_civil64()` and `days_to_components64()` are
+ *   checked against the same walk, and `days_to_components_fast()` is checked
+ *   against `days_to_components_cycles()` over its whole range.
+ *
+ * - `days_to_components64()` against `civil_from_days()` on random days of
+ *   every magnitude up to `WARP_WIDE_LARGEST_DAYS_FROM_EPOCH`, and on every
+ *   day around its edges.
+ *
+ * - `dbl_guarded_floor()` and `dbl_guarded_floor_to_millisecond()` bit for
+ *   bit against the reference formulas, on every millisecond in a range
+ *   around the epoch, and on random doubles of every magnitude.
+ *
+ * To check a faster implementation of one of these, swap it into
+ * `src/arith.h` or `src/arith.c` and run `make check`. Pass `quick` to only
+ * check a sample of each range.
+ */
+
+#include "arith.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+static int failures = 0;
+static int64_t stride = 1;
+
+#define MAX_REPORTED_FAILURES 20
+
+static void fail(const char* what, const char* fmt, ...) {
+  ++failures;
+
+  if (failures > MAX_REPORTED_FAILURES) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+
+  printf("  FAIL %s: ", what);
+  vprintf(fmt, args);
+  printf("\n");
+
+  va_end(args);
+}
+
+// -----------------------------------------------------------------------------
+
+static void ref_floor_divmod(int64_t x, int64_t y, int64_t* p_quot, int64_t* p_rem) {
+  int64_t quot = x / y;
+  int64_t rem = x % y;
+
+  if (rem != 0 && ((rem < 0) != (y < 0))) {
+    --quot;
+    rem += y;
+  }
+
+  *p_quot = quot;
+  *p_rem = rem;
+}
+
+static void check_divisor(int y, int64_t x_stride) {
+  const bool positive = y > 0;
+  struct warp_divider divider;
+
+  if (positive) {
+    divider = make_divider(y);
+  }
+
+  for (int64_t x = INT_MIN; x <= INT_MAX; x += x_stride) {
+    // The quotient overflows
+    if (x == INT_MIN && y == -1) {
+      continue;
+    }
+
+    int64_t ref_quot;
+    int64_t ref_rem;
+    ref_floor_divmod(x, y, &ref_quot, &ref_rem);
+
+    int quot;
+    int rem;
+    floor_divmod((int) x, y, &quot, &rem);
+
+    if (quot != ref_quot || rem != ref_rem) {
+      fail("floor_divmod", "x = %lld, y = %d", (long long) x, y);
+    }
+
+    if (positive && divider_div((int) x, &divider) != ref_quot) {
+      fail("divider_div", "x = %lld, y = %d", (long long) x, y);
+    }
+  }
+
+  // Always include the edges
+  if (x_stride > 1) {
+    const int edges[] = {INT_MIN, INT_MIN + 1, -1, 0, 1, INT_MAX - 1, INT_MAX};
+
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+      if (edges[i] == INT_MIN && y == -1) {
+        continue;
+      }
+
+      int64_t ref_quot;
+      int64_t ref_rem;
+      ref_floor_divmod(edges[i], y, &ref_quot, &ref_rem);
+
+      int quot;
+      int rem;
+      floor_divmod(edges[i], y, &quot, &rem);
+
+      if (quot != ref_quot || rem != ref_rem) {
+        fail("floor_divmod", "x = %d, y = %d", edges[i], y);
+      }
+
+      if (positive && divider_div(edges[i], &divider) != ref_quot) {
+        fail("divider_div", "x = %d, y = %d", edges[i], y);
+      }
+    }
+  }
+}
+
+static void check_division(void) {
+  printf("Checking floor_divmod() and divider_div()\n");
+
+  // Every `int` for the divisors of the calendar arithmetic
+  const int exhaustive[] = {4, 100, 400, 365, 1461, 36524, 146097};
+
+  for (size_t i = 0; i < sizeof(exhaustive) / sizeof(exhaustive[0]); ++i) {
+    check_divisor(exhaustive[i], stride);
+  }
+
+  // A sample of `int`s for everything else, including negative divisors
+  const int sampled[] = {
+    1, 2, 3, 5, 7, 12, 24, 28, 30, 52, 60, 1000, 3600, 86400,
+    1 << 20, (1 << 30) + 1, INT_MAX - 1, INT_MAX,
+    -1, -2, -7, -400, -86400, INT_MIN + 1, INT_MIN
+  };
+
+  for (size_t i = 0; i < sizeof(sampled) / sizeof(sampled[0]); ++i) {
+    check_divisor(sampled[i], 65537 * stride);
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+static bool is_leap_year(int64_t year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static const int DAYS_IN_MONTH[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+static int days_in_month(int64_t year, int month) {
+  return DAYS_IN_MONTH[month] + (month == 1 && is_leap_year(year));
+}
+
+// A date in the proleptic Gregorian calendar, with a 0-based month and day
+struct civil {
+  int64_t year;
+  int month;
+  int day;
+  int yday;
+};
+
+// http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+static struct civil civil_from_days(int64_t n) {
+  n += 719468;
+
+  const int64_t era = (n >= 0 ? n : n - 146096) / 146097;
+  const int64_t doe = n - era * 146097;
+  const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const int64_t mp = (5 * doy + 2) / 153;
+  const int64_t day = doy - (153 * mp + 2) / 5;
+  const int64_t month = mp < 10 ? mp + 3 : mp - 9;
+  const int64_t year = yoe + era * 400 + (month <= 2);
+
+  struct civil out;
+  out.year = year;
+  out.month = (int) month - 1;
+  out.day = (int) day;
+  out.yday = 0;
+
+  for (int i = 0; i < out.month; ++i) {
+    out.yday += days_in_month(year, i);
+  }
+
+  out.yday += out.day;
+
+  return out;
+}
+
+static void civil_next(struct civil* p_civil) {
+  ++p_civil->day;
+  ++p_civil->yday;
+
+  if (p_civil->day < days_in_month(p_civil->year, p_civil->month)) {
+    return;
+  }
+
+  p_civil->day = 0;
+  ++p_civil->month;
+
+  if (p_civil->month < 12) {
+    return;
+  }
+
+  p_civil->month = 0;
+  p_civil->yday = 0;
+  ++p_civil->year;
+}
+
+static bool civil_equal(struct civil civil, struct warp_components components) {
+  return civil.year - 1970 == components.year_offset &&
+    civil.month == components.month &&
+    civil.day == components.day &&
+    civil.yday == components.yday;
+}
+
+static bool civil_equal64(struct civil civil, struct warp_components64 components) {
+  return civil.year - 1970 == components.year_offset &&
+    civil.month == components.month &&
+    civil.day == components.day &&
+    civil.yday == components.yday;
+}
+
+static bool components_equal(struct warp_components x, struct warp_components y) {
+  return x.year_offset == y.year_offset &&
+    x.month == y.month &&
+    x.day == y.day &&
+    x.yday == y.yday;
+}
+
+static void check_components(void) {
+  printf("Checking days_to_components() and days_from_civil64()\n");
+
+  struct civil civil = civil_from_days(INT_MIN);
+
+  for (int64_t n = INT_MIN; n <= INT_MAX; ++n) {
+    if ((n & 0xFFFF) == 0) {
+      struct civil expected = civil_from_days(n);
+
+      if (expected.year != civil.year ||
+          expected.month != civil.month ||
+          expected.day != civil.day ||
+          expected.yday != civil.yday) {
+        fail("calendar walk", "n = %lld", (long long) n);
+        civil = expected;
+      }
+    }
+
+    // Always include the days below `WARP_SMALLEST_DAYS_FROM_EPOCH`
+    if (n < WARP_SMALLEST_DAYS_FROM_EPOCH || (n - INT_MIN) % stride == 0) {
+      if (!civil_equal(civil, days_to_components((int) n))) {
+        fail("days_to_components", "n = %lld", (long long) n);
+      }
+
+      if (!civil_equal64(civil, days_to_components64(n))) {
+        fail("days_to_components64", "n = %lld", (long long) n);
+      }
+
+      if (days_from_civil64(civil.year, civil.month + 1, civil.day + 1) != n) {
+        fail("days_from_civil64", "n = %lld", (long long) n);
+      }
+    }
+
+    civil_next(&civil);
+  }
+
+  printf("Checking days_to_components_fast() against days_to_components_cycles()\n");
+
+  for (int64_t n = WARP_FAST_SMALLEST_DAYS_FROM_EPOCH; n <= WARP_FAST_LARGEST_DAYS_FROM_EPOCH; n += stride) {
+    const struct warp_components fast = days_to_components_fast((int) n);
+    const struct warp_components cycles = days_to_components_cycles((int) n);
+
+    if (!components_equal(fast, cycles)) {
+      fail("days_to_components_fast", "n = %lld", (long long) n);
+    }
+  }
+}
+
+static uint64_t xorshift(void);
+
+static void check_components64_range(int64_t from, int64_t to) {
+  struct civil civil = civil_from_days(from);
+
+  for (int64_t n = from; n <= to; ++n) {
+    if (!civil_equal64(civil, days_to_components64(n))) {
+      fail("days_to_components64", "n = %lld", (long long) n);
+    }
+
+    civil_next(&civil);
+  }
+}
+
+static void check_components64(void) {
+  printf("Checking days_to_components64()\n");
+
+  // Every day within a few 400 year cycles of both edges
+  const int64_t edge = 4 * 146097;
+
+  check_components64_range(WARP_WIDE_SMALLEST_DAYS_FROM_EPOCH, WARP_WIDE_SMALLEST_DAYS_FROM_EPOCH + edge);
+  check_components64_range(WARP_WIDE_LARGEST_DAYS_FROM_EPOCH - edge, WARP_WIDE_LARGEST_DAYS_FROM_EPOCH);
+
+  // Random days with every magnitude in range
+  const int64_t n_random = 200000000 / stride;
+
+  for (int64_t i = 0; i < n_random; ++i) {
+    const uint64_t bits = xorshift();
+    const int magnitude = (int) (bits % 36);
+    int64_t n = (int64_t) ((bits >> 8) & ((UINT64_C(1) << magnitude) - 1));
+
+    if (bits & 128) {
+      n = -n;
+    }
+
+    const struct civil expected = civil_from_days(n);
+    const struct warp_components64 actual = days_to_components64(n);
+
+    if (!civil_equal64(expected, actual)) {
+      fail("days_to_components64", "n = %lld", (long long) n);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+// The documented formulas, see `src/arith.h`
+static double ref_guarded_floor(double x) {
+  x *= 1e6;
+  x = trunc(x);
+  x *= 1e-6;
+  x += 1e-7;
+  return floor(x);
+}
+
+static double ref_guarded_floor_to_millisecond(double x) {
+  x *= 1e6;
+  x = trunc(x);
+  x *= 1e-6;
+  x += 1e-7;
+  x *= 1e3;
+  return floor(x);
+}
+
+static void check_guarded_floor_elt(double x) {
+  const double expected = ref_guarded_floor(x);
+  const double actual = dbl_guarded_floor(x);
+
+  if (memcmp(&expected, &actual, sizeof(double)) != 0 || guarded_floor(x) != (int64_t) expected) {
+    fail("guarded_floor", "x = %a", x);
+  }
+
+  const double expected_ms = ref_guarded_floor_to_millisecond(x);
+  const double actual_ms = dbl_guarded_floor_to_millisecond(x);
+
+  if (memcmp(&expected_ms, &actual_ms, sizeof(double)) != 0 ||
+      guarded_floor_to_millisecond(x) != (int64_t) expected_ms) {
+    fail("guarded_floor_to_millisecond", "x = %a", x);
+  }
+}
+
+static uint64_t xorshift_state = UINT64_C(88172645463325252);
+
+static uint64_t xorshift(void) {
+  xorshift_state ^= xorshift_state << 13;
+  xorshift_state ^= xorshift_state >> 7;
+  xorshift_state ^= xorshift_state << 17;
+  return xorshift_state;
+}
+
+static void check_guarded_floor(void) {
+  printf("Checking dbl_guarded_floor() and dbl_guarded_floor_to_millisecond()\n");
+
+  // Every millisecond within ~1 day of the epoch, and both ways of writing it
+  const int64_t ms_range = 100000000;
+
+  for (int64_t k = -ms_range; k <= ms_range; k += stride) {
+    check_guarded_floor_elt((double) k / 1000);
+    check_guarded_floor_elt((double) k * 0.001);
+  }
+
+  // Random seconds with every magnitude up to 2^52, and random fractions
+  const int64_t n_random = 200000000 / stride;
+
+  for (int64_t i = 0; i < n_random; ++i) {
+    const uint64_t bits = xorshift();
+    const int exponent = (int) (bits % 53);
+    const double magnitude = ldexp((double) (bits >> 11) / 9007199254740992.0, exponent);
+    check_guarded_floor_elt((bits & 1024) ? -magnitude : magnitude);
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "quick") == 0) {
+    stride = 997;
+  }
+
+  check_division();
+  check_components();
+  check_components64();
+  check_guarded_floor();
+
+  if (failures > 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,313 @@
+#include "arith.h"
+
+/*
+ * The calendar arithmetic that the distance kernels are built on. Nothing in
+ * this file, or in `arith.h`, depends on R, so it can be compiled and checked
+ * on its own, see `bench/c/`.
+ */
+
+// -----------------------------------------------------------------------------
+
+static const int DAYS_IN_MONTH[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+static const int DAYS_UP_TO_MONTH[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+#define YEAR_OFFSET_FROM_EPOCH 30
+
+#define MONTH_ADJUSTMENT_TO_0_TO_11_RANGE -1
+#define DAY_ADJUSTMENT_TO_0_TO_30_RANGE -1
+
+// unclass(as.Date("2001-01-01"))
+#define DAYS_FROM_2001_01_01_TO_EPOCH -11323
+
+#define DAYS_IN_1_YEAR_CYCLE 365
+
+// 4 * DAYS_IN_1_YEAR_CYCLE + 1
+#define DAYS_IN_4_YEAR_CYCLE 1461
+
+// 25 * DAYS_IN_4_YEAR_CYCLE - 1
+#define DAYS_IN_100_YEAR_CYCLE 36524
+
+// 4 * DAYS_IN_100_YEAR_CYCLE + 1
+#define DAYS_IN_400_YEAR_CYCLE 146097
+
+// Constants of `days_to_components_fast()`. `n` is shifted by 82
+// 400 year cycles, plus the 719468 days from 0000-03-01 to 1970-01-01.
+#define FAST_YEARS_SHIFT (82 * 400)
+#define FAST_DAYS_SHIFT (82 * DAYS_IN_400_YEAR_CYCLE + 719468)
+
+// `4 * (n + FAST_DAYS_SHIFT) + 3` must fit in a `uint32_t`, so the fast
+// algorithm is limited to `[-FAST_DAYS_SHIFT, 1073741823 - FAST_DAYS_SHIFT]`.
+// These are `WARP_FAST_SMALLEST_DAYS_FROM_EPOCH` and
+// `WARP_FAST_LARGEST_DAYS_FROM_EPOCH`.
+
+// ceil(2^32 / (DAYS_IN_4_YEAR_CYCLE / 4))
+#define FAST_YEAR_MULTIPLIER 2939745
+
+// Month and day of month from the day of the (March based) year are the
+// quotient and remainder of `(2141 * day_of_year + 197913) / 2^16`
+#define FAST_MONTH_MULTIPLIER 2141
+#define FAST_MONTH_OFFSET 197913
+
+// Days in March to December, and in January and February of a common year
+#define DAYS_FROM_MARCH_TO_JANUARY 306
+#define DAYS_FROM_JANUARY_TO_MARCH 59
+
+// Second arguments are `ceil(log2(<cycle>))`
+static const struct warp_divider divider_days_in_1_year_cycle = WARP_DIVIDER(DAYS_IN_1_YEAR_CYCLE, 9);
+static const struct warp_divider divider_days_in_4_year_cycle = WARP_DIVIDER(DAYS_IN_4_YEAR_CYCLE, 11);
+static const struct warp_divider divider_days_in_100_year_cycle = WARP_DIVIDER(DAYS_IN_100_YEAR_CYCLE, 16);
+static const struct warp_divider divider_days_in_400_year_cycle = WARP_DIVIDER(DAYS_IN_400_YEAR_CYCLE, 18);
+
+// -----------------------------------------------------------------------------
+
+/*
+ * `days_to_components()`
+ *
+ * Uses `days_to_components_fast()` for any realistic `n`, and falls back to
+ * `days_to_components_cycles()` outside of its range. The few days below
+ * `WARP_SMALLEST_DAYS_FROM_EPOCH`, where the cycles would overflow, go
+ * through `days_to_components64()`.
+ *
+ * @param n
+ *   A 0-based number of days since 1970-01-01, i.e. unclass(<Date>). Any
+ *   `int`.
+ */
+
+// [[ include("arith.h") ]]
+struct warp_components days_to_components(int n) {
+  if (WARP_FAST_SMALLEST_DAYS_FROM_EPOCH <= n && n <= WARP_FAST_LARGEST_DAYS_FROM_EPOCH) {
+    return days_to_components_fast(n);
+  }
+
+  if (n >= WARP_SMALLEST_DAYS_FROM_EPOCH) {
+    return days_to_components_cycles(n);
+  }
+
+  // The year offset of any `int` fits in an `int`
+  const struct warp_components64 wide = days_to_components64(n);
+
+  struct warp_components components;
+  components.year_offset = (int) wide.year_offset;
+  components.month = wide.month;
+  components.day = wide.day;
+  components.yday = wide.yday;
+
+  return components;
+}
+
+// -----------------------------------------------------------------------------
+
+/*
+ * `days_to_components64()`
+ *
+ * The calendar repeats every 400 years, which are exactly
+ * `DAYS_IN_400_YEAR_CYCLE` days. `n` is split into a whole number of cycles
+ * and a day in `[0, DAYS_IN_400_YEAR_CYCLE)`, which is in 1970-2369 and is
+ * always in range of `days_to_components_fast()`. The cycles are added back
+ * to the year offset.
+ *
+ * @param n
+ *   A 0-based number of days since 1970-01-01. Must be within `INT64_MAX / 2`
+ *   of 0, which includes the days of any `int64_t` number of seconds.
+ */
+
+// [[ include("arith.h") ]]
+struct warp_components64 days_to_components64(int64_t n) {
+  const int64_t n_400_year_cycles = floor_div64(n, DAYS_IN_400_YEAR_CYCLE);
+  const int day = (int) (n - n_400_year_cycles * DAYS_IN_400_YEAR_CYCLE);
+
+  const struct warp_components components = days_to_components_fast(day);
+
+  struct warp_components64 out;
+  out.year_offset = components.year_offset + n_400_year_cycles * 400;
+  out.month = components.month;
+  out.day = components.day;
+  out.yday = components.yday;
+
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+/*
+ * `days_to_components_cycles()`
+ *
+ * Python's datetime `_ord2ymd()`
+ * https://github.com/python/cpython/blob/b0d4949f1fb04f83691e10a5453d1e10e4598bb9/Lib/datetime.py#L87
+ *
+ * Many of the comments are copied over from this function.
+ */
+
+/*
+ * The challenging thing about finding the year/month is the presence of leap
+ * years. The leap year pattern repeats exactly every 400 years. We adjust the
+ * date to be the number of days since 2001-01-01 because that is the closest
+ * 400 year boundary to 1970-01-01. This is important because it gives us the
+ * maximum amount of values before hitting any integer overflow.
+ *
+ * The basic strategy is to find the closest 400 year boundary at or _before_
+ * `n`, and then work with the offset (in number of days) from that boundary to
+ * `n`. It is further divided into 100 / 4 / 1 year cycles, which reduce `n`
+ * down to the "day of the year" in the year of interest. We compute the actual
+ * year from the number of 400 / 100 / 4 / 1 year cycles, with an adjustment if
+ * we are exactly on a 4 or 400 year boundary. Then the rest of the code is
+ * dedicated to finding the month. There is an "educated guess" of
+ * `(n + 50) >> 5` that gets us either exactly right or 1 too far. If we are too
+ * far, we adjust it back by 1 month.
+ */
+
+// [[ include("arith.h") ]]
+struct warp_components days_to_components_cycles(int n) {
+  struct warp_components components;
+
+  int n_1_year_cycles;
+  int n_4_year_cycles;
+  int n_100_year_cycles;
+  int n_400_year_cycles;
+
+  // Adjust to be days since 2001-01-01 (so `n = 0 == 2001-01-01`)
+  n = DAYS_FROM_2001_01_01_TO_EPOCH + n;
+
+  divider_divmod(n, &divider_days_in_400_year_cycle, &n_400_year_cycles, &n);
+  divider_divmod(n, &divider_days_in_100_year_cycle, &n_100_year_cycles, &n);
+  divider_divmod(n, &divider_days_in_4_year_cycle, &n_4_year_cycles, &n);
+  divider_divmod(n, &divider_days_in_1_year_cycle, &n_1_year_cycles, &n);
+
+  int year = 1 +
+    n_400_year_cycles * 400 +
+    n_100_year_cycles * 100 +
+    n_4_year_cycles * 4 +
+    n_1_year_cycles;
+
+  // Edge case adjustment required if we are on the border of a
+  // 4 year or 400 year cycle boundary (i.e. `n = -1L`)
+  if (n_1_year_cycles == 4 || n_100_year_cycles == 4) {
+    components.year_offset = (year - 1) + YEAR_OFFSET_FROM_EPOCH;
+    components.month = 12 + MONTH_ADJUSTMENT_TO_0_TO_11_RANGE;
+    components.day = 31 + DAY_ADJUSTMENT_TO_0_TO_30_RANGE;
+    components.yday = 365;
+    return components;
+  }
+
+  components.yday = n;
+
+  bool is_leap_year = (n_1_year_cycles == 3) &&
+    (n_4_year_cycles != 24 || n_100_year_cycles == 3);
+
+  // Gets us either exactly right, or 1 month too far
+  int month = (n + 50) >> 5;
+
+  // Number of days up to this month, computed using our `month` guess
+  int preceding = DAYS_UP_TO_MONTH[month - 1] + (is_leap_year && month > 2);
+
+  // If the number of `preceding` days is greater than the `n` yday
+  // position in the year, then we obviously went too far. So subtract 1
+  // month and recompute the number of days up to the (now correct) month.
+  if (preceding > n) {
+    --month;
+    preceding -= DAYS_IN_MONTH[month - 1] + (is_leap_year && month == 2);
+  }
+
+  // Substract `position in year` - `days up to current month` = `day in month`
+  // It will be 0-30 based already
+  n -= preceding;
+
+  components.year_offset = year + YEAR_OFFSET_FROM_EPOCH;
+  components.month = month + MONTH_ADJUSTMENT_TO_0_TO_11_RANGE;
+  components.day = n;
+
+  return components;
+}
+
+
+/*
+ * `days_to_components_fast()`
+ *
+ * Neri and Schneider's Euclidean affine function algorithm, which
+ * decomposes `n` without branches and with every division by a constant.
+ * "Euclidean affine functions and their application to calendar algorithms"
+ * https://doi.org/10.1002/spe.3172
+ *
+ * It works in a "computational calendar" where years start on March 1st, so
+ * the leap day is always the last day of the year. `n` is shifted by a whole
+ * number of 400 year cycles so that it is positive and unsigned arithmetic can
+ * be used, which bounds the range of `n` that this works for to
+ * `[WARP_FAST_SMALLEST_DAYS_FROM_EPOCH, WARP_FAST_LARGEST_DAYS_FROM_EPOCH]`,
+ * i.e. from around year -32800 to year 2.9 million.
+ */
+
+// [[ include("arith.h") ]]
+struct warp_components days_to_components_fast(int n) {
+  struct warp_components components;
+
+  const uint32_t days = (uint32_t) (n + FAST_DAYS_SHIFT);
+
+  // 400 year cycles, and the day of the century
+  const uint32_t n_1 = 4 * days + 3;
+  const uint32_t century = n_1 / DAYS_IN_400_YEAR_CYCLE;
+  const uint32_t day_of_century = n_1 % DAYS_IN_400_YEAR_CYCLE / 4;
+
+  // Year of the century, and the day of the (March based) year
+  const uint32_t n_2 = 4 * day_of_century + 3;
+  const uint64_t p_2 = (uint64_t) FAST_YEAR_MULTIPLIER * n_2;
+  const uint32_t year_of_century = (uint32_t) (p_2 >> 32);
+  const uint32_t day_of_year = (uint32_t) p_2 / FAST_YEAR_MULTIPLIER / 4;
+
+  // Month and day of the (March based) year
+  const uint32_t n_3 = FAST_MONTH_MULTIPLIER * day_of_year + FAST_MONTH_OFFSET;
+  const uint32_t month = n_3 >> 16;
+  const uint32_t day = (n_3 & 0xFFFF) / FAST_MONTH_MULTIPLIER;
+
+  // Map back to January based years
+  const bool january_or_february = day_of_year >= DAYS_FROM_MARCH_TO_JANUARY;
+
+  const int year = (int) (100 * century + year_of_century) -
+    FAST_YEARS_SHIFT +
+    january_or_february;
+
+  const bool is_leap_year = (year & 3) == 0 && ((year % 100) != 0 || (year & 15) == 0);
+
+  components.year_offset = year - 1970;
+  components.month = (int) (january_or_february ? month - 12 : month) + MONTH_ADJUSTMENT_TO_0_TO_11_RANGE;
+  components.day = (int) day;
+  components.yday = january_or_february ?
+    (int) (day_of_year - DAYS_FROM_MARCH_TO_JANUARY) :
+    (int) day_of_year + DAYS_FROM_JANUARY_TO_MARCH + is_leap_year;
+
+  return components;
+}
+
+// -----------------------------------------------------------------------------
+
+// From Howard Hinnant's `days_from_civil()`
+// [[ include("arith.h") ]]
+int64_t days_from_civil64(int64_t year, int month, int day) {
+  year -= month <= 2;
+
+  int64_t era = floor_div64(year, 400);
+  int64_t year_of_era = year - era * 400;
+  int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+  return era * 146097 + day_of_era - 719468;
+}
+
+#undef YEAR_OFFSET_FROM_EPOCH
+
+#undef MONTH_ADJUSTMENT_TO_0_TO_11_RANGE
+#undef DAY_ADJUSTMENT_TO_0_TO_30_RANGE
+
+#undef DAYS_FROM_2001_01_01_TO_EPOCH
+
+#undef DAYS_IN_1_YEAR_CYCLE
+#undef DAYS_IN_4_YEAR_CYCLE
+#undef DAYS_IN_100_YEAR_CYCLE
+#undef DAYS_IN_400_YEAR_CYCLE
+
+#undef FAST_YEARS_SHIFT
+#undef FAST_DAYS_SHIFT
+#undef FAST_YEAR_MULTIPLIER
+#undef FAST_MONTH_MULTIPLIER
+#undef FAST_MONTH_OFFSET
+#undef DAYS_FROM_MARCH_TO_JANUARY
+#undef DAYS_FROM_JANUARY_TO_MARCH
@@ -0,0 +1,316 @@
+#ifndef WARP_ARITH_H
+#define WARP_ARITH_H
+
+/*
+ * The core arithmetic of the distance kernels: floor division, the
+ * conversion of days to calendar components, and the guarded flooring of
+ * seconds. None of it depends on R, so it can be compiled and checked on its
+ * own, see `bench/c/`. Errors are the responsibility of the callers, which
+ * check the preconditions documented here.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+
+// -----------------------------------------------------------------------------
+
+/*
+ * The arithmetic of `divmod()`, see `divmod.c`. `y` must not be `0`.
+ */
+static inline void floor_divmod(int x, int y, int* p_quot, int* p_rem) {
+  int quot = x / y;
+  int rem = (int)(x - (unsigned int)quot * y);
+
+  if (rem && ((y ^ rem) < 0)) {
+    rem += y;
+    --quot;
+  }
+
+  *p_quot = quot;
+  *p_rem = rem;
+}
+
+// -----------------------------------------------------------------------------
+
+/*
+ * A "fast divider" for floor division of an `int` by a fixed positive
+ * divisor, using a multiplication by a precomputed "magic number" and a
+ * shift in place of a hardware division.
+ *
+ * @member divisor
+ *   The divisor, `d`, in `[1, INT_MAX]`.
+ * @member shift
+ *   `31 + L`, where `L = ceil(log2(d))`.
+ * @member multiplier
+ *   `ceil(2^shift / d)`, at most `2^32 + 1`.
+ *
+ * See `divmod.c` for why this is exact for every `int`.
+ */
+struct warp_divider {
+  int divisor;
+  int shift;
+  uint64_t multiplier;
+};
+
+struct warp_divider new_divider(int divisor);
+
+// For compile time constant divisors. `L` must be `ceil(log2(D))`.
+#define WARP_DIVIDER(D, L) {                                           \
+  (D),                                                                 \
+  31 + (L),                                                            \
+  ((UINT64_C(1) << (31 + (L))) + (D) - 1) / (D)                        \
+}
+
+/*
+ * Equivalent to `int_div(x, p_divider->divisor)`.
+ *
+ * `x ^ sign` is `x` when `x >= 0`, and `-x - 1` when `x < 0`, which is always
+ * in `[0, INT_MAX]`. For negative `x`, `floor(x / d) = -floor((-x - 1) / d) - 1`,
+ * which is the same `^ sign` again.
+ */
+static inline int divider_div(int x, const struct warp_divider* p_divider) {
+  const uint32_t sign = (uint32_t) -(x < 0);
+  const uint32_t n = (uint32_t) x ^ sign;
+
+  const uint32_t quot = (uint32_t) ((n * p_divider->multiplier) >> p_divider->shift);
+
+  return (int) (quot ^ sign);
+}
+
+// Equivalent to `divmod(x, p_divider->divisor, p_quot, p_rem)`
+static inline void divider_divmod(int x,
+                                  const struct warp_divider* p_divider,
+                                  int* p_quot,
+                                  int* p_rem) {
+  const int quot = divider_div(x, p_divider);
+
+  *p_quot = quot;
+  *p_rem = (int) (x - (int64_t) quot * p_divider->divisor);
+}
+
+// Divisors of the Gregorian leap year rule
+static const struct warp_divider divider_4 = WARP_DIVIDER(4, 2);
+static const struct warp_divider divider_100 = WARP_DIVIDER(100, 7);
+static const struct warp_divider divider_400 = WARP_DIVIDER(400, 9);
+
+// The arithmetic of `new_divider()`. `divisor` must be positive.
+static inline struct warp_divider make_divider(int divisor) {
+  int log2_divisor = 0;
+
+  while ((INT64_C(1) << log2_divisor) < divisor) {
+    ++log2_divisor;
+  }
+
+  struct warp_divider out = WARP_DIVIDER(divisor, log2_divisor);
+
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+/*
+ * @member year_offset
+ *   The year offset. The number of years since 1970.
+ * @member month
+ *   The month. Mapped to the range of 0-11, where 0 is January.
+ * @member day
+ *   The day of month. Mapped to the range of 0-30.
+ * @member yday
+ *   The day of the year. Mapped to the range of 0-365.
+ */
+struct warp_components {
+  int year_offset;
+  int month;
+  int day;
+  int yday;
+};
+
+// The smallest `n` that `days_to_components_cycles()` can convert without
+// overflow. `-.Machine$integer.max` minus `unclass(as.Date("2001-01-01"))`.
+#define WARP_SMALLEST_DAYS_FROM_EPOCH (INT_MIN + 1 + 11323)
+
+// The range of `n` that `days_to_components_fast()` can convert
+#define WARP_FAST_SMALLEST_DAYS_FROM_EPOCH (-12699422)
+#define WARP_FAST_LARGEST_DAYS_FROM_EPOCH 1061042401
+
+struct warp_components days_to_components(int n);
+
+// The two algorithms used by `days_to_components()`. Exposed for checking
+// them against each other.
+struct warp_components days_to_components_cycles(int n);
+struct warp_components days_to_components_fast(int n);
+
+/*
+ * `days_to_components()` for days that don't fit in an `int`, like the
+ * truncated value of a double Date. The year offset is 64-bit, the other
+ * components are the same.
+ */
+struct warp_components64 {
+  int64_t year_offset;
+  int month;
+  int day;
+  int yday;
+};
+
+/*
+ * The range of `n` that the 64-bit day arithmetic supports, about 94 million
+ * years either side of 1970. The difference of any two days within it, in
+ * milliseconds, fits in an `int64_t`, so every period can be computed exactly.
+ * Doubles with `fabs(x) < WARP_WIDE_DAYS_LIMIT` truncate into it. Past it, the
+ * calendar periods of double Dates are computed in double arithmetic, and the
+ * sub-daily periods are `NA`.
+ */
+#define WARP_WIDE_DAYS_LIMIT 34359738368.0
+#define WARP_WIDE_LARGEST_DAYS_FROM_EPOCH (INT64_C(34359738368) - 1)
+#define WARP_WIDE_SMALLEST_DAYS_FROM_EPOCH (-WARP_WIDE_LARGEST_DAYS_FROM_EPOCH)
+
+struct warp_components64 days_to_components64(int64_t n);
+
+// Floor division of `int64_t`. `y` must be positive.
+static inline int64_t floor_div64(int64_t x, int64_t y) {
+  int64_t quot = x / y;
+
+  if ((x % y != 0) && ((x < 0) != (y < 0))) {
+    --quot;
+  }
+
+  return quot;
+}
+
+// Is the civil `year` a leap year?
+static inline bool is_leap_year64(int64_t year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+// The number of days in the 1-based `month` of the civil `year`
+static inline int days_in_month64(int64_t year, int month) {
+  static const int days_in_month[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  return days_in_month[month - 1] + (month == 2 && is_leap_year64(year));
+}
+
+/*
+ * The calendar repeats every 400 years, which are exactly
+ * `WARP_DAYS_IN_400_YEARS` days. Splits `n`, a whole and finite number of days
+ * since 1970-01-01, into a number of cycles and a day in
+ * `[0, WARP_DAYS_IN_400_YEARS)`, which is in 1970-2369. `fmod()` is exact, so
+ * the day is exact for any `n`, even past the range of `int64_t`.
+ */
+#define WARP_DAYS_IN_400_YEARS 146097
+
+static inline int dbl_days_to_cycle_day(double n, double* p_cycles) {
+  double day = fmod(n, WARP_DAYS_IN_400_YEARS);
+
+  if (day < 0) {
+    day += WARP_DAYS_IN_400_YEARS;
+  }
+
+  *p_cycles = (n - day) / WARP_DAYS_IN_400_YEARS;
+
+  return (int) day;
+}
+
+/*
+ * The inverse of `days_to_components()`, the number of days since 1970-01-01
+ * of the civil date `year-month-day`, with 1-based `month` and `day`. `month`
+ * must be in `[1, 12]`, and `year` within a few billion years of 1970. A `day`
+ * past the end of the month counts into the following months.
+ */
+int64_t days_from_civil64(int64_t year, int month, int day);
+
+// -----------------------------------------------------------------------------
+
+/*
+ * `double` values are represented with 64 bits:
+ * - 1 sign bit
+ * - 11 exponent bits
+ * - 52 significand bits
+ *
+ * The 52 significand bits are the ones that store the true value, this
+ * corresponds to about ~16 significand digits, with everything after
+ * that being garbage.
+ *
+ * Internally doubles are represented with scientific notation to put them in
+ * the exponent-significand representation. So the following date, which
+ * is represented as a double, really looks like this in scientific notation:
+ *
+ * unclass(as.POSIXct("2011-05-01 17:55:23.123456"))
+ * =
+ * 1304286923.1234560013
+ * =
+ * 1.3042869231234560013e+09
+ *                 ^ 16th digit
+ *
+ * Because only ~16 digits are stable, this is where we draw the line on
+ * assuming that the user might have some valuable information stored here.
+ * This corresponds to microseconds. Sure, we could use
+ * a date that has less digits before the decimal to get more fractional
+ * precision (see below) but most dates are in this form: 10 digits before
+ * the decimal representing whole seconds, meaning 6 stable digits after it.
+ *
+ * The other part of the story is that not all floating point numbers can be
+ * represented exactly in binary. For example:
+ *
+ * unclass(as.POSIXct("1969-12-31 23:59:59.998", "UTC"))
+ * =
+ * -0.002000000000002444267
+ *
+ * Because of this, `floor()` will give results that (to us) are incorrect if
+ * we were to try and floor to milliseconds. We would first times by 1000 to
+ * get milliseconds of `-2.000000000002444267`, and then `floor()` would give
+ * us -3, not -2 which is the correct group.
+ *
+ * To get around this, we need to guard against this floating point error. The
+ * best way I can come up with is to add a small value before flooring, which
+ * would push us into the -1.9999999 range, which would floor correctly.
+ *
+ * I chose the value of just beyond 1 microsecond because that is generally
+ * where the 17th digit falls for most dates
+ * (10 digits of whole seconds, 5 of stable fractional seconds). This seems to
+ * work well for the millisecond grouping, and we apply it to anywhere that
+ * uses seconds "just in case", but it is hard to come up with tests for them.
+ */
+
+static inline double dbl_guarded_floor(double x) {
+  // Scale and trim past microseconds
+  x *= 1e6;
+  x = trunc(x);
+  x *= 1e-6;
+
+  // Add guard and floor
+  x += 1e-7;
+  x = floor(x);
+
+  return x;
+}
+
+static inline int64_t guarded_floor(double x) {
+  return (int64_t) dbl_guarded_floor(x);
+}
+
+// The order here is slightly different. We want to convert
+// seconds to milliseconds while still guarding correctly.
+// - Scale and trim past microseconds
+// - Guard while still at the second level to put it on the right decimal
+// - Now scale to millisecond and floor
+
+static inline double dbl_guarded_floor_to_millisecond(double x) {
+  // Scale and trim past microseconds
+  x *= 1e6;
+  x = trunc(x);
+  x *= 1e-6;
+
+  // Add guard, scale to milliseconds, and floor
+  x += 1e-7;
+  x *= 1e3;
+  x = floor(x);
+
+  return x;
+}
+
+static inline int64_t guarded_floor_to_millisecond(double x) {
+  return (int64_t) dbl_guarded_floor_to_millisecond(x);
+}
+
+#endif
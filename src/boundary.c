@@ -1,65 +1,67 @@
 #include "warp.h"
 #include "utils.h"
+#include "kernel.h"
+#include "buffer.h"
+#include "compact.h"
 
 // -----------------------------------------------------------------------------
 
-static SEXP warp_boundary_impl(SEXP stops);
+static SEXP warp_boundary_impl(const struct warp_kernel* p_kernel, bool sorted, int threads);
+
+/*
+ * `warp_boundary()` scans the distances for stops once, with the same fused
+ * scan that `warp_change()` uses, and then builds both the `start` and `stop`
+ * columns from the buffer of stops. When they are regularly spaced, they are
+ * made compact without ever allocating them in full, otherwise they are
+ * allocated with their exact size.
+ */
 
 // [[ include("warp.h") ]]
-SEXP warp_boundary(SEXP x, enum warp_period_type type, int every, SEXP origin) {
-  static const bool last = true;
-  static const bool endpoint = false;
+SEXP warp_boundary(SEXP x,
+                   enum warp_period_type type,
+                   int every,
+                   SEXP origin,
+                   bool sorted,
+                   int threads) {
+  struct warp_kernel kernel;
+
+  // Protect the shelter owning the kernel's memory
+  PROTECT(warp_kernel_init(&kernel, x, type, every, origin, warp_clock_elapsed));
 
-  SEXP stops = PROTECT(warp_change(x, type, every, origin, last, endpoint));
-  SEXP out = warp_boundary_impl(stops);
+  sorted = sorted && warp_kernel_is_sorted(&kernel, x);
+
+  SEXP out = warp_boundary_impl(&kernel, sorted, threads);
 
   UNPROTECT(1);
   return out;
 }
 
 // [[ register() ]]
-SEXP warp_warp_boundary(SEXP x, SEXP period, SEXP every, SEXP origin) {
+SEXP warp_warp_boundary(SEXP x, SEXP period, SEXP every, SEXP origin, SEXP sorted, SEXP threads) {
   enum warp_period_type type = as_period_type(period);
   int every_ = pull_every(every);
-  return warp_boundary(x, type, every_, origin);
+  bool sorted_ = pull_sorted(sorted);
+  int threads_ = pull_threads(threads);
+  return warp_boundary(x, type, every_, origin, sorted_, threads_);
 }
 
 // -----------------------------------------------------------------------------
 
 static SEXP new_boundary_df(R_len_t size);
-static SEXP compute_starts(SEXP x, R_xlen_t size);
-
-static SEXP warp_boundary_impl(SEXP stops) {
-  R_xlen_t size = Rf_xlength(stops);
-
-  SEXP out = PROTECT(new_boundary_df(size));
-
-  SET_VECTOR_ELT(out, 0, compute_starts(stops, size));
-  SET_VECTOR_ELT(out, 1, stops);
 
-  UNPROTECT(1);
-  return out;
-}
-
-static SEXP compute_starts(SEXP x, R_xlen_t size) {
-  if (size == 0) {
-    return Rf_allocVector(REALSXP, 0);
-  }
-
-  if (size == 1) {
-    return Rf_ScalarReal(1);
-  }
+static SEXP warp_boundary_impl(const struct warp_kernel* p_kernel, bool sorted, int threads) {
+  static const bool last = true;
+  static const bool endpoint = false;
 
-  double* p_x = REAL(x);
+  struct warp_buffer stops;
+  warp_buffer_init(&stops);
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
+  warp_change_scan(p_kernel, last, endpoint, sorted, threads, &stops);
 
-  p_out[0] = 1;
+  SEXP out = PROTECT(new_boundary_df(stops.size));
 
-  for (R_xlen_t i = 1; i < size; ++i) {
-    p_out[i] = p_x[i - 1] + 1;
-  }
+  SET_VECTOR_ELT(out, 0, warp_compact_buffer(&stops, true));
+  SET_VECTOR_ELT(out, 1, warp_compact_buffer(&stops, false));
 
   UNPROTECT(1);
   return out;
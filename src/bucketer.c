@@ -0,0 +1,215 @@
+#include "warp.h"
+#include "utils.h"
+#include "kernel.h"
+#include "buffer.h"
+
+// -----------------------------------------------------------------------------
+
+/*
+ * A bucketer computes the distances of an append-only series that arrives in
+ * chunks. It remembers the period, `every`, and `origin` that it was created
+ * with, along with the number of elements and the last distance that it has
+ * seen, so each chunk only costs time proportional to its own size.
+ *
+ * Along with the distances of a chunk, the bucketer reports the locations of
+ * the first value of each new group, relative to the start of the series.
+ * The last distance is carried over from the previous chunk, like
+ * `warp_change_scan()` carries `previous` from block to block, so a group
+ * that continues across a chunk boundary isn't reported twice.
+ *
+ * The bucketer is an external pointer to a `struct warp_bucketer` that lives
+ * in a raw vector. The raw vector, `origin`, and the time zone of the series
+ * are kept alive in the protected field of the pointer.
+ *
+ * @member type, every
+ *   The period and the number of periods to group together.
+ * @member class_type
+ *   The class of the first chunk. POSIXlt is recorded as POSIXct. Every chunk
+ *   must have the same class, and the same time zone.
+ * @member size
+ *   The number of elements seen so far.
+ * @member previous
+ *   The distance of the last element seen so far, if `size > 0`.
+ */
+struct warp_bucketer {
+  enum warp_period_type type;
+  int every;
+  enum warp_class_type class_type;
+  R_xlen_t size;
+  double previous;
+};
+
+#define BUCKETER_RAW 0
+#define BUCKETER_ORIGIN 1
+#define BUCKETER_TIME_ZONE 2
+
+// [[ register() ]]
+SEXP warp_warp_bucketer(SEXP period, SEXP every, SEXP origin) {
+  enum warp_period_type type = as_period_type(period);
+  int every_ = pull_every(every);
+
+  SEXP raw = PROTECT(Rf_allocVector(RAWSXP, sizeof(struct warp_bucketer)));
+
+  struct warp_bucketer* p_bucketer = (struct warp_bucketer*) RAW(raw);
+  p_bucketer->type = type;
+  p_bucketer->every = every_;
+  p_bucketer->class_type = warp_class_unknown;
+  p_bucketer->size = 0;
+  p_bucketer->previous = NA_REAL;
+
+  SEXP prot = PROTECT(Rf_allocVector(VECSXP, 3));
+  SET_VECTOR_ELT(prot, BUCKETER_RAW, raw);
+  SET_VECTOR_ELT(prot, BUCKETER_ORIGIN, origin);
+  SET_VECTOR_ELT(prot, BUCKETER_TIME_ZONE, R_NilValue);
+
+  SEXP out = PROTECT(R_MakeExternalPtr(p_bucketer, R_NilValue, prot));
+  Rf_setAttrib(out, R_ClassSymbol, classes_warp_bucketer);
+
+  UNPROTECT(3);
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+static struct warp_bucketer* bucketer_deref(SEXP bucketer);
+static enum warp_class_type bucketer_check_chunk(SEXP bucketer, const struct warp_bucketer* p_bucketer, SEXP x);
+static SEXP new_bucketer_result(SEXP distance, SEXP change);
+
+// [[ register() ]]
+SEXP warp_warp_bucketer_push(SEXP bucketer, SEXP x, SEXP threads) {
+  int threads_ = pull_threads(threads);
+
+  struct warp_bucketer* p_bucketer = bucketer_deref(bucketer);
+  enum warp_class_type class_type = bucketer_check_chunk(bucketer, p_bucketer, x);
+
+  SEXP origin = VECTOR_ELT(R_ExternalPtrProtected(bucketer), BUCKETER_ORIGIN);
+
+  struct warp_kernel kernel;
+
+  // Protect the shelter owning the kernel's memory
+  PROTECT(warp_kernel_init(&kernel, x, p_bucketer->type, p_bucketer->every, origin, warp_clock_elapsed));
+
+  SEXP distance = PROTECT(warp_distance_eager(&kernel, warp_output_double, threads_));
+  const double* p_distance = REAL_RO(distance);
+
+  const R_xlen_t size = kernel.size;
+  const R_xlen_t offset = p_bucketer->size;
+
+  struct warp_buffer locations;
+  warp_buffer_init(&locations);
+
+  double previous = p_bucketer->previous;
+  R_xlen_t i = 0;
+
+  // The first element of the series always starts a group
+  if (offset == 0 && size > 0) {
+    warp_buffer_push(&locations, 1);
+    previous = p_distance[0];
+    i = 1;
+  }
+
+  for (; i < size; ++i) {
+    const double current = p_distance[i];
+
+    // `NA_real_` distances are equal to each other, like in `warp_change()`
+    if (current == previous || (isnan(current) && isnan(previous))) {
+      continue;
+    }
+
+    warp_buffer_push(&locations, offset + i + 1);
+    previous = current;
+  }
+
+  SEXP change = PROTECT(Rf_allocVector(REALSXP, locations.size));
+  warp_buffer_copy(&locations, REAL(change));
+
+  // Only update the state once the chunk is known to be valid
+  if (p_bucketer->class_type == warp_class_unknown) {
+    p_bucketer->class_type = class_type;
+    SET_VECTOR_ELT(R_ExternalPtrProtected(bucketer), BUCKETER_TIME_ZONE, Rf_mkString(get_time_zone(x)));
+  }
+
+  p_bucketer->size = offset + size;
+  p_bucketer->previous = previous;
+
+  SEXP out = new_bucketer_result(distance, change);
+
+  UNPROTECT(3);
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+static struct warp_bucketer* bucketer_deref(SEXP bucketer) {
+  if (TYPEOF(bucketer) != EXTPTRSXP || !Rf_inherits(bucketer, "warp_bucketer")) {
+    r_error("bucketer_deref", "`bucketer` must be created by `warp_bucketer()`.");
+  }
+
+  struct warp_bucketer* p_bucketer = (struct warp_bucketer*) R_ExternalPtrAddr(bucketer);
+
+  // The address is lost when the bucketer is serialized
+  if (p_bucketer == NULL) {
+    r_error("bucketer_deref", "`bucketer` is no longer valid. Was it saved and reloaded?");
+  }
+
+  return p_bucketer;
+}
+
+// Returns the class of `x`, with POSIXlt recorded as POSIXct
+static enum warp_class_type bucketer_check_chunk(SEXP bucketer, const struct warp_bucketer* p_bucketer, SEXP x) {
+  enum warp_class_type class_type = time_class_type(x);
+
+  if (class_type == warp_class_unknown) {
+    r_error("bucketer_check_chunk", "`x` must inherit from 'Date', 'POSIXct', or 'POSIXlt'.");
+  }
+
+  if (class_type == warp_class_posixlt) {
+    class_type = warp_class_posixct;
+  }
+
+  if (p_bucketer->class_type == warp_class_unknown) {
+    return class_type;
+  }
+
+  if (class_type != p_bucketer->class_type) {
+    r_error(
+      "bucketer_check_chunk",
+      "`x` must have the same class as the first chunk pushed to the bucketer."
+    );
+  }
+
+  SEXP prot = R_ExternalPtrProtected(bucketer);
+
+  const char* time_zone = get_time_zone(x);
+  const char* bucketer_time_zone = CHAR(STRING_ELT(VECTOR_ELT(prot, BUCKETER_TIME_ZONE), 0));
+
+  if (!str_equal(time_zone, bucketer_time_zone)) {
+    r_error(
+      "bucketer_check_chunk",
+      "`x` must have the same time zone as the first chunk pushed to the bucketer, '%s', not '%s'.",
+      bucketer_time_zone,
+      time_zone
+    );
+  }
+
+  return class_type;
+}
+
+static SEXP new_bucketer_result(SEXP distance, SEXP change) {
+  SEXP out = PROTECT(Rf_allocVector(VECSXP, 2));
+  SET_VECTOR_ELT(out, 0, distance);
+  SET_VECTOR_ELT(out, 1, change);
+
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 2));
+  SET_STRING_ELT(names, 0, Rf_mkChar("distance"));
+  SET_STRING_ELT(names, 1, Rf_mkChar("change"));
+
+  Rf_setAttrib(out, R_NamesSymbol, names);
+
+  UNPROTECT(2);
+  return out;
+}
+
+#undef BUCKETER_RAW
+#undef BUCKETER_ORIGIN
+#undef BUCKETER_TIME_ZONE
@@ -0,0 +1,125 @@
+#include "buffer.h"
+#include "utils.h"
+#include <string.h> // For memcpy()
+
+// -----------------------------------------------------------------------------
+
+#define WARP_BUFFER_FIRST_PAGE_SIZE 1024
+
+// [[ include("buffer.h") ]]
+void warp_buffer_init(struct warp_buffer* p_buffer) {
+  p_buffer->size = 0;
+  p_buffer->n_pages = 0;
+  p_buffer->p_page = NULL;
+  p_buffer->page_size = 0;
+  p_buffer->page_capacity = 0;
+}
+
+// Only called when the current page is full (or there is no page yet)
+
+// [[ include("buffer.h") ]]
+void warp_buffer_grow(struct warp_buffer* p_buffer) {
+  if (p_buffer->n_pages == WARP_BUFFER_MAX_PAGES) {
+    r_error("warp_buffer_grow", "Internal error: Buffer has reached its maximum size.");
+  }
+
+  R_xlen_t capacity;
+
+  if (p_buffer->n_pages == 0) {
+    capacity = WARP_BUFFER_FIRST_PAGE_SIZE;
+  } else {
+    capacity = p_buffer->page_capacity * 2;
+  }
+
+  double* p_page = (double*) R_alloc(capacity, sizeof(double));
+
+  p_buffer->pages[p_buffer->n_pages] = p_page;
+  ++p_buffer->n_pages;
+
+  p_buffer->p_page = p_page;
+  p_buffer->page_size = 0;
+  p_buffer->page_capacity = capacity;
+}
+
+/*
+ * Copies all `p_buffer->size` values of the buffer, in order, to `p_out`
+ */
+
+// [[ include("buffer.h") ]]
+void warp_buffer_copy(const struct warp_buffer* p_buffer, double* p_out) {
+  R_xlen_t capacity = WARP_BUFFER_FIRST_PAGE_SIZE;
+
+  for (int i = 0; i < p_buffer->n_pages; ++i) {
+    const bool last = i == p_buffer->n_pages - 1;
+    const R_xlen_t size = last ? p_buffer->page_size : capacity;
+
+    memcpy(p_out, p_buffer->pages[i], size * sizeof(double));
+
+    p_out += size;
+    capacity *= 2;
+  }
+}
+
+// Returns value `i` of the buffer. Only meant for a handful of values, since
+// it walks the pages.
+
+// [[ include("buffer.h") ]]
+double warp_buffer_get(const struct warp_buffer* p_buffer, R_xlen_t i) {
+  R_xlen_t capacity = WARP_BUFFER_FIRST_PAGE_SIZE;
+  int page = 0;
+
+  while (i >= capacity) {
+    i -= capacity;
+    capacity *= 2;
+    ++page;
+  }
+
+  return p_buffer->pages[page][i];
+}
+
+/*
+ * Are the values in `[from, to)` of the buffer the arithmetic sequence
+ * `first + i * step`, where `i` is the position in the buffer? `first` and
+ * `step` are taken from the values at `from` and `from + 1`, and are returned
+ * through `p_first` and `p_step`. Requires `to - from >= 2`.
+ */
+
+// [[ include("buffer.h") ]]
+bool warp_buffer_is_arithmetic(const struct warp_buffer* p_buffer,
+                               R_xlen_t from,
+                               R_xlen_t to,
+                               double* p_first,
+                               double* p_step) {
+  const double step = warp_buffer_get(p_buffer, from + 1) - warp_buffer_get(p_buffer, from);
+  const double first = warp_buffer_get(p_buffer, from) - from * step;
+
+  R_xlen_t capacity = WARP_BUFFER_FIRST_PAGE_SIZE;
+
+  // Position of the first value of the current page
+  R_xlen_t offset = 0;
+
+  for (int i = 0; i < p_buffer->n_pages && offset < to; ++i) {
+    const bool last = i == p_buffer->n_pages - 1;
+    const R_xlen_t size = last ? p_buffer->page_size : capacity;
+    const double* p_page = p_buffer->pages[i];
+
+    const R_xlen_t begin = from > offset ? from - offset : 0;
+    const R_xlen_t end = to - offset < size ? to - offset : size;
+
+    for (R_xlen_t j = begin; j < end; ++j) {
+      if (p_page[j] != first + (offset + j) * step) {
+        return false;
+      }
+    }
+
+    offset += size;
+    capacity *= 2;
+  }
+
+  *p_first = first;
+  *p_step = step;
+
+  return true;
+}
+
+#undef WARP_BUFFER_FIRST_PAGE_SIZE
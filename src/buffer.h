@@ -0,0 +1,68 @@
+#ifndef WARP_BUFFER_H
+#define WARP_BUFFER_H
+
+#define R_NO_REMAP
+#include <R.h>
+#include <Rinternals.h>
+#include <stdbool.h>
+
+// -----------------------------------------------------------------------------
+
+// Page `i` holds `WARP_BUFFER_FIRST_PAGE_SIZE * 2^i` values, so this is
+// enough pages for any vector that R can allocate
+#define WARP_BUFFER_MAX_PAGES 48
+
+/*
+ * A growable buffer of doubles, used to collect an unknown number of
+ * locations in a single pass so that the result can be allocated with its
+ * exact size afterwards.
+ *
+ * Values live in pages that double in capacity, so growing the buffer never
+ * copies the values that have already been pushed. Pages are allocated with
+ * `R_alloc()`, and are released when the `.Call()` returns.
+ *
+ * @member size
+ *   The total number of values in the buffer.
+ * @member n_pages
+ *   The number of allocated pages.
+ * @member p_page
+ *   The current page, which is always the last one.
+ * @member page_size
+ *   The number of values in the current page.
+ * @member page_capacity
+ *   The capacity of the current page.
+ * @member pages
+ *   All allocated pages. Every page but the last one is full.
+ */
+struct warp_buffer {
+  R_xlen_t size;
+  int n_pages;
+  double* p_page;
+  R_xlen_t page_size;
+  R_xlen_t page_capacity;
+  double* pages[WARP_BUFFER_MAX_PAGES];
+};
+
+void warp_buffer_init(struct warp_buffer* p_buffer);
+void warp_buffer_grow(struct warp_buffer* p_buffer);
+void warp_buffer_copy(const struct warp_buffer* p_buffer, double* p_out);
+double warp_buffer_get(const struct warp_buffer* p_buffer, R_xlen_t i);
+
+bool warp_buffer_is_arithmetic(const struct warp_buffer* p_buffer,
+                               R_xlen_t from,
+                               R_xlen_t to,
+                               double* p_first,
+                               double* p_step);
+
+static inline void warp_buffer_push(struct warp_buffer* p_buffer, double x) {
+  if (p_buffer->page_size == p_buffer->page_capacity) {
+    warp_buffer_grow(p_buffer);
+  }
+
+  p_buffer->p_page[p_buffer->page_size] = x;
+
+  ++p_buffer->page_size;
+  ++p_buffer->size;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "cache.h"
+#include "warp.h"
+#include "utils.h"
+#include <stdio.h> // For snprintf()
+#include <stdlib.h> // For getenv()
+
+/*
+ * A small per-session cache for the results of origin and time zone
+ * resolution, which otherwise have to be recomputed on every call, often by
+ * calling back into R or by reading zoneinfo files. For small inputs, that
+ * fixed cost dominates the time spent in the kernels.
+ *
+ * Entries are keyed by a string that identifies everything the result
+ * depends on, see `warp_cache_key()`. The cache holds a fixed number of
+ * entries, and the oldest entry is replaced when it is full.
+ *
+ * Because the value of the `TZ` environment variable is part of every key,
+ * changing `TZ` never returns stale results for local time. Everything else,
+ * such as updates to the zoneinfo database, requires an explicit
+ * `warp_clear_cache()`.
+ */
+
+#define WARP_CACHE_SIZE 64
+
+static SEXP cache_keys = NULL;
+static SEXP cache_values = NULL;
+static R_len_t cache_next = 0;
+
+/*
+ * `warp_cache_key()`
+ *
+ * Writes the key for the result of `kind` for `time_zone` and `value` to
+ * `p_key`, which must hold `WARP_CACHE_KEY_SIZE` characters. `value` is only
+ * relevant for results that depend on something other than the time zone,
+ * like the value of the origin, and should be `0` otherwise.
+ *
+ * Returns `false` if the key doesn't fit, in which case the result shouldn't
+ * be cached.
+ */
+
+// [[ include("cache.h") ]]
+bool warp_cache_key(char* p_key, const char* kind, const char* time_zone, double value) {
+  const char* tz_env = getenv("TZ");
+
+  int n = snprintf(
+    p_key,
+    WARP_CACHE_KEY_SIZE,
+    "%s|%s|%s|%.17g",
+    kind,
+    time_zone,
+    tz_env == NULL ? "<unset>" : tz_env,
+    value
+  );
+
+  return n >= 0 && n < WARP_CACHE_KEY_SIZE;
+}
+
+// Returns `NULL` (the C pointer, not `R_NilValue`) on a miss
+// [[ include("cache.h") ]]
+SEXP warp_cache_get(const char* key) {
+  for (R_len_t i = 0; i < WARP_CACHE_SIZE; ++i) {
+    SEXP elt = STRING_ELT(cache_keys, i);
+
+    if (elt != NA_STRING && str_equal(CHAR(elt), key)) {
+      return VECTOR_ELT(cache_values, i);
+    }
+  }
+
+  return NULL;
+}
+
+// Cached values are shared between calls, so they are marked as not mutable
+// [[ include("cache.h") ]]
+void warp_cache_set(const char* key, SEXP value) {
+  if (value != R_NilValue) {
+    MARK_NOT_MUTABLE(value);
+  }
+
+  SET_STRING_ELT(cache_keys, cache_next, Rf_mkChar(key));
+  SET_VECTOR_ELT(cache_values, cache_next, value);
+
+  cache_next = (cache_next + 1) % WARP_CACHE_SIZE;
+}
+
+static void cache_clear(void) {
+  for (R_len_t i = 0; i < WARP_CACHE_SIZE; ++i) {
+    SET_STRING_ELT(cache_keys, i, NA_STRING);
+    SET_VECTOR_ELT(cache_values, i, R_NilValue);
+  }
+
+  cache_next = 0;
+}
+
+// [[ register() ]]
+SEXP warp_warp_clear_cache(void) {
+  cache_clear();
+  return R_NilValue;
+}
+
+void warp_init_cache(void) {
+  cache_keys = Rf_allocVector(STRSXP, WARP_CACHE_SIZE);
+  R_PreserveObject(cache_keys);
+
+  cache_values = Rf_allocVector(VECSXP, WARP_CACHE_SIZE);
+  R_PreserveObject(cache_values);
+
+  cache_clear();
+}
+
+#undef WARP_CACHE_SIZE
@@ -0,0 +1,19 @@
+#ifndef WARP_CACHE_H
+#define WARP_CACHE_H
+
+#define R_NO_REMAP
+#include <R.h>
+#include <Rinternals.h>
+#include <stdbool.h>
+
+// -----------------------------------------------------------------------------
+
+// Large enough for any key built from a reasonable time zone name
+#define WARP_CACHE_KEY_SIZE 512
+
+bool warp_cache_key(char* p_key, const char* kind, const char* time_zone, double value);
+
+SEXP warp_cache_get(const char* key);
+void warp_cache_set(const char* key, SEXP value);
+
+#endif
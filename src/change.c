@@ -1,9 +1,28 @@
 #include "warp.h"
 #include "utils.h"
+#include "kernel.h"
+#include "buffer.h"
+#include "compact.h"
 
 // -----------------------------------------------------------------------------
 
-static SEXP warp_change_impl(SEXP x, bool last, bool endpoint);
+static SEXP warp_change_impl(const struct warp_kernel* p_kernel,
+                             bool last,
+                             bool endpoint,
+                             bool sorted,
+                             int threads);
+
+/*
+ * `warp_change()` never materializes the full distance vector. The kernel is
+ * run over fixed size blocks of `x`, and each block is scanned for changes
+ * before the next one is computed, so only a single block of distances (and
+ * the previous distance) is ever held in memory. Change points are collected
+ * in a growable buffer, so the result is allocated with its exact size. If
+ * they turn out to be regularly spaced, they are returned as a compact vector.
+ *
+ * With `sorted = TRUE`, change points are instead searched for, and only a
+ * small number of distances are computed per group. See `change_scan_sorted()`.
+ */
 
 // [[ include("warp.h") ]]
 SEXP warp_change(SEXP x,
@@ -11,9 +30,18 @@ SEXP warp_change(SEXP x,
                  int every,
                  SEXP origin,
                  bool last,
-                 bool endpoint) {
-  SEXP distances = PROTECT(warp_distance(x, period, every, origin));
-  SEXP out = warp_change_impl(distances, last, endpoint);
+                 bool endpoint,
+                 bool sorted,
+                 int threads) {
+  struct warp_kernel kernel;
+
+  // Protect the shelter owning the kernel's memory
+  PROTECT(warp_kernel_init(&kernel, x, period, every, origin, warp_clock_elapsed));
+
+  sorted = sorted && warp_kernel_is_sorted(&kernel, x);
+
+  SEXP out = warp_change_impl(&kernel, last, endpoint, sorted, threads);
+
   UNPROTECT(1);
   return out;
 }
@@ -24,88 +52,343 @@ SEXP warp_warp_change(SEXP x,
                       SEXP every,
                       SEXP origin,
                       SEXP last,
-                      SEXP endpoint) {
+                      SEXP endpoint,
+                      SEXP sorted,
+                      SEXP threads) {
   enum warp_period_type period_ = as_period_type(period);
   int every_ = pull_every(every);
   bool last_ = pull_last(last);
   bool endpoint_ = pull_endpoint(endpoint);
-  return warp_change(x, period_, every_, origin, last_, endpoint_);
+  bool sorted_ = pull_sorted(sorted);
+  int threads_ = pull_threads(threads);
+  return warp_change(x, period_, every_, origin, last_, endpoint_, sorted_, threads_);
+}
+
+// -----------------------------------------------------------------------------
+
+static bool int_is_sorted(const int* p_x, R_xlen_t size);
+static bool dbl_is_sorted(const double* p_x, R_xlen_t size);
+
+/*
+ * `warp_kernel_is_sorted()`
+ *
+ * Can `sorted = TRUE` be trusted for the input of `p_kernel`? Galloping only
+ * probes a few distances per group, so it can't notice unsorted input on its
+ * own. R's sortedness hint of `x` is used when the kernel reads `x` directly,
+ * otherwise the values that the kernel reads are checked with a single linear
+ * pass, which is much cheaper than computing the distances. Kernels reading
+ * POSIXlt fields can't be checked cheaply, so they are always scanned linearly.
+ *
+ * Leading integer `NA`s pass the check. They make the search give up
+ * immediately, which is still correct.
+ */
+
+// [[ include("kernel.h") ]]
+bool warp_kernel_is_sorted(const struct warp_kernel* p_kernel, SEXP x) {
+  const R_xlen_t size = p_kernel->size;
+
+  if (p_kernel->p_int != NULL) {
+#if (R_VERSION >= R_Version(3, 5, 0))
+    if (TYPEOF(x) == INTSXP && p_kernel->p_int == INTEGER_RO(x) && KNOWN_INCR(INTEGER_IS_SORTED(x))) {
+      return true;
+    }
+#endif
+    return int_is_sorted(p_kernel->p_int, size);
+  }
+
+  if (p_kernel->p_dbl != NULL) {
+#if (R_VERSION >= R_Version(3, 5, 0))
+    if (TYPEOF(x) == REALSXP && p_kernel->p_dbl == REAL_RO(x) && KNOWN_INCR(REAL_IS_SORTED(x))) {
+      return true;
+    }
+#endif
+    return dbl_is_sorted(p_kernel->p_dbl, size);
+  }
+
+  return false;
+}
+
+static bool int_is_sorted(const int* p_x, R_xlen_t size) {
+  for (R_xlen_t i = 1; i < size; ++i) {
+    if (p_x[i - 1] > p_x[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Written to also fail on `NA` and `NaN`
+static bool dbl_is_sorted(const double* p_x, R_xlen_t size) {
+  for (R_xlen_t i = 1; i < size; ++i) {
+    if (!(p_x[i - 1] <= p_x[i])) {
+      return false;
+    }
+  }
+
+  return true;
 }
 
 // -----------------------------------------------------------------------------
 
 static inline bool dbl_equal(const double current, const double previous);
 
-static SEXP warp_change_impl(SEXP x, bool last, bool endpoint) {
-  const R_xlen_t size = Rf_xlength(x);
+static SEXP warp_change_impl(const struct warp_kernel* p_kernel,
+                             bool last,
+                             bool endpoint,
+                             bool sorted,
+                             int threads) {
+  struct warp_buffer locations;
+  warp_buffer_init(&locations);
+
+  warp_change_scan(p_kernel, last, endpoint, sorted, threads, &locations);
+
+  return warp_compact_buffer(&locations, false);
+}
+
+// -----------------------------------------------------------------------------
+
+// The number of distances computed per block, per thread. Blocks of doubles
+// are 32kb per thread.
+#define WARP_CHANGE_BLOCK_SIZE 4096
+
+static R_xlen_t change_scan_sorted(const struct warp_kernel* p_kernel,
+                                   R_xlen_t adjustment,
+                                   double* p_previous,
+                                   struct warp_buffer* p_locations);
+
+static void change_scan_linear(const struct warp_kernel* p_kernel,
+                               R_xlen_t start,
+                               R_xlen_t adjustment,
+                               double previous,
+                               int threads,
+                               struct warp_buffer* p_locations);
+
+/*
+ * `warp_change_scan()`
+ *
+ * Pushes the 1-based change point locations of the distances computed by
+ * `p_kernel` to `p_locations`, in increasing order. Distances are computed
+ * one block at a time, so the full distance vector is never materialized.
+ *
+ * If `sorted` is `true`, the input is assumed to be sorted, and the change
+ * points are searched for rather than scanned for. Callers should only pass
+ * `true` when `warp_kernel_is_sorted()` agrees.
+ */
+
+// [[ include("kernel.h") ]]
+void warp_change_scan(const struct warp_kernel* p_kernel,
+                      bool last,
+                      bool endpoint,
+                      bool sorted,
+                      int threads,
+                      struct warp_buffer* p_locations) {
+  const R_xlen_t size = p_kernel->size;
 
   if (size == 0) {
-    return Rf_allocVector(REALSXP, 0);
+    return;
   }
   if (size == 1) {
-    return Rf_ScalarReal(1);
+    warp_buffer_push(p_locations, 1);
+    return;
   }
 
-  R_xlen_t count = 0;
-
-  // Maximum size is if all values are unique
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  const double* p_x = REAL(x);
+  // The first two and last two distances determine the endpoints
+  double head[2];
+  double tail[2];
+  p_kernel->fn(p_kernel, 0, 2, head);
+  p_kernel->fn(p_kernel, size - 2, 2, tail);
 
   if (last) {
     // If the location of the first changepoint
     // wasn't the first location in `x`, we need to forcibly add the endpoint
-    if (endpoint && dbl_equal(p_x[0], p_x[1])) {
-      p_out[count] = 1;
-      ++count;
+    if (endpoint && dbl_equal(head[0], head[1])) {
+      warp_buffer_push(p_locations, 1);
     }
   } else {
     // Always include first value when returning starts
-    p_out[count] = 1;
-    ++count;
+    warp_buffer_push(p_locations, 1);
   }
 
   const R_xlen_t adjustment = (R_xlen_t) !last;
 
-  double previous = p_x[0];
-
-  for (R_xlen_t i = 1; i < size; ++i) {
-    const double current = p_x[i];
-
-    if (dbl_equal(current, previous)) {
-      continue;
-    }
+  double previous = head[0];
+  R_xlen_t start = 0;
 
-    const R_xlen_t loc = i + adjustment;
-
-    p_out[count] = loc;
+  if (sorted) {
+    start = change_scan_sorted(p_kernel, adjustment, &previous, p_locations);
+  }
 
-    ++count;
-    previous = current;
+  if (start < size) {
+    change_scan_linear(p_kernel, start, adjustment, previous, threads, p_locations);
   }
 
   if (last) {
     // Always include last value when returning stops
-    p_out[count] = size;
-    ++count;
+    warp_buffer_push(p_locations, size);
   } else {
     // If the location of the last changepoint
     // wasn't the last location in `x`, we need to forcibly add the endpoint
-    if (endpoint && dbl_equal(p_x[size - 2], p_x[size - 1])) {
-      p_out[count] = size;
-      ++count;
+    if (endpoint && dbl_equal(tail[0], tail[1])) {
+      warp_buffer_push(p_locations, size);
     }
   }
+}
+
+// -----------------------------------------------------------------------------
+
+/*
+ * `change_scan_linear()`
+ *
+ * Computes the distances of `[start, size)` block by block, and pushes the
+ * locations where they differ from the `previous` distance.
+ */
+
+static void change_scan_linear(const struct warp_kernel* p_kernel,
+                               R_xlen_t start,
+                               R_xlen_t adjustment,
+                               double previous,
+                               int threads,
+                               struct warp_buffer* p_locations) {
+  const R_xlen_t size = p_kernel->size - start;
+
+  R_xlen_t block_size = WARP_CHANGE_BLOCK_SIZE * (R_xlen_t) (threads > 1 ? threads : 1);
+  if (block_size > size) {
+    block_size = size;
+  }
+
+  double* p_block = (double*) R_alloc(block_size, sizeof(double));
+
+  for (R_xlen_t from = 0; from < size; from += block_size) {
+    const R_xlen_t remaining = size - from;
+    const R_xlen_t n = remaining < block_size ? remaining : block_size;
+
+    warp_kernel_run(p_kernel, start + from, n, p_block, threads);
+
+    // The first element is only ever compared against
+    for (R_xlen_t j = (from == 0); j < n; ++j) {
+      const double current = p_block[j];
+
+      if (dbl_equal(current, previous)) {
+        continue;
+      }
+
+      const R_xlen_t loc = start + from + j + adjustment;
+
+      warp_buffer_push(p_locations, loc);
+
+      previous = current;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+static inline double kernel_elt(const struct warp_kernel* p_kernel, R_xlen_t i);
+
+/*
+ * `change_scan_sorted()`
+ *
+ * When `x` is sorted, the distances are non-decreasing, so the next change
+ * point after location `i` can be found by galloping: the distance is probed
+ * at `i + 1`, `i + 2`, `i + 4`, ... until it differs from the distance at `i`,
+ * and the first location where it changes is then binary searched for between
+ * the last two probes. Each group costs O(log(group size)) distances, so
+ * coarse periods over dense input never compute most of the distances.
+ *
+ * A missing distance, or one that is smaller than the current distance, means
+ * that the input wasn't sorted after all (or has trailing `NA`s). The search
+ * then gives up and returns the start of the current group, and the rest of
+ * the input is scanned linearly. Returns `size` if the search completed.
+ *
+ * On return, `p_previous` holds the distance at the returned location.
+ */
+
+static R_xlen_t change_scan_sorted(const struct warp_kernel* p_kernel,
+                                   R_xlen_t adjustment,
+                                   double* p_previous,
+                                   struct warp_buffer* p_locations) {
+  const R_xlen_t size = p_kernel->size;
 
-  out = PROTECT(Rf_xlengthgets(out, count));
+  // Start of the current group, and its distance
+  R_xlen_t i = 0;
+  double current = *p_previous;
 
-  UNPROTECT(2);
+  if (isnan(current)) {
+    return i;
+  }
+
+  while (true) {
+    // Gallop until `lo` is known to be in the current group and `hi` isn't
+    R_xlen_t lo = i;
+    R_xlen_t hi;
+    double hi_elt;
+
+    for (R_xlen_t step = 1; true; step *= 2) {
+      hi = lo + step;
+
+      if (hi >= size) {
+        hi = size - 1;
+        hi_elt = kernel_elt(p_kernel, hi);
+
+        if (hi_elt == current) {
+          *p_previous = current;
+          return size;
+        }
+
+        break;
+      }
+
+      hi_elt = kernel_elt(p_kernel, hi);
+
+      if (hi_elt != current) {
+        break;
+      }
+
+      lo = hi;
+    }
+
+    // Written to also catch `NA`
+    if (!(hi_elt > current)) {
+      *p_previous = current;
+      return i;
+    }
+
+    // Narrow down to the first location in `(lo, hi]` that isn't in the group
+    while (hi - lo > 1) {
+      const R_xlen_t mid = lo + (hi - lo) / 2;
+      const double mid_elt = kernel_elt(p_kernel, mid);
+
+      if (mid_elt == current) {
+        lo = mid;
+        continue;
+      }
+
+      if (!(mid_elt > current)) {
+        *p_previous = current;
+        return i;
+      }
+
+      hi = mid;
+      hi_elt = mid_elt;
+    }
+
+    warp_buffer_push(p_locations, hi + adjustment);
+
+    i = hi;
+    current = hi_elt;
+  }
+}
+
+static inline double kernel_elt(const struct warp_kernel* p_kernel, R_xlen_t i) {
+  double out;
+  p_kernel->fn(p_kernel, i, 1, &out);
   return out;
 }
 
-// Because the values come from `warp_distance()`, we can be confident that
+#undef WARP_CHANGE_BLOCK_SIZE
+
+// Because the values come from the distance kernels, we can be confident that
 // they are doubles, possibly `NA_real_` (but not `NaN` or `Inf`!)
 
 // Order of checks
@@ -0,0 +1,331 @@
+#include "compact.h"
+#include "warp.h"
+#include "utils.h"
+#include "buffer.h"
+#include <string.h> // For memcpy()
+#include <stddef.h> // For ptrdiff_t
+
+/*
+ * `warp_compact_buffer()`
+ *
+ * When `x` is a regular grid, the locations returned by `warp_change()` and
+ * `warp_boundary()` are an arithmetic sequence, apart from a few values at
+ * either end: the first group and the last group are usually partial, the
+ * first start is always `1`, and `endpoint = TRUE` adds an extra location at
+ * one end. Such locations are returned as a compact ALTREP double vector that
+ * only stores the sequence and the values at its ends.
+ *
+ * The locations are checked while they are still in the `warp_buffer` they
+ * were collected in, so regular locations never get a full length vector.
+ * With `starts = true`, the buffer holds the stops of `warp_boundary()`, and
+ * the locations are the starts of their groups: `1`, and then one past every
+ * stop but the last one.
+ *
+ * Element `i` of a compact vector of size `n` is:
+ * - `head[i]`, if `i < WARP_COMPACT_HEAD`
+ * - `tail[i - (n - WARP_COMPACT_TAIL)]`, if `i >= n - WARP_COMPACT_TAIL`
+ * - `first + i * step`, otherwise
+ *
+ * - `data1` is a list holding `c(n, first, step)`, `head`, and `tail`.
+ * - `data2` is the materialized vector, or `NULL`.
+ *
+ * Locations are whole numbers far below 2^53, so the sequence is exact.
+ * Compact vectors require R >= 3.5.0. On older versions of R, and for
+ * locations that aren't regular, a regular double vector is returned.
+ */
+
+#define WARP_COMPACT_HEAD 2
+#define WARP_COMPACT_TAIL 1
+
+// Smaller vectors aren't worth compacting
+#define WARP_COMPACT_MIN_SIZE 1024
+
+#if (R_VERSION >= R_Version(3, 5, 0))
+
+#include <R_ext/Altrep.h>
+
+static R_altrep_class_t warp_compact_class;
+
+static SEXP new_compact(R_xlen_t size, double first, double step, const double* p_head, const double* p_tail);
+static SEXP buffer_materialize(const struct warp_buffer* p_buffer, bool starts);
+static inline double buffer_location(const struct warp_buffer* p_buffer, bool starts, R_xlen_t i);
+
+// [[ include("compact.h") ]]
+SEXP warp_compact_buffer(const struct warp_buffer* p_buffer, bool starts) {
+  const R_xlen_t size = p_buffer->size;
+
+  if (size < WARP_COMPACT_MIN_SIZE) {
+    return buffer_materialize(p_buffer, starts);
+  }
+
+  const R_xlen_t begin = WARP_COMPACT_HEAD;
+  const R_xlen_t end = size - WARP_COMPACT_TAIL;
+
+  // Location `i` is stop `i - 1` plus one
+  const R_xlen_t lag = starts;
+
+  double first;
+  double step;
+
+  if (!warp_buffer_is_arithmetic(p_buffer, begin - lag, end - lag, &first, &step)) {
+    return buffer_materialize(p_buffer, starts);
+  }
+
+  first += lag * (1 - step);
+
+  double head[WARP_COMPACT_HEAD];
+  for (R_xlen_t i = 0; i < WARP_COMPACT_HEAD; ++i) {
+    head[i] = buffer_location(p_buffer, starts, i);
+  }
+
+  double tail[WARP_COMPACT_TAIL];
+  for (R_xlen_t i = 0; i < WARP_COMPACT_TAIL; ++i) {
+    tail[i] = buffer_location(p_buffer, starts, end + i);
+  }
+
+  return new_compact(size, first, step, head, tail);
+}
+
+static SEXP new_compact(R_xlen_t size, double first, double step, const double* p_head, const double* p_tail) {
+  SEXP info = PROTECT(Rf_allocVector(REALSXP, 3));
+  double* p_info = REAL(info);
+  p_info[0] = (double) size;
+  p_info[1] = first;
+  p_info[2] = step;
+
+  SEXP head = PROTECT(Rf_allocVector(REALSXP, WARP_COMPACT_HEAD));
+  memcpy(REAL(head), p_head, WARP_COMPACT_HEAD * sizeof(double));
+
+  SEXP tail = PROTECT(Rf_allocVector(REALSXP, WARP_COMPACT_TAIL));
+  memcpy(REAL(tail), p_tail, WARP_COMPACT_TAIL * sizeof(double));
+
+  SEXP data1 = PROTECT(Rf_allocVector(VECSXP, 3));
+  SET_VECTOR_ELT(data1, 0, info);
+  SET_VECTOR_ELT(data1, 1, head);
+  SET_VECTOR_ELT(data1, 2, tail);
+
+  SEXP out = R_new_altrep(warp_compact_class, data1, R_NilValue);
+
+  UNPROTECT(4);
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+static inline const double* compact_info(SEXP x) {
+  return REAL(VECTOR_ELT(R_altrep_data1(x), 0));
+}
+
+static inline const double* compact_head(SEXP x) {
+  return REAL(VECTOR_ELT(R_altrep_data1(x), 1));
+}
+
+static inline const double* compact_tail(SEXP x) {
+  return REAL(VECTOR_ELT(R_altrep_data1(x), 2));
+}
+
+static inline SEXP compact_materialized(SEXP x) {
+  return R_altrep_data2(x);
+}
+
+static R_xlen_t warp_compact_length(SEXP x) {
+  return (R_xlen_t) compact_info(x)[0];
+}
+
+static Rboolean warp_compact_inspect(SEXP x,
+                                     int pre,
+                                     int deep,
+                                     int pvec,
+                                     void (*inspect_subtree)(SEXP, int, int, int)) {
+  const double* p_info = compact_info(x);
+  const bool materialized = compact_materialized(x) != R_NilValue;
+
+  Rprintf(
+    "warp_compact_locations (len=%td, first=%.0f, step=%.0f, materialized=%s)\n",
+    (ptrdiff_t) p_info[0],
+    p_info[1],
+    p_info[2],
+    materialized ? "T" : "F"
+  );
+
+  return TRUE;
+}
+
+// Fills `[from, from + n)` of the compact vector `x` into `p_out`
+static void compact_fill(SEXP x, R_xlen_t from, R_xlen_t n, double* p_out) {
+  const double* p_info = compact_info(x);
+  const double* p_head = compact_head(x);
+  const double* p_tail = compact_tail(x);
+
+  const R_xlen_t size = (R_xlen_t) p_info[0];
+  const double first = p_info[1];
+  const double step = p_info[2];
+
+  const R_xlen_t end = size - WARP_COMPACT_TAIL;
+
+  for (R_xlen_t j = 0; j < n; ++j) {
+    const R_xlen_t i = from + j;
+
+    if (i < WARP_COMPACT_HEAD) {
+      p_out[j] = p_head[i];
+    } else if (i >= end) {
+      p_out[j] = p_tail[i - end];
+    } else {
+      p_out[j] = first + i * step;
+    }
+  }
+}
+
+static SEXP compact_materialize(SEXP x) {
+  SEXP data2 = compact_materialized(x);
+
+  if (data2 != R_NilValue) {
+    return data2;
+  }
+
+  const R_xlen_t size = warp_compact_length(x);
+
+  data2 = PROTECT(Rf_allocVector(REALSXP, size));
+
+  compact_fill(x, 0, size, REAL(data2));
+
+  R_set_altrep_data2(x, data2);
+
+  UNPROTECT(1);
+  return data2;
+}
+
+static void* warp_compact_dataptr(SEXP x, Rboolean writeable) {
+  return REAL(compact_materialize(x));
+}
+
+static const void* warp_compact_dataptr_or_null(SEXP x) {
+  SEXP data2 = compact_materialized(x);
+  return data2 == R_NilValue ? NULL : REAL(data2);
+}
+
+static double warp_compact_elt(SEXP x, R_xlen_t i) {
+  SEXP data2 = compact_materialized(x);
+
+  if (data2 != R_NilValue) {
+    return REAL(data2)[i];
+  }
+
+  double out;
+  compact_fill(x, i, 1, &out);
+
+  return out;
+}
+
+static R_xlen_t warp_compact_get_region(SEXP x, R_xlen_t i, R_xlen_t n, double* p_buf) {
+  const R_xlen_t size = warp_compact_length(x);
+  const R_xlen_t remaining = size - i;
+
+  if (n > remaining) {
+    n = remaining;
+  }
+
+  SEXP data2 = compact_materialized(x);
+
+  if (data2 != R_NilValue) {
+    memcpy(p_buf, REAL(data2) + i, n * sizeof(double));
+    return n;
+  }
+
+  compact_fill(x, i, n, p_buf);
+
+  return n;
+}
+
+// Unmodified locations are strictly increasing, and never missing
+static int warp_compact_is_sorted(SEXP x) {
+  return compact_materialized(x) == R_NilValue ? SORTED_INCR : UNKNOWN_SORTEDNESS;
+}
+
+static int warp_compact_no_na(SEXP x) {
+  return compact_materialized(x) == R_NilValue;
+}
+
+// -----------------------------------------------------------------------------
+
+// Exposed for testing
+// [[ register() ]]
+SEXP warp_is_compact(SEXP x) {
+#if (R_VERSION >= R_Version(3, 6, 0))
+  return Rf_ScalarLogical(ALTREP(x) && R_altrep_inherits(x, warp_compact_class));
+#else
+  return Rf_ScalarLogical(false);
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+// [[ include("compact.h") ]]
+void warp_init_compact(DllInfo* dll) {
+  warp_compact_class = R_make_altreal_class("warp_compact_locations", "warp", dll);
+
+  R_set_altrep_Length_method(warp_compact_class, warp_compact_length);
+  R_set_altrep_Inspect_method(warp_compact_class, warp_compact_inspect);
+  R_set_altvec_Dataptr_method(warp_compact_class, warp_compact_dataptr);
+  R_set_altvec_Dataptr_or_null_method(warp_compact_class, warp_compact_dataptr_or_null);
+  R_set_altreal_Elt_method(warp_compact_class, warp_compact_elt);
+  R_set_altreal_Get_region_method(warp_compact_class, warp_compact_get_region);
+  R_set_altreal_Is_sorted_method(warp_compact_class, warp_compact_is_sorted);
+  R_set_altreal_No_NA_method(warp_compact_class, warp_compact_no_na);
+}
+
+#else
+
+static SEXP buffer_materialize(const struct warp_buffer* p_buffer, bool starts);
+
+// [[ include("compact.h") ]]
+SEXP warp_compact_buffer(const struct warp_buffer* p_buffer, bool starts) {
+  return buffer_materialize(p_buffer, starts);
+}
+
+// [[ register() ]]
+SEXP warp_is_compact(SEXP x) {
+  return Rf_ScalarLogical(false);
+}
+
+// [[ include("compact.h") ]]
+void warp_init_compact(DllInfo* dll) {
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+
+static inline double buffer_location(const struct warp_buffer* p_buffer, bool starts, R_xlen_t i) {
+  if (!starts) {
+    return warp_buffer_get(p_buffer, i);
+  }
+
+  return i == 0 ? 1 : warp_buffer_get(p_buffer, i - 1) + 1;
+}
+
+static SEXP buffer_materialize(const struct warp_buffer* p_buffer, bool starts) {
+  const R_xlen_t size = p_buffer->size;
+
+  SEXP out = Rf_allocVector(REALSXP, size);
+  double* p_out = REAL(out);
+
+  warp_buffer_copy(p_buffer, p_out);
+
+  if (starts) {
+    // Each start is one past the previous stop
+    for (R_xlen_t i = size - 1; i > 0; --i) {
+      p_out[i] = p_out[i - 1] + 1;
+    }
+
+    if (size > 0) {
+      p_out[0] = 1;
+    }
+  }
+
+  return out;
+}
+
+#undef WARP_COMPACT_HEAD
+#undef WARP_COMPACT_TAIL
+#undef WARP_COMPACT_MIN_SIZE
@@ -0,0 +1,16 @@
+#ifndef WARP_COMPACT_H
+#define WARP_COMPACT_H
+
+#define R_NO_REMAP
+#include <R.h>
+#include <Rinternals.h>
+#include <R_ext/Rdynload.h>
+#include "buffer.h"
+
+// -----------------------------------------------------------------------------
+
+SEXP warp_compact_buffer(const struct warp_buffer* p_buffer, bool starts);
+
+void warp_init_compact(DllInfo* dll);
+
+#endif
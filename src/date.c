@@ -3,13 +3,49 @@
 
 /*
  * This file implements a VERY fast getter for year and year-month offsets for
- * a Date object. It does not go through POSIXlt, and uses an algorithm from
- * Python's datetime library for the computation of the year and month
- * components. It is both much faster and highly memory efficient.
+ * a Date object. It does not go through POSIXlt, and uses the calendar
+ * arithmetic of `days_to_components()` in `arith.c` for the computation of the
+ * year and month components. It is both much faster and highly memory
+ * efficient.
  */
 
 // -----------------------------------------------------------------------------
 
+/*
+ * The components of a double Date, with fractional days truncated towards 0.
+ * Days that don't fit in an `int` are moved by whole 400 year cycles to the
+ * same day in 1970-2369, see `dbl_days_to_cycle_day()`, and the years in those
+ * cycles are added back. Returns `false` for non-finite values, and for values
+ * so far from 1970 that their year offset doesn't fit in an `int`.
+ */
+static inline bool dbl_date_to_components(double x, struct warp_components* p_components) {
+  if (dbl_date_fits_int(x)) {
+    *p_components = days_to_components((int) x);
+    return true;
+  }
+
+  if (!R_FINITE(x)) {
+    return false;
+  }
+
+  double cycles;
+  const int day = dbl_days_to_cycle_day(trunc(x), &cycles);
+
+  *p_components = days_to_components(day);
+
+  const double year_offset = cycles * 400 + p_components->year_offset;
+
+  if (year_offset > INT_MAX || year_offset < -INT_MAX) {
+    return false;
+  }
+
+  p_components->year_offset = (int) year_offset;
+
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+
 static SEXP int_date_get_year_offset(SEXP x);
 static SEXP dbl_date_get_year_offset(SEXP x);
 
@@ -43,7 +79,7 @@ static SEXP int_date_get_year_offset(SEXP x) {
       continue;
     }
 
-    struct warp_components components = convert_days_to_components(elt);
+    struct warp_components components = days_to_components(elt);
 
     p_out[i] = components.year_offset;
   }
@@ -61,18 +97,13 @@ static SEXP dbl_date_get_year_offset(SEXP x) {
   int* p_out = INTEGER(out);
 
   for (R_xlen_t i = 0; i < size; ++i) {
-    double x_elt = p_x[i];
+    struct warp_components components;
 
-    if (!R_FINITE(x_elt)) {
+    if (!dbl_date_to_components(p_x[i], &components)) {
       p_out[i] = NA_INTEGER;
       continue;
     }
 
-    // Truncate fractional pieces towards 0
-    int elt = x_elt;
-
-    struct warp_components components = convert_days_to_components(elt);
-
     p_out[i] = components.year_offset;
   }
 
@@ -115,7 +146,7 @@ static SEXP int_date_get_month_offset(SEXP x) {
       continue;
     }
 
-    struct warp_components components = convert_days_to_components(elt);
+    struct warp_components components = days_to_components(elt);
 
     p_out[i] = components.year_offset * 12 + components.month;
   }
@@ -133,19 +164,21 @@ static SEXP dbl_date_get_month_offset(SEXP x) {
   int* p_out = INTEGER(out);
 
   for (R_xlen_t i = 0; i < size; ++i) {
-    double x_elt = p_x[i];
+    struct warp_components components;
 
-    if (!R_FINITE(x_elt)) {
+    if (!dbl_date_to_components(p_x[i], &components)) {
       p_out[i] = NA_INTEGER;
       continue;
     }
 
-    // Truncate fractional pieces towards 0
-    int elt = x_elt;
+    const int64_t elt = (int64_t) components.year_offset * 12 + components.month;
 
-    struct warp_components components = convert_days_to_components(elt);
+    if (elt > INT_MAX || elt < -INT_MAX) {
+      p_out[i] = NA_INTEGER;
+      continue;
+    }
 
-    p_out[i] = components.year_offset * 12 + components.month;
+    p_out[i] = (int) elt;
   }
 
   UNPROTECT(1);
@@ -176,7 +209,7 @@ static struct warp_yday_components int_date_get_origin_yday_components(SEXP orig
     );
   }
 
-  struct warp_components components = convert_days_to_components(elt);
+  struct warp_components components = days_to_components(elt);
 
   struct warp_yday_components out;
 
@@ -197,9 +230,14 @@ static struct warp_yday_components dbl_date_get_origin_yday_components(SEXP orig
   }
 
   // Drop fractional part
-  int elt = origin_elt;
+  struct warp_components components;
 
-  struct warp_components components = convert_days_to_components(elt);
+  if (!dbl_date_to_components(origin_elt, &components)) {
+    r_error(
+      "dbl_date_get_origin_yday_components",
+      "The `origin` is too far from 1970."
+    );
+  }
 
   struct warp_yday_components out;
 
@@ -233,7 +271,7 @@ static struct warp_mday_components int_date_get_origin_mday_components(SEXP orig
     );
   }
 
-  struct warp_components components = convert_days_to_components(elt);
+  struct warp_components components = days_to_components(elt);
 
   struct warp_mday_components out;
 
@@ -254,163 +292,19 @@ static struct warp_mday_components dbl_date_get_origin_mday_components(SEXP orig
   }
 
   // Drop fractional part
-  int elt = origin_elt;
-
-  struct warp_components components = convert_days_to_components(elt);
-
-  struct warp_mday_components out;
-
-  out.year_offset = components.year_offset;
-  out.month = components.month;
-
-  return out;
-}
-
-// -----------------------------------------------------------------------------
-
-static const int DAYS_IN_MONTH[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-static const int DAYS_UP_TO_MONTH[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
-
-#define YEAR_OFFSET_FROM_EPOCH 30
-
-#define MONTH_ADJUSTMENT_TO_0_TO_11_RANGE -1
-#define DAY_ADJUSTMENT_TO_0_TO_30_RANGE -1
-
-// unclass(as.Date("2001-01-01"))
-#define DAYS_FROM_2001_01_01_TO_EPOCH -11323
-
-// -.Machine$integer.max - (DAYS_FROM_2001_01_01_TO_EPOCH)
-// -.Machine$integer.max == (INT_MIN + 1)
-#define SMALLEST_POSSIBLE_DAYS_FROM_EPOCH (INT_MIN + 1 - DAYS_FROM_2001_01_01_TO_EPOCH)
-
-#define DAYS_IN_1_YEAR_CYCLE 365
-
-// 4 * DAYS_IN_1_YEAR_CYCLE + 1
-#define DAYS_IN_4_YEAR_CYCLE 1461
-
-// 25 * DAYS_IN_4_YEAR_CYCLE - 1
-#define DAYS_IN_100_YEAR_CYCLE 36524
-
-// 4 * DAYS_IN_100_YEAR_CYCLE + 1
-#define DAYS_IN_400_YEAR_CYCLE 146097
-
-// -----------------------------------------------------------------------------
-
-/*
- * `convert_days_to_components()`
- *
- * @param n
- *   A 0-based number of days since 1970-01-01, i.e. unclass(<Date>).
- */
-
-/*
- * Python's datetime `_ord2ymd()`
- * https://github.com/python/cpython/blob/b0d4949f1fb04f83691e10a5453d1e10e4598bb9/Lib/datetime.py#L87
- *
- * Many of the comments are copied over from this function.
- */
-
-/*
- * The challenging thing about finding the year/month is the presence of leap
- * years. The leap year pattern repeats exactly every 400 years. We adjust the
- * date to be the number of days since 2001-01-01 because that is the closest
- * 400 year boundary to 1970-01-01. This is important because it gives us the
- * maximum amount of values before hitting any integer overflow.
- *
- * The basic strategy is to find the closest 400 year boundary at or _before_
- * `n`, and then work with the offset (in number of days) from that boundary to
- * `n`. It is further divided into 100 / 4 / 1 year cycles, which reduce `n`
- * down to the "day of the year" in the year of interest. We compute the actual
- * year from the number of 400 / 100 / 4 / 1 year cycles, with an adjustment if
- * we are exactly on a 4 or 400 year boundary. Then the rest of the code is
- * dedicated to finding the month. There is an "educated guess" of
- * `(n + 50) >> 5` that gets us either exactly right or 1 too far. If we are too
- * far, we adjust it back by 1 month.
- */
-
-struct warp_components convert_days_to_components(int n) {
   struct warp_components components;
 
-  int n_1_year_cycles;
-  int n_4_year_cycles;
-  int n_100_year_cycles;
-  int n_400_year_cycles;
-
-  // The smallest possible value of `n` before overflow from
-  // addition of DAYS_FROM_2001_01_01_TO_EPOCH
-  if (n < SMALLEST_POSSIBLE_DAYS_FROM_EPOCH) {
+  if (!dbl_date_to_components(origin_elt, &components)) {
     r_error(
-      "convert_days_to_components",
-      "Integer overflow! "
-      "The smallest possible value for `n` is %i",
-      SMALLEST_POSSIBLE_DAYS_FROM_EPOCH
+      "dbl_date_get_origin_mday_components",
+      "The `origin` is too far from 1970."
     );
   }
 
-  // Adjust to be days since 2001-01-01 (so `n = 0 == 2001-01-01`)
-  n = DAYS_FROM_2001_01_01_TO_EPOCH + n;
-
-  divmod(n, DAYS_IN_400_YEAR_CYCLE, &n_400_year_cycles, &n);
-  divmod(n, DAYS_IN_100_YEAR_CYCLE, &n_100_year_cycles, &n);
-  divmod(n, DAYS_IN_4_YEAR_CYCLE, &n_4_year_cycles, &n);
-  divmod(n, DAYS_IN_1_YEAR_CYCLE, &n_1_year_cycles, &n);
-
-  int year = 1 +
-    n_400_year_cycles * 400 +
-    n_100_year_cycles * 100 +
-    n_4_year_cycles * 4 +
-    n_1_year_cycles;
-
-  // Edge case adjustment required if we are on the border of a
-  // 4 year or 400 year cycle boundary (i.e. `n = -1L`)
-  if (n_1_year_cycles == 4 || n_100_year_cycles == 4) {
-    components.year_offset = (year - 1) + YEAR_OFFSET_FROM_EPOCH;
-    components.month = 12 + MONTH_ADJUSTMENT_TO_0_TO_11_RANGE;
-    components.day = 31 + DAY_ADJUSTMENT_TO_0_TO_30_RANGE;
-    components.yday = 365;
-    return components;
-  }
-
-  components.yday = n;
-
-  bool is_leap_year = (n_1_year_cycles == 3) &&
-    (n_4_year_cycles != 24 || n_100_year_cycles == 3);
-
-  // Gets us either exactly right, or 1 month too far
-  int month = (n + 50) >> 5;
-
-  // Number of days up to this month, computed using our `month` guess
-  int preceding = DAYS_UP_TO_MONTH[month - 1] + (is_leap_year && month > 2);
-
-  // If the number of `preceding` days is greater than the `n` yday
-  // position in the year, then we obviously went too far. So subtract 1
-  // month and recompute the number of days up to the (now correct) month.
-  if (preceding > n) {
-    --month;
-    preceding -= DAYS_IN_MONTH[month - 1] + (is_leap_year && month == 2);
-  }
-
-  // Substract `position in year` - `days up to current month` = `day in month`
-  // It will be 0-30 based already
-  n -= preceding;
+  struct warp_mday_components out;
 
-  components.year_offset = year + YEAR_OFFSET_FROM_EPOCH;
-  components.month = month + MONTH_ADJUSTMENT_TO_0_TO_11_RANGE;
-  components.day = n;
+  out.year_offset = components.year_offset;
+  out.month = components.month;
 
-  return components;
+  return out;
 }
-
-#undef YEAR_OFFSET_FROM_EPOCH
-
-#undef MONTH_ADJUSTMENT_TO_0_TO_11_RANGE
-#undef DAY_ADJUSTMENT_TO_0_TO_30_RANGE
-
-#undef DAYS_FROM_2001_01_01_TO_EPOCH
-
-#undef SMALLEST_POSSIBLE_DAYS_FROM_EPOCH
-
-#undef DAYS_IN_1_YEAR_CYCLE
-#undef DAYS_IN_4_YEAR_CYCLE
-#undef DAYS_IN_100_YEAR_CYCLE
-#undef DAYS_IN_400_YEAR_CYCLE
@@ -1,383 +1,886 @@
 #include "warp.h"
 #include "utils.h"
 #include "divmod.h"
+#include "kernel.h"
+#include "simd.h"
+#include "stats.h"
 #include <stdint.h> // For int64_t (especially on Windows)
+#include <string.h> // For memset() and memcpy()
+#include <stddef.h> // For ptrdiff_t
+#include <limits.h> // For INT_MIN and INT_MAX
+
+// The range of the non-missing values of `x`, truncated towards 0, and
+// whether any values are missing. `smallest > largest` if none are present.
+struct warp_range {
+  double smallest;
+  double largest;
+  bool has_missing;
+};
 
 // Helpers defined at the bottom of the file
 static void validate_every(int every);
 static void validate_origin(SEXP origin);
-static int origin_to_days_from_epoch(SEXP origin);
+static int64_t origin_to_days_from_epoch(SEXP origin);
 static int64_t origin_to_seconds_from_epoch(SEXP origin);
 static int64_t origin_to_milliseconds_from_epoch(SEXP origin);
-static inline int64_t guarded_floor(double x);
-static inline int64_t guarded_floor_to_millisecond(double x);
+static int64_t origin_to_local_from_epoch(SEXP origin, const struct warp_zone* p_zone, bool milliseconds);
+static SEXP new_shelter(SEXP x, SEXP zone);
+static bool int_is_days_compatible(const struct warp_kernel* p_kernel, const int* p_x, R_xlen_t size);
+static bool dbl_is_days_compatible(const struct warp_kernel* p_kernel, const double* p_x, R_xlen_t size);
+static bool dbl_is_local_days_compatible(const double* p_x, R_xlen_t size);
+static struct warp_range int_scan_range(const int* p_x, R_xlen_t size);
+static struct warp_range dbl_scan_range(const double* p_x, R_xlen_t size);
+static void kernel_select_narrow(struct warp_kernel* p_kernel, SEXPTYPE type, struct warp_range range);
+static SEXP posixct_load_native_zone(struct warp_zone* p_zone, SEXP x);
 
 // -----------------------------------------------------------------------------
 
-static SEXP warp_distance_year(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_quarter(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_month(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_week(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_yweek(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_mweek(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_day(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_yday(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_mday(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_hour(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_minute(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_second(SEXP x, int every, SEXP origin);
-static SEXP warp_distance_millisecond(SEXP x, int every, SEXP origin);
+static SEXP dbl_distance(const struct warp_kernel* p_kernel, int threads);
+static SEXP int_distance(const struct warp_kernel* p_kernel, int threads, bool strict);
+static SEXP widen_distance(const struct warp_kernel* p_kernel,
+                           const int* p_int,
+                           const double* p_block,
+                           R_xlen_t from,
+                           R_xlen_t n,
+                           int threads);
+
+/*
+ * `warp_distance()` is split into two steps:
+ *
+ * - `warp_kernel_init()` validates the inputs, resolves the `origin` and time
+ *   zone, and selects a kernel specialized to the period and the storage type
+ *   of `x`. This is the only step that is allowed to call back into R. The
+ *   `clock` only changes the kernels of the sub-daily periods, the calendar
+ *   periods always count on the local clock.
+ *
+ * - `warp_kernel_run()` applies the kernel to a range of `x`, possibly split
+ *   into chunks that are processed by multiple threads.
+ *
+ * The returned shelter owns any memory that the kernel points into, and must
+ * be protected for as long as the kernel is in use.
+ *
+ * When statistics are enabled, both steps record their time under the name
+ * of the selected kernel, see `warp_stats()`.
+ */
 
 // [[ include("warp.h") ]]
-SEXP warp_distance(SEXP x, enum warp_period_type type, int every, SEXP origin) {
-  validate_origin(origin);
-  validate_every(every);
+SEXP warp_distance(SEXP x,
+                   enum warp_period_type type,
+                   int every,
+                   SEXP origin,
+                   enum warp_clock_type clock,
+                   enum warp_output_type output,
+                   bool lazy,
+                   int threads) {
+  struct warp_kernel kernel;
+
+  // Protect the shelter owning the kernel's memory
+  SEXP shelter = PROTECT(warp_kernel_init(&kernel, x, type, every, origin, clock));
 
-  if (time_class_type(x) == warp_class_unknown) {
-    r_error("warp_distance", "`x` must inherit from 'Date', 'POSIXct', or 'POSIXlt'.");
-  }
+  SEXP out;
 
-  if (origin == R_NilValue) {
-    origin = PROTECT(get_origin_epoch_in_time_zone(x));
+  if (lazy) {
+    out = warp_lazy_distance(&kernel, shelter, output, threads);
   } else {
-    x = PROTECT(convert_time_zone(x, origin));
+    out = warp_distance_eager(&kernel, output, threads);
   }
 
-  SEXP out;
+  UNPROTECT(1);
+  return out;
+}
 
-  switch (type) {
-  case warp_period_year: out = PROTECT(warp_distance_year(x, every, origin)); break;
-  case warp_period_quarter: out = PROTECT(warp_distance_quarter(x, every, origin)); break;
-  case warp_period_month: out = PROTECT(warp_distance_month(x, every, origin)); break;
-  case warp_period_week: out = PROTECT(warp_distance_week(x, every, origin)); break;
-  case warp_period_yweek: out = PROTECT(warp_distance_yweek(x, every, origin)); break;
-  case warp_period_mweek: out = PROTECT(warp_distance_mweek(x, every, origin)); break;
-  case warp_period_day: out = PROTECT(warp_distance_day(x, every, origin)); break;
-  case warp_period_yday: out = PROTECT(warp_distance_yday(x, every, origin)); break;
-  case warp_period_mday: out = PROTECT(warp_distance_mday(x, every, origin)); break;
-  case warp_period_hour: out = PROTECT(warp_distance_hour(x, every, origin)); break;
-  case warp_period_minute: out = PROTECT(warp_distance_minute(x, every, origin)); break;
-  case warp_period_second: out = PROTECT(warp_distance_second(x, every, origin)); break;
-  case warp_period_millisecond: out = PROTECT(warp_distance_millisecond(x, every, origin)); break;
-  default: r_error("warp_distance", "Internal error: unknown `type`.");
+// [[ include("kernel.h") ]]
+SEXP warp_distance_eager(const struct warp_kernel* p_kernel,
+                         enum warp_output_type output,
+                         int threads) {
+  switch (output) {
+  case warp_output_double: return dbl_distance(p_kernel, threads);
+  case warp_output_integer: return int_distance(p_kernel, threads, true);
+  case warp_output_auto: return int_distance(p_kernel, threads, false);
+  default: r_error("warp_distance", "Internal error: unknown `output`.");
   }
-
-  UNPROTECT(2);
-  return out;
 }
 
 // [[ register() ]]
-SEXP warp_warp_distance(SEXP x, SEXP period, SEXP every, SEXP origin) {
+SEXP warp_warp_distance(SEXP x,
+                        SEXP period,
+                        SEXP every,
+                        SEXP origin,
+                        SEXP clock,
+                        SEXP output,
+                        SEXP lazy,
+                        SEXP threads) {
   enum warp_period_type type = as_period_type(period);
   int every_ = pull_every(every);
-  return warp_distance(x, type, every_, origin);
+  enum warp_clock_type clock_ = as_clock_type(clock);
+  enum warp_output_type output_ = as_output_type(output);
+  bool lazy_ = pull_lazy(lazy);
+  int threads_ = pull_threads(threads);
+  return warp_distance(x, type, every_, origin, clock_, output_, lazy_, threads_);
 }
 
 // -----------------------------------------------------------------------------
 
-static SEXP warp_distance_year(SEXP x, int every, SEXP origin) {
-  int n_prot = 0;
+static SEXP dbl_distance(const struct warp_kernel* p_kernel, int threads) {
+  SEXP out = PROTECT(Rf_allocVector(REALSXP, p_kernel->size));
+  double* p_out = REAL(out);
 
-  bool needs_offset = (origin != R_NilValue);
+  warp_kernel_run(p_kernel, 0, p_kernel->size, p_out, threads);
 
-  int origin_offset;
+  UNPROTECT(1);
+  return out;
+}
 
-  if (needs_offset) {
-    SEXP origin_offset_sexp = PROTECT_N(get_year_offset(origin), &n_prot);
-    origin_offset = INTEGER(origin_offset_sexp)[0];
+// The number of distances computed per block, per thread, before they are
+// converted to integers
+#define WARP_DISTANCE_BLOCK_SIZE 4096
 
-    if (origin_offset == NA_INTEGER) {
-      r_error("warp_distance_year", "`origin` cannot be `NA`.");
-    }
+/*
+ * Distances are computed in blocks of doubles and narrowed to integers as
+ * they go. Every finite distance is a whole number, so the only failure mode
+ * is a distance outside the range of an integer. `INT_MIN` is excluded,
+ * because it is `NA_integer_`.
+ *
+ * If `strict`, such a distance is an error. Otherwise the integers computed
+ * so far are widened into a double vector, and the remaining distances are
+ * computed directly into it.
+ */
+static SEXP int_distance(const struct warp_kernel* p_kernel, int threads, bool strict) {
+  const R_xlen_t size = p_kernel->size;
+
+  R_xlen_t block_size = WARP_DISTANCE_BLOCK_SIZE * (R_xlen_t) (threads > 1 ? threads : 1);
+  if (block_size > size) {
+    block_size = size;
   }
 
-  bool needs_every = (every != 1);
+  double* p_block = (double*) R_alloc(block_size, sizeof(double));
 
-  SEXP year = PROTECT_N(get_year_offset(x), &n_prot);
-  int* p_year = INTEGER(year);
+  SEXP out = PROTECT(Rf_allocVector(INTSXP, size));
+  int* p_out = INTEGER(out);
 
-  R_xlen_t n_out = Rf_xlength(year);
+  for (R_xlen_t from = 0; from < size; from += block_size) {
+    const R_xlen_t remaining = size - from;
+    const R_xlen_t n = remaining < block_size ? remaining : block_size;
 
-  SEXP out = PROTECT_N(Rf_allocVector(REALSXP, n_out), &n_prot);
-  double* p_out = REAL(out);
+    warp_kernel_run(p_kernel, from, n, p_block, threads);
 
-  for (R_xlen_t i = 0; i < n_out; ++i) {
-    int elt = p_year[i];
+    for (R_xlen_t j = 0; j < n; ++j) {
+      const double elt = p_block[j];
 
-    if (elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
+      if (isnan(elt)) {
+        p_out[from + j] = NA_INTEGER;
+        continue;
+      }
 
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
+      if (elt <= INT_MIN || elt > INT_MAX) {
+        if (strict) {
+          r_error(
+            "warp_distance",
+            "Distance %.0f at location %td can't be represented as an integer. Use `output = \"double\"`.",
+            elt,
+            (ptrdiff_t) (from + j + 1)
+          );
+        }
 
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
+        SEXP dbl = widen_distance(p_kernel, p_out, p_block, from, n, threads);
+        UNPROTECT(1);
+        return dbl;
+      }
 
-    if (elt < 0) {
-      p_out[i] = (elt - (every - 1)) / every;
-    } else {
-      p_out[i] = elt / every;
+      p_out[from + j] = (int) elt;
     }
   }
 
-  UNPROTECT(n_prot);
+  UNPROTECT(1);
   return out;
 }
 
-// -----------------------------------------------------------------------------
+#undef WARP_DISTANCE_BLOCK_SIZE
+
+// Widens the integer distances in `[0, from)` and the double distances of
+// the current block, then computes the rest of the distances as doubles
+static SEXP widen_distance(const struct warp_kernel* p_kernel,
+                           const int* p_int,
+                           const double* p_block,
+                           R_xlen_t from,
+                           R_xlen_t n,
+                           int threads) {
+  const R_xlen_t size = p_kernel->size;
+
+  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
+  double* p_out = REAL(out);
+
+  for (R_xlen_t i = 0; i < from; ++i) {
+    const int elt = p_int[i];
+    p_out[i] = (elt == NA_INTEGER) ? NA_REAL : (double) elt;
+  }
+
+  memcpy(p_out + from, p_block, n * sizeof(double));
 
-static SEXP warp_distance_quarter(SEXP x, int every, SEXP origin) {
-  return warp_distance_month(x, every * 3, origin);
+  const R_xlen_t done = from + n;
+  warp_kernel_run(p_kernel, done, size - done, p_out + done, threads);
+
+  UNPROTECT(1);
+  return out;
 }
 
 // -----------------------------------------------------------------------------
 
-static SEXP warp_distance_month(SEXP x, int every, SEXP origin) {
-  int n_prot = 0;
+static SEXP kernel_init_year(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin);
+static SEXP kernel_init_month(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin);
+static SEXP kernel_init_day(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin);
+static SEXP kernel_init_yday(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin);
+static SEXP kernel_init_mday(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin);
+static SEXP kernel_init_hour(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin, enum warp_clock_type clock);
+static SEXP kernel_init_minute(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin, enum warp_clock_type clock);
+static SEXP kernel_init_second(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin, enum warp_clock_type clock);
+static SEXP kernel_init_millisecond(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin, enum warp_clock_type clock);
+
+// [[ include("kernel.h") ]]
+SEXP warp_kernel_init(struct warp_kernel* p_kernel,
+                      SEXP x,
+                      enum warp_period_type type,
+                      int every,
+                      SEXP origin,
+                      enum warp_clock_type clock) {
+  const bool stats = warp_stats_enabled;
+  const double start = stats ? warp_stats_now() : 0;
+
+  validate_origin(origin);
+  validate_every(every);
+
+  if (time_class_type(x) == warp_class_unknown) {
+    r_error("warp_distance", "`x` must inherit from 'Date', 'POSIXct', or 'POSIXlt'.");
+  }
+
+  if (origin == R_NilValue) {
+    origin = PROTECT(get_origin_epoch_in_time_zone(x));
+  } else {
+    x = PROTECT(convert_time_zone(x, origin));
+  }
 
-  bool needs_offset = (origin != R_NilValue);
+  memset(p_kernel, 0, sizeof(struct warp_kernel));
 
-  int origin_offset;
+  SEXP shelter;
 
-  if (needs_offset) {
-    SEXP origin_offset_sexp = PROTECT_N(get_month_offset(origin), &n_prot);
-    origin_offset = INTEGER(origin_offset_sexp)[0];
+  switch (type) {
+  case warp_period_year: {
+    shelter = kernel_init_year(p_kernel, x, every, origin);
+    break;
+  }
+  case warp_period_quarter: {
+    shelter = kernel_init_month(p_kernel, x, every * 3, origin);
+    break;
+  }
+  case warp_period_month: {
+    shelter = kernel_init_month(p_kernel, x, every, origin);
+    break;
+  }
+  case warp_period_week: {
+    shelter = kernel_init_day(p_kernel, x, every * 7, origin);
+    break;
+  }
+  case warp_period_yweek: {
+    if (every > 52) {
+      r_error(
+        "warp_distance_yweek",
+        "The maximum allowed value of `every` for `period = 'yweek'` is 52."
+      );
+    }
 
-    if (origin_offset == NA_INTEGER) {
-      r_error("warp_distance_month", "`origin` cannot be `NA`.");
+    shelter = kernel_init_yday(p_kernel, x, every * 7, origin);
+    break;
+  }
+  case warp_period_mweek: {
+    if (every > 4) {
+      r_error(
+        "warp_distance_mweek",
+        "The maximum allowed value of `every` for `period = 'mweek'` is 4."
+      );
     }
+
+    shelter = kernel_init_mday(p_kernel, x, every * 7, origin);
+    break;
+  }
+  case warp_period_day: {
+    shelter = kernel_init_day(p_kernel, x, every, origin);
+    break;
+  }
+  case warp_period_yday: {
+    shelter = kernel_init_yday(p_kernel, x, every, origin);
+    break;
+  }
+  case warp_period_mday: {
+    shelter = kernel_init_mday(p_kernel, x, every, origin);
+    break;
+  }
+  case warp_period_hour: {
+    shelter = kernel_init_hour(p_kernel, x, every, origin, clock);
+    break;
+  }
+  case warp_period_minute: {
+    shelter = kernel_init_minute(p_kernel, x, every, origin, clock);
+    break;
+  }
+  case warp_period_second: {
+    shelter = kernel_init_second(p_kernel, x, every, origin, clock);
+    break;
+  }
+  case warp_period_millisecond: {
+    shelter = kernel_init_millisecond(p_kernel, x, every, origin, clock);
+    break;
+  }
+  default: {
+    r_error("warp_distance", "Internal error: unknown `type`.");
+  }
   }
 
-  bool needs_every = (every != 1);
+  p_kernel->every_divider = new_divider(p_kernel->every);
 
-  SEXP month = PROTECT_N(get_month_offset(x), &n_prot);
-  const int* p_month = INTEGER_RO(month);
+  if (stats) {
+    const double elapsed = warp_stats_now() - start;
+    warp_stats_add("setup", warp_kernel_name(p_kernel->fn), 1, (double) p_kernel->size, elapsed);
+  }
 
-  R_xlen_t size = Rf_xlength(month);
+  UNPROTECT(1);
+  return shelter;
+}
 
-  SEXP out = PROTECT_N(Rf_allocVector(REALSXP, size), &n_prot);
-  double* p_out = REAL(out);
+/*
+ * `warp_kernel_bind()`
+ *
+ * Points a kernel that was initialized with `warp_kernel_init()` at new
+ * input `x`, without redoing the origin, `every`, or time zone resolution.
+ * `x` must have the same class, storage type, and time zone as the input the
+ * kernel was initialized with, and the kernel must read that input directly,
+ * rather than a converted version of it. Only the checks on the values of
+ * the input are repeated.
+ *
+ * Returns `false` if the values of `x` can't be handled by the kernel, in
+ * which case the kernel has to be initialized from scratch. Kernels with a
+ * narrow variant re-select it for the range of `x` instead. `x` must be
+ * protected for as long as the kernel is in use.
+ */
 
-  for (R_xlen_t i = 0; i < size; ++i) {
-    int elt = p_month[i];
+// [[ include("kernel.h") ]]
+bool warp_kernel_bind(struct warp_kernel* p_kernel, SEXP x) {
+  const R_xlen_t size = Rf_xlength(x);
 
-    if (elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
+  switch (TYPEOF(x)) {
+  case INTSXP: {
+    const int* p_x = INTEGER_RO(x);
+
+    if (p_kernel->check == warp_kernel_check_days && !int_is_days_compatible(p_kernel, p_x, size)) {
+      return false;
     }
 
-    if (needs_offset) {
-      elt -= origin_offset;
+    if (p_kernel->check == warp_kernel_check_narrow) {
+      kernel_select_narrow(p_kernel, INTSXP, int_scan_range(p_x, size));
     }
 
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
+    p_kernel->p_int = p_x;
+    break;
+  }
+  case REALSXP: {
+    const double* p_x = REAL_RO(x);
+
+    if (p_kernel->check == warp_kernel_check_days && !dbl_is_days_compatible(p_kernel, p_x, size)) {
+      return false;
     }
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
+    if (p_kernel->check == warp_kernel_check_local_days && !dbl_is_local_days_compatible(p_x, size)) {
+      return false;
     }
 
-    p_out[i] = elt;
+    if (p_kernel->check == warp_kernel_check_narrow) {
+      kernel_select_narrow(p_kernel, REALSXP, dbl_scan_range(p_x, size));
+    }
+
+    p_kernel->p_dbl = p_x;
+    break;
+  }
+  default: {
+    return false;
+  }
   }
 
-  UNPROTECT(n_prot);
-  return out;
+  p_kernel->size = size;
+  return true;
 }
 
 // -----------------------------------------------------------------------------
 
-static SEXP warp_distance_week(SEXP x, int every, SEXP origin) {
-  return warp_distance_day(x, every * 7, origin);
-}
+// Shared by every kernel. Applies `every` to a distance that has already been
+// shifted by the origin, using floor division. `APPLY_EVERY()` is for `int`
+// distances, and uses the precomputed fast divider. `APPLY_EVERY_WIDE()` is
+// for `int64_t` distances, which the fast divider doesn't support.
+#define APPLY_EVERY(ELT, P_KERNEL) do {                                 \
+  if ((P_KERNEL)->needs_every) {                                        \
+    ELT = divider_div(ELT, &(P_KERNEL)->every_divider);                 \
+  }                                                                     \
+} while (0)
+
+#define APPLY_EVERY_WIDE(ELT, P_KERNEL) do {                            \
+  if ((P_KERNEL)->needs_every) {                                        \
+    const int every = (P_KERNEL)->every;                                \
+                                                                        \
+    if (ELT < 0) {                                                      \
+      ELT = (ELT - (every - 1)) / every;                                \
+    } else {                                                            \
+      ELT = ELT / every;                                                \
+    }                                                                   \
+  }                                                                     \
+} while (0)
 
 // -----------------------------------------------------------------------------
 
-static SEXP warp_distance_yweek(SEXP x, int every, SEXP origin) {
-  if (every > 52) {
-    r_error(
-      "warp_distance_yweek",
-      "The maximum allowed value of `every` for `period = 'yweek'` is 52."
-    );
-  }
+/*
+ * The `"year"`, `"month"`, and `"day"` kernels all map `x` to a number of
+ * days since 1970-01-01, and then to an integer period offset from that.
+ *
+ * - Date: the days are the underlying value, with fractional days truncated.
+ *   A range scan picks the `int` kernels when every day, and every day
+ *   shifted by the origin, fits in an `int`. Otherwise the `wide` kernels
+ *   do the same in 64-bit arithmetic, and days too far from 1970 for that,
+ *   see `WARP_WIDE_DAYS_LIMIT`, in double arithmetic.
+ * - POSIXct: the days are computed in local time from the zoneinfo database.
+ * - Everything else: the offsets are computed by `get_*_offset()` ahead of
+ *   time, and the `int_offset` kernel just applies the origin and `every`.
+ */
+
+/*
+ * Sorted input is mostly made of long runs of elements in the same period.
+ * Along with the offset, `TO_OFFSET()` returns the range of days covered by
+ * the period, `[start, start + length)`. The kernel reuses the last computed
+ * distance for every following element with days in that range, skipping the
+ * calendar math, the origin, and `every`. The range check is exact, so this
+ * doesn't rely on `x` actually being sorted, and for unsorted input it only
+ * costs a well predicted comparison per element.
+ */
+
+static inline int year_from_days(int days, int64_t* p_start, int* p_length) {
+  struct warp_components components = days_to_components(days);
 
-  return warp_distance_yday(x, every * 7, origin);
+  *p_start = (int64_t) days - components.yday;
+  *p_length = 365 + is_leap_year64(components.year_offset + 1970);
+
+  return components.year_offset;
 }
 
-// -----------------------------------------------------------------------------
+static inline int month_from_days(int days, int64_t* p_start, int* p_length) {
+  struct warp_components components = days_to_components(days);
 
-static SEXP warp_distance_mweek(SEXP x, int every, SEXP origin) {
-  if (every > 4) {
-    r_error(
-      "warp_distance_mweek",
-      "The maximum allowed value of `every` for `period = 'mweek'` is 4."
-    );
-  }
+  *p_start = (int64_t) days - components.day;
+  *p_length = days_in_month64(components.year_offset + 1970, components.month + 1);
 
-  return warp_distance_mday(x, every * 7, origin);
+  return components.year_offset * 12 + components.month;
 }
 
-// -----------------------------------------------------------------------------
+static inline int day_from_days(int days, int64_t* p_start, int* p_length) {
+  *p_start = days;
+  *p_length = 1;
+  return days;
+}
 
-static SEXP warp_distance_day(SEXP x, int every, SEXP origin) {
-  int n_prot = 0;
+static inline int64_t year_from_days64(int64_t days, int64_t* p_start, int* p_length) {
+  struct warp_components64 components = days_to_components64(days);
 
-  bool needs_offset = (origin != R_NilValue);
+  *p_start = days - components.yday;
+  *p_length = 365 + is_leap_year64(components.year_offset + 1970);
 
-  int origin_offset;
+  return components.year_offset;
+}
 
-  if (needs_offset) {
-    SEXP origin_offset_sexp = PROTECT_N(get_day_offset(origin), &n_prot);
-    origin_offset = INTEGER(origin_offset_sexp)[0];
+static inline int64_t month_from_days64(int64_t days, int64_t* p_start, int* p_length) {
+  struct warp_components64 components = days_to_components64(days);
 
-    if (origin_offset == NA_INTEGER) {
-      r_error("warp_distance_day", "`origin` cannot be `NA`.");
-    }
+  *p_start = days - components.day;
+  *p_length = days_in_month64(components.year_offset + 1970, components.month + 1);
+
+  return components.year_offset * 12 + components.month;
+}
+
+static inline int64_t day_from_days64(int64_t days, int64_t* p_start, int* p_length) {
+  *p_start = days;
+  *p_length = 1;
+  return days;
+}
+
+/*
+ * Double Dates too far from 1970 for the 64-bit days are computed in double
+ * arithmetic. The calendar is moved by whole 400 year cycles to the same day
+ * in 1970-2369, like in `dbl_date_wide_warp_distance_yday()`, and the years
+ * in those cycles are added back. The day in the cycle is exact, the rest is
+ * as exact as the double input itself.
+ */
+
+static inline double dbl_date_far_distance(double elt, const struct warp_kernel* p_kernel) {
+  if (p_kernel->needs_offset) {
+    elt -= p_kernel->origin_offset;
+  }
+
+  if (p_kernel->needs_every) {
+    elt = floor(elt / p_kernel->every);
   }
 
-  bool needs_every = (every != 1);
+  return elt;
+}
+
+static double dbl_date_far_year(double x, const struct warp_kernel* p_kernel) {
+  if (!R_FINITE(x)) {
+    return NA_REAL;
+  }
 
-  SEXP day = PROTECT_N(get_day_offset(x), &n_prot);
-  const int* p_day = INTEGER_RO(day);
+  double cycles;
+  const int day = dbl_days_to_cycle_day(trunc(x), &cycles);
+  const struct warp_components components = days_to_components(day);
 
-  R_xlen_t size = Rf_xlength(day);
+  return dbl_date_far_distance(cycles * 400 + components.year_offset, p_kernel);
+}
+
+static double dbl_date_far_month(double x, const struct warp_kernel* p_kernel) {
+  if (!R_FINITE(x)) {
+    return NA_REAL;
+  }
+
+  double cycles;
+  const int day = dbl_days_to_cycle_day(trunc(x), &cycles);
+  const struct warp_components components = days_to_components(day);
+
+  const int elt = components.year_offset * 12 + components.month;
+
+  return dbl_date_far_distance(cycles * 4800 + elt, p_kernel);
+}
+
+static double dbl_date_far_day(double x, const struct warp_kernel* p_kernel) {
+  if (!R_FINITE(x)) {
+    return NA_REAL;
+  }
+
+  return dbl_date_far_distance(trunc(x), p_kernel);
+}
+
+// `ETYPE` is the type of the days and the offsets, `int`, or `int64_t` for the
+// `wide` kernels, and `APPLY` is the matching `APPLY_EVERY*()`. Elements that
+// `TO_DAYS()` can't convert are `IS_MISSING()`, and get the distance
+// `FALLBACK()` instead.
+#define DAYS_KERNEL(NAME, CTYPE, P_X, IS_MISSING, FALLBACK, ETYPE, TO_DAYS, TO_OFFSET, APPLY) \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const CTYPE* p_x = p_kernel->P_X + from;                              \
+                                                                        \
+  const bool needs_offset = p_kernel->needs_offset;                     \
+  const ETYPE origin_offset = (ETYPE) p_kernel->origin_offset;          \
+                                                                        \
+  struct warp_zone_cursor cursor;                                       \
+  warp_zone_cursor_init(&cursor, &p_kernel->zone);                      \
+                                                                        \
+  int64_t run_start = 0;                                                \
+  int run_length = 0;                                                   \
+  double run_elt = 0;                                                   \
+                                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const CTYPE x_elt = p_x[i];                                         \
+                                                                        \
+    if (IS_MISSING(x_elt)) {                                            \
+      p_out[i] = FALLBACK(x_elt, p_kernel);                             \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    const ETYPE days = TO_DAYS(x_elt, &cursor);                         \
+                                                                        \
+    if ((uint64_t) (days - run_start) < (uint64_t) run_length) {        \
+      p_out[i] = run_elt;                                               \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    ETYPE elt = TO_OFFSET(days, &run_start, &run_length);               \
+                                                                        \
+    if (needs_offset) {                                                 \
+      elt -= origin_offset;                                             \
+    }                                                                   \
+                                                                        \
+    APPLY(elt, p_kernel);                                               \
+                                                                        \
+    run_elt = elt;                                                      \
+    p_out[i] = elt;                                                     \
+  }                                                                     \
+}
+
+#define INT_IS_MISSING(x) ((x) == NA_INTEGER)
+#define DBL_IS_MISSING(x) (!R_FINITE(x))
+
+// Also true for non-finite values
+#define DBL_IS_MISSING_WIDE(x) (!(fabs(x) < WARP_WIDE_DAYS_LIMIT))
+
+#define NA_FALLBACK(x, p_kernel) NA_REAL
+
+// Truncate fractional pieces towards 0
+#define INT_DATE_TO_DAYS(x, p_cursor) (x)
+#define DBL_DATE_TO_DAYS(x, p_cursor) ((int) (x))
+#define INT_DATE_TO_DAYS_WIDE(x, p_cursor) ((int64_t) (x))
+#define DBL_DATE_TO_DAYS_WIDE(x, p_cursor) ((int64_t) (x))
+
+// Offsets are looked up through a cursor over the zone of the kernel, which
+// is O(1) for runs of values between the same two transitions
+#define INT_POSIXCT_TO_DAYS(x, p_cursor) warp_zone_cursor_local_days((x), (p_cursor))
+#define DBL_POSIXCT_TO_DAYS(x, p_cursor) warp_zone_cursor_local_days(guarded_floor(x), (p_cursor))
+
+DAYS_KERNEL(int_date_warp_distance_year, int, p_int, INT_IS_MISSING, NA_FALLBACK, int, INT_DATE_TO_DAYS, year_from_days, APPLY_EVERY)
+DAYS_KERNEL(dbl_date_warp_distance_year, double, p_dbl, DBL_IS_MISSING, NA_FALLBACK, int, DBL_DATE_TO_DAYS, year_from_days, APPLY_EVERY)
+DAYS_KERNEL(int_date_wide_warp_distance_year, int, p_int, INT_IS_MISSING, NA_FALLBACK, int64_t, INT_DATE_TO_DAYS_WIDE, year_from_days64, APPLY_EVERY_WIDE)
+DAYS_KERNEL(dbl_date_wide_warp_distance_year, double, p_dbl, DBL_IS_MISSING_WIDE, dbl_date_far_year, int64_t, DBL_DATE_TO_DAYS_WIDE, year_from_days64, APPLY_EVERY_WIDE)
+DAYS_KERNEL(int_posixct_warp_distance_year, int, p_int, INT_IS_MISSING, NA_FALLBACK, int, INT_POSIXCT_TO_DAYS, year_from_days, APPLY_EVERY)
+DAYS_KERNEL(dbl_posixct_warp_distance_year, double, p_dbl, DBL_IS_MISSING, NA_FALLBACK, int, DBL_POSIXCT_TO_DAYS, year_from_days, APPLY_EVERY)
+
+DAYS_KERNEL(int_date_warp_distance_month, int, p_int, INT_IS_MISSING, NA_FALLBACK, int, INT_DATE_TO_DAYS, month_from_days, APPLY_EVERY)
+DAYS_KERNEL(dbl_date_warp_distance_month, double, p_dbl, DBL_IS_MISSING, NA_FALLBACK, int, DBL_DATE_TO_DAYS, month_from_days, APPLY_EVERY)
+DAYS_KERNEL(int_date_wide_warp_distance_month, int, p_int, INT_IS_MISSING, NA_FALLBACK, int64_t, INT_DATE_TO_DAYS_WIDE, month_from_days64, APPLY_EVERY_WIDE)
+DAYS_KERNEL(dbl_date_wide_warp_distance_month, double, p_dbl, DBL_IS_MISSING_WIDE, dbl_date_far_month, int64_t, DBL_DATE_TO_DAYS_WIDE, month_from_days64, APPLY_EVERY_WIDE)
+DAYS_KERNEL(int_posixct_warp_distance_month, int, p_int, INT_IS_MISSING, NA_FALLBACK, int, INT_POSIXCT_TO_DAYS, month_from_days, APPLY_EVERY)
+DAYS_KERNEL(dbl_posixct_warp_distance_month, double, p_dbl, DBL_IS_MISSING, NA_FALLBACK, int, DBL_POSIXCT_TO_DAYS, month_from_days, APPLY_EVERY)
+
+DAYS_KERNEL(int_date_warp_distance_day, int, p_int, INT_IS_MISSING, NA_FALLBACK, int, INT_DATE_TO_DAYS, day_from_days, APPLY_EVERY)
+DAYS_KERNEL(dbl_date_warp_distance_day, double, p_dbl, DBL_IS_MISSING, NA_FALLBACK, int, DBL_DATE_TO_DAYS, day_from_days, APPLY_EVERY)
+DAYS_KERNEL(int_date_wide_warp_distance_day, int, p_int, INT_IS_MISSING, NA_FALLBACK, int64_t, INT_DATE_TO_DAYS_WIDE, day_from_days64, APPLY_EVERY_WIDE)
+DAYS_KERNEL(dbl_date_wide_warp_distance_day, double, p_dbl, DBL_IS_MISSING_WIDE, dbl_date_far_day, int64_t, DBL_DATE_TO_DAYS_WIDE, day_from_days64, APPLY_EVERY_WIDE)
+DAYS_KERNEL(int_posixct_warp_distance_day, int, p_int, INT_IS_MISSING, NA_FALLBACK, int, INT_POSIXCT_TO_DAYS, day_from_days, APPLY_EVERY)
+DAYS_KERNEL(dbl_posixct_warp_distance_day, double, p_dbl, DBL_IS_MISSING, NA_FALLBACK, int, DBL_POSIXCT_TO_DAYS, day_from_days, APPLY_EVERY)
+
+// The input is already an offset, computed by `get_*_offset()`
+DAYS_KERNEL(int_offset_warp_distance, int, p_int, INT_IS_MISSING, NA_FALLBACK, int, INT_DATE_TO_DAYS, day_from_days, APPLY_EVERY)
+
+#undef DAYS_KERNEL
+
+struct days_kernels {
+  warp_kernel_fn int_date;
+  warp_kernel_fn dbl_date;
+  warp_kernel_fn int_date_wide;
+  warp_kernel_fn dbl_date_wide;
+  warp_kernel_fn int_posixct;
+  warp_kernel_fn dbl_posixct;
+  SEXP (*get_offset)(SEXP x);
+};
+
+static const struct days_kernels year_kernels = {
+  int_date_warp_distance_year,
+  dbl_date_warp_distance_year,
+  int_date_wide_warp_distance_year,
+  dbl_date_wide_warp_distance_year,
+  int_posixct_warp_distance_year,
+  dbl_posixct_warp_distance_year,
+  get_year_offset
+};
+
+static const struct days_kernels month_kernels = {
+  int_date_warp_distance_month,
+  dbl_date_warp_distance_month,
+  int_date_wide_warp_distance_month,
+  dbl_date_wide_warp_distance_month,
+  int_posixct_warp_distance_month,
+  dbl_posixct_warp_distance_month,
+  get_month_offset
+};
+
+static const struct days_kernels day_kernels = {
+  int_date_warp_distance_day,
+  dbl_date_warp_distance_day,
+  int_date_wide_warp_distance_day,
+  dbl_date_wide_warp_distance_day,
+  int_posixct_warp_distance_day,
+  dbl_posixct_warp_distance_day,
+  get_day_offset
+};
+
+static SEXP kernel_init_days(struct warp_kernel* p_kernel,
+                             SEXP x,
+                             const struct days_kernels* p_kernels) {
+  switch (time_class_type(x)) {
+  case warp_class_date: {
+    p_kernel->size = Rf_xlength(x);
 
-  SEXP out = PROTECT_N(Rf_allocVector(REALSXP, size), &n_prot);
-  double* p_out = REAL(out);
+    switch (TYPEOF(x)) {
+    case INTSXP: {
+      p_kernel->p_int = INTEGER_RO(x);
 
-  for (R_xlen_t i = 0; i < size; ++i) {
-    int elt = p_day[i];
+      if (int_is_days_compatible(p_kernel, p_kernel->p_int, p_kernel->size)) {
+        p_kernel->fn = p_kernels->int_date;
+        p_kernel->check = warp_kernel_check_days;
+      } else {
+        p_kernel->fn = p_kernels->int_date_wide;
+      }
 
-    if (elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
+      return new_shelter(x, R_NilValue);
     }
+    case REALSXP: {
+      p_kernel->p_dbl = REAL_RO(x);
+
+      if (dbl_is_days_compatible(p_kernel, p_kernel->p_dbl, p_kernel->size)) {
+        p_kernel->fn = p_kernels->dbl_date;
+        p_kernel->check = warp_kernel_check_days;
+      } else {
+        p_kernel->fn = p_kernels->dbl_date_wide;
+      }
 
-    if (needs_offset) {
-      elt -= origin_offset;
+      return new_shelter(x, R_NilValue);
     }
+    default: {
+      r_error("kernel_init_days", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
+    }
+    }
+  }
+  case warp_class_posixct: {
+    SEXP zone = PROTECT(warp_zone_load(&p_kernel->zone, get_time_zone(x)));
 
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
+    if (zone == R_NilValue) {
+      UNPROTECT(1);
+      break;
     }
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
+    p_kernel->size = Rf_xlength(x);
+
+    if (TYPEOF(x) == INTSXP) {
+      p_kernel->p_int = INTEGER_RO(x);
+      p_kernel->fn = p_kernels->int_posixct;
+
+      SEXP out = new_shelter(x, zone);
+      UNPROTECT(1);
+      return out;
+    }
+
+    if (TYPEOF(x) == REALSXP && dbl_is_local_days_compatible(REAL_RO(x), p_kernel->size)) {
+      p_kernel->p_dbl = REAL_RO(x);
+      p_kernel->fn = p_kernels->dbl_posixct;
+      p_kernel->check = warp_kernel_check_local_days;
+
+      SEXP out = new_shelter(x, zone);
+      UNPROTECT(1);
+      return out;
     }
 
-    p_out[i] = elt;
+    UNPROTECT(1);
+    break;
+  }
+  case warp_class_posixlt: {
+    break;
+  }
+  default: {
+    never_reached("kernel_init_days");
   }
+  }
+
+  // Fall back to offsets that are computed up front, potentially through R
+  SEXP offset = PROTECT(p_kernels->get_offset(x));
+
+  p_kernel->size = Rf_xlength(offset);
+  p_kernel->p_int = INTEGER_RO(offset);
+  p_kernel->fn = int_offset_warp_distance;
+
+  SEXP out = new_shelter(offset, R_NilValue);
 
-  UNPROTECT(n_prot);
+  UNPROTECT(1);
   return out;
 }
 
 // -----------------------------------------------------------------------------
 
-static SEXP date_warp_distance_yday(SEXP x, int every, SEXP origin);
-static SEXP posixct_warp_distance_yday(SEXP x, int every, SEXP origin);
-static SEXP posixlt_warp_distance_yday(SEXP x, int every, SEXP origin);
+static SEXP kernel_init_year(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin) {
+  p_kernel->needs_offset = (origin != R_NilValue);
 
-static SEXP warp_distance_yday(SEXP x, int every, SEXP origin) {
-  if (every > 364) {
-    r_error(
-      "warp_distance_yday",
-      "The maximum allowed value of `every` for `period = 'yday'` is 364."
-    );
-  }
+  if (p_kernel->needs_offset) {
+    SEXP origin_offset_sexp = PROTECT(get_year_offset(origin));
+    int origin_offset = INTEGER(origin_offset_sexp)[0];
 
-  switch (time_class_type(x)) {
-  case warp_class_date: return date_warp_distance_yday(x, every, origin);
-  case warp_class_posixct: return posixct_warp_distance_yday(x, every, origin);
-  case warp_class_posixlt: return posixlt_warp_distance_yday(x, every, origin);
-  default: r_error("warp_distance_yday", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
+    if (origin_offset == NA_INTEGER) {
+      r_error("warp_distance_year", "`origin` cannot be `NA`.");
+    }
+
+    p_kernel->origin_offset = origin_offset;
+    UNPROTECT(1);
   }
+
+  p_kernel->every = every;
+  p_kernel->needs_every = (every != 1);
+
+  return kernel_init_days(p_kernel, x, &year_kernels);
 }
 
+// -----------------------------------------------------------------------------
 
-static SEXP int_date_warp_distance_yday(SEXP x, int every, SEXP origin);
-static SEXP dbl_date_warp_distance_yday(SEXP x, int every, SEXP origin);
+static SEXP kernel_init_month(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin) {
+  p_kernel->needs_offset = (origin != R_NilValue);
 
-static SEXP date_warp_distance_yday(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_date_warp_distance_yday(x, every, origin);
-  case REALSXP: return dbl_date_warp_distance_yday(x, every, origin);
-  default: r_error("date_warp_distance_yday", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
+  if (p_kernel->needs_offset) {
+    SEXP origin_offset_sexp = PROTECT(get_month_offset(origin));
+    int origin_offset = INTEGER(origin_offset_sexp)[0];
+
+    if (origin_offset == NA_INTEGER) {
+      r_error("warp_distance_month", "`origin` cannot be `NA`.");
+    }
+
+    p_kernel->origin_offset = origin_offset;
+    UNPROTECT(1);
   }
-}
 
+  p_kernel->every = every;
+  p_kernel->needs_every = (every != 1);
 
-static SEXP posixct_warp_distance_yday(SEXP x, int every, SEXP origin) {
-  x = PROTECT(as_posixlt_from_posixct(x));
-  SEXP out = posixlt_warp_distance_yday(x, every, origin);
-  UNPROTECT(1);
-  return out;
+  return kernel_init_days(p_kernel, x, &month_kernels);
 }
 
-#define DAYS_IN_YEAR 365
-#define DAYS_IN_LEAP_YEAR 366
-#define is_leap_year(year) ((((year) % 4) == 0 && ((year) % 100) != 0) || ((year) % 400) == 0)
-
-static int compute_yday_distance(int days_since_epoch,
-                                 int year_offset,
-                                 int yday,
-                                 int origin_year_offset,
-                                 int origin_yday,
-                                 int origin_leap,
-                                 int units_in_leap_year,
-                                 int units_in_non_leap_year,
-                                 int leap_years_before_and_including_origin_year,
-                                 int every);
+// -----------------------------------------------------------------------------
 
-static inline int days_before_year(int year_offset);
+static SEXP kernel_init_day(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin) {
+  p_kernel->needs_offset = (origin != R_NilValue);
 
-static SEXP posixlt_warp_distance_yday(SEXP x, int every, SEXP origin) {
-  SEXP year = VECTOR_ELT(x, 5);
-  SEXP yday = VECTOR_ELT(x, 7);
+  if (p_kernel->needs_offset) {
+    SEXP origin_offset_sexp = PROTECT(get_day_offset(origin));
+    int origin_offset = INTEGER(origin_offset_sexp)[0];
 
-  if (TYPEOF(year) != INTSXP) {
-    r_error(
-      "posixlt_warp_distance_yday",
-      "Internal error: The 6th element of the POSIXlt object should be an integer."
-    );
-  }
+    if (origin_offset == NA_INTEGER) {
+      r_error("warp_distance_day", "`origin` cannot be `NA`.");
+    }
 
-  if (TYPEOF(yday) != INTSXP) {
-    r_error(
-      "posixlt_warp_distance_yday",
-      "Internal error: The 8th element of the POSIXlt object should be an integer."
-    );
+    p_kernel->origin_offset = origin_offset;
+    UNPROTECT(1);
   }
 
-  int* p_year = INTEGER(year);
-  int* p_yday = INTEGER(yday);
+  p_kernel->every = every;
+  p_kernel->needs_every = (every != 1);
 
-  R_xlen_t size = Rf_xlength(year);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
+  return kernel_init_days(p_kernel, x, &day_kernels);
+}
 
-  int units_in_non_leap_year = (DAYS_IN_YEAR - 1) / every + 1;
-  int units_in_leap_year = (DAYS_IN_LEAP_YEAR - 1) / every + 1;
+// -----------------------------------------------------------------------------
 
-  struct warp_yday_components origin_components = get_origin_yday_components(origin);
-  int origin_year_offset = origin_components.year_offset;
-  int origin_yday = origin_components.yday;
-  bool origin_leap = is_leap_year(origin_year_offset + 1970);
+#define DAYS_IN_YEAR 365
+#define DAYS_IN_LEAP_YEAR 366
+#define is_leap_year(year) ((((year) % 4) == 0 && ((year) % 100) != 0) || ((year) % 400) == 0)
 
-  int leap_years_before_and_including_origin_year =
-    leap_years_before_and_including_year(origin_year_offset);
+static int64_t compute_yday_distance(int64_t days_since_epoch,
+                                     int year_offset,
+                                     int yday,
+                                     int origin_year_offset,
+                                     int origin_yday,
+                                     int origin_leap,
+                                     int units_in_leap_year,
+                                     int units_in_non_leap_year,
+                                     int leap_years_before_and_including_origin_year,
+                                     const struct warp_divider* p_every);
+
+static inline int64_t days_before_year(int year_offset);
+
+static void posixlt_warp_distance_yday(const struct warp_kernel* p_kernel,
+                                       R_xlen_t from,
+                                       R_xlen_t size,
+                                       double* p_out) {
+  const int* p_year = p_kernel->p_year + from;
+  const int* p_yday = p_kernel->p_yday + from;
+
+  const struct warp_yday_info* p_info = &p_kernel->yday;
+  const struct warp_divider* p_every = &p_kernel->every_divider;
 
   for (R_xlen_t i = 0; i < size; ++i) {
     if (p_year[i] == NA_INTEGER) {
@@ -388,120 +891,234 @@ static SEXP posixlt_warp_distance_yday(SEXP x, int every, SEXP origin) {
     int year_offset = p_year[i] - 70;
     int yday = p_yday[i];
 
-    int days_since_epoch = days_before_year(year_offset) + yday;
+    int64_t days_since_epoch = days_before_year(year_offset) + yday;
 
     p_out[i] = compute_yday_distance(
       days_since_epoch,
       year_offset,
       yday,
-      origin_year_offset,
-      origin_yday,
-      origin_leap,
-      units_in_leap_year,
-      units_in_non_leap_year,
-      leap_years_before_and_including_origin_year,
-      every
+      p_info->origin_year_offset,
+      p_info->origin_yday,
+      p_info->origin_leap,
+      p_info->units_in_leap_year,
+      p_info->units_in_non_leap_year,
+      p_info->leap_years_before_and_including_origin_year,
+      p_every
     );
   }
-
-  UNPROTECT(1);
-  return out;
 }
 
-static SEXP int_date_warp_distance_yday(SEXP x, int every, SEXP origin) {
-  int* p_x = INTEGER(x);
-
-  R_xlen_t size = Rf_xlength(x);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  int units_in_non_leap_year = (DAYS_IN_YEAR - 1) / every + 1;
-  int units_in_leap_year = (DAYS_IN_LEAP_YEAR - 1) / every + 1;
-
-  struct warp_yday_components origin_components = get_origin_yday_components(origin);
-  int origin_year_offset = origin_components.year_offset;
-  int origin_yday = origin_components.yday;
-  bool origin_leap = is_leap_year(origin_year_offset + 1970);
-
-  int leap_years_before_and_including_origin_year =
-    leap_years_before_and_including_year(origin_year_offset);
+// Date and POSIXct are mapped to days since the epoch like in the `"year"`
+// kernels, so POSIXct doesn't have to go through POSIXlt
+#define YDAY_KERNEL(NAME, CTYPE, P_X, IS_MISSING, TO_DAYS)              \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const CTYPE* p_x = p_kernel->P_X + from;                              \
+                                                                        \
+  const struct warp_yday_info* p_info = &p_kernel->yday;                \
+  const struct warp_divider* p_every = &p_kernel->every_divider;        \
+                                                                        \
+  struct warp_zone_cursor cursor;                                       \
+  warp_zone_cursor_init(&cursor, &p_kernel->zone);                      \
+                                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const CTYPE x_elt = p_x[i];                                         \
+                                                                        \
+    if (IS_MISSING(x_elt)) {                                            \
+      p_out[i] = NA_REAL;                                               \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    const int elt = TO_DAYS(x_elt, &cursor);                            \
+                                                                        \
+    struct warp_components components = days_to_components(elt);       \
+                                                                        \
+    p_out[i] = compute_yday_distance(                                   \
+      elt,                                                              \
+      components.year_offset,                                           \
+      components.yday,                                                  \
+      p_info->origin_year_offset,                                       \
+      p_info->origin_yday,                                              \
+      p_info->origin_leap,                                              \
+      p_info->units_in_leap_year,                                       \
+      p_info->units_in_non_leap_year,                                   \
+      p_info->leap_years_before_and_including_origin_year,              \
+      p_every                                                           \
+    );                                                                  \
+  }                                                                     \
+}
+
+YDAY_KERNEL(int_date_warp_distance_yday, int, p_int, INT_IS_MISSING, INT_DATE_TO_DAYS)
+YDAY_KERNEL(dbl_date_warp_distance_yday, double, p_dbl, DBL_IS_MISSING, DBL_DATE_TO_DAYS)
+YDAY_KERNEL(int_posixct_warp_distance_yday, int, p_int, INT_IS_MISSING, INT_POSIXCT_TO_DAYS)
+YDAY_KERNEL(dbl_posixct_warp_distance_yday, double, p_dbl, DBL_IS_MISSING, DBL_POSIXCT_TO_DAYS)
+
+#undef YDAY_KERNEL
+
+// The calendar repeats every 400 years, so double Dates that don't fit in an
+// `int` are moved by whole 400 year cycles to the same day in 1970-2369, and
+// the units in those cycles are added back to its distance. The cycles are
+// counted in double arithmetic, so any finite Date works.
+#define LEAP_YEARS_IN_400_YEARS 97
+
+static void dbl_date_wide_warp_distance_yday(const struct warp_kernel* p_kernel,
+                                             R_xlen_t from,
+                                             R_xlen_t size,
+                                             double* p_out) {
+  const double* p_x = p_kernel->p_dbl + from;
+
+  const struct warp_yday_info* p_info = &p_kernel->yday;
+  const struct warp_divider* p_every = &p_kernel->every_divider;
+
+  const int64_t units_in_400_years =
+    (int64_t) p_info->units_in_leap_year * LEAP_YEARS_IN_400_YEARS +
+    (int64_t) p_info->units_in_non_leap_year * (400 - LEAP_YEARS_IN_400_YEARS);
 
   for (R_xlen_t i = 0; i < size; ++i) {
-    int elt = p_x[i];
+    const double x_elt = p_x[i];
 
-    if (elt == NA_INTEGER) {
+    if (DBL_IS_MISSING(x_elt)) {
       p_out[i] = NA_REAL;
       continue;
     }
 
-    struct warp_components components = convert_days_to_components(elt);
+    double cycles;
+    const int elt = dbl_days_to_cycle_day(trunc(x_elt), &cycles);
 
-    p_out[i] = compute_yday_distance(
+    struct warp_components components = days_to_components(elt);
+
+    const int64_t distance = compute_yday_distance(
       elt,
       components.year_offset,
       components.yday,
-      origin_year_offset,
-      origin_yday,
-      origin_leap,
-      units_in_leap_year,
-      units_in_non_leap_year,
-      leap_years_before_and_including_origin_year,
-      every
+      p_info->origin_year_offset,
+      p_info->origin_yday,
+      p_info->origin_leap,
+      p_info->units_in_leap_year,
+      p_info->units_in_non_leap_year,
+      p_info->leap_years_before_and_including_origin_year,
+      p_every
     );
-  }
 
-  UNPROTECT(1);
-  return out;
+    p_out[i] = cycles * units_in_400_years + distance;
+  }
 }
 
-static SEXP dbl_date_warp_distance_yday(SEXP x, int every, SEXP origin) {
-  double* p_x = REAL(x);
+static SEXP kernel_init_yday(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin) {
+  if (every > 364) {
+    r_error(
+      "warp_distance_yday",
+      "The maximum allowed value of `every` for `period = 'yday'` is 364."
+    );
+  }
+
+  // POSIXct only goes through POSIXlt when its local days can't be computed
+  // natively
+  SEXP zone = R_NilValue;
 
-  R_xlen_t size = Rf_xlength(x);
+  if (time_class_type(x) == warp_class_posixct) {
+    zone = posixct_load_native_zone(&p_kernel->zone, x);
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
+    if (zone == R_NilValue) {
+      x = as_posixlt_from_posixct(x);
+    }
+  }
+
+  PROTECT(zone);
+  PROTECT(x);
 
-  int units_in_non_leap_year = (DAYS_IN_YEAR - 1) / every + 1;
-  int units_in_leap_year = (DAYS_IN_LEAP_YEAR - 1) / every + 1;
+  struct warp_yday_info* p_info = &p_kernel->yday;
+
+  p_info->units_in_non_leap_year = (DAYS_IN_YEAR - 1) / every + 1;
+  p_info->units_in_leap_year = (DAYS_IN_LEAP_YEAR - 1) / every + 1;
 
   struct warp_yday_components origin_components = get_origin_yday_components(origin);
-  int origin_year_offset = origin_components.year_offset;
-  int origin_yday = origin_components.yday;
-  bool origin_leap = is_leap_year(origin_year_offset + 1970);
+  p_info->origin_year_offset = origin_components.year_offset;
+  p_info->origin_yday = origin_components.yday;
+  p_info->origin_leap = is_leap_year(origin_components.year_offset + 1970);
 
-  int leap_years_before_and_including_origin_year =
-    leap_years_before_and_including_year(origin_year_offset);
+  p_info->leap_years_before_and_including_origin_year =
+    leap_years_before_and_including_year(origin_components.year_offset);
 
-  for (R_xlen_t i = 0; i < size; ++i) {
-    double x_elt = p_x[i];
+  p_kernel->every = every;
 
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
+  switch (time_class_type(x)) {
+  case warp_class_date: {
+    p_kernel->size = Rf_xlength(x);
+
+    switch (TYPEOF(x)) {
+    case INTSXP: {
+      p_kernel->p_int = INTEGER_RO(x);
+      p_kernel->fn = int_date_warp_distance_yday;
+      break;
     }
+    case REALSXP: {
+      p_kernel->p_dbl = REAL_RO(x);
 
-    // Truncate fractional pieces towards 0
-    int elt = x_elt;
+      if (dbl_is_days_compatible(p_kernel, p_kernel->p_dbl, p_kernel->size)) {
+        p_kernel->fn = dbl_date_warp_distance_yday;
+        p_kernel->check = warp_kernel_check_days;
+      } else {
+        p_kernel->fn = dbl_date_wide_warp_distance_yday;
+      }
 
-    struct warp_components components = convert_days_to_components(elt);
+      break;
+    }
+    default: {
+      r_error("date_warp_distance_yday", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
+    }
+    }
 
-    p_out[i] = compute_yday_distance(
-      elt,
-      components.year_offset,
-      components.yday,
-      origin_year_offset,
-      origin_yday,
-      origin_leap,
-      units_in_leap_year,
-      units_in_non_leap_year,
-      leap_years_before_and_including_origin_year,
-      every
-    );
+    break;
   }
+  case warp_class_posixct: {
+    p_kernel->size = Rf_xlength(x);
 
-  UNPROTECT(1);
+    if (TYPEOF(x) == INTSXP) {
+      p_kernel->p_int = INTEGER_RO(x);
+      p_kernel->fn = int_posixct_warp_distance_yday;
+    } else {
+      p_kernel->p_dbl = REAL_RO(x);
+      p_kernel->fn = dbl_posixct_warp_distance_yday;
+      p_kernel->check = warp_kernel_check_local_days;
+    }
+
+    break;
+  }
+  case warp_class_posixlt: {
+    SEXP year = VECTOR_ELT(x, 5);
+    SEXP yday = VECTOR_ELT(x, 7);
+
+    if (TYPEOF(year) != INTSXP) {
+      r_error(
+        "posixlt_warp_distance_yday",
+        "Internal error: The 6th element of the POSIXlt object should be an integer."
+      );
+    }
+
+    if (TYPEOF(yday) != INTSXP) {
+      r_error(
+        "posixlt_warp_distance_yday",
+        "Internal error: The 8th element of the POSIXlt object should be an integer."
+      );
+    }
+
+    p_kernel->size = Rf_xlength(year);
+    p_kernel->p_year = INTEGER_RO(year);
+    p_kernel->p_yday = INTEGER_RO(yday);
+    p_kernel->fn = posixlt_warp_distance_yday;
+    break;
+  }
+  default: {
+    r_error("warp_distance_yday", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
+  }
+  }
+
+  SEXP out = new_shelter(x, zone);
+
+  UNPROTECT(2);
   return out;
 }
 
@@ -510,16 +1127,16 @@ static SEXP dbl_date_warp_distance_yday(SEXP x, int every, SEXP origin) {
 
 static inline int yday_leap_adjustment(int year_offset, int yday, bool origin_leap);
 
-static int compute_yday_distance(int days_since_epoch,
-                                 int year_offset,
-                                 int yday,
-                                 int origin_year_offset,
-                                 int origin_yday,
-                                 int origin_leap,
-                                 int units_in_leap_year,
-                                 int units_in_non_leap_year,
-                                 int leap_years_before_and_including_origin_year,
-                                 int every) {
+static int64_t compute_yday_distance(int64_t days_since_epoch,
+                                     int year_offset,
+                                     int yday,
+                                     int origin_year_offset,
+                                     int origin_yday,
+                                     int origin_leap,
+                                     int units_in_leap_year,
+                                     int units_in_non_leap_year,
+                                     int leap_years_before_and_including_origin_year,
+                                     const struct warp_divider* p_every) {
   int origin_yday_adjusted =
     origin_yday +
     yday_leap_adjustment(year_offset, yday, origin_leap);
@@ -529,14 +1146,15 @@ static int compute_yday_distance(int days_since_epoch,
     --last_origin_year_offset;
   }
 
-  int last_origin =
+  int64_t last_origin =
     days_before_year(last_origin_year_offset) +
     origin_yday +
     yday_leap_adjustment(last_origin_year_offset, origin_yday, origin_leap);
 
-  int days_since_last_origin = days_since_epoch - last_origin;
+  // Less than a year
+  int days_since_last_origin = (int) (days_since_epoch - last_origin);
 
-  int units_in_year = int_div(days_since_last_origin, every);
+  int units_in_year = divider_div(days_since_last_origin, p_every);
 
   int years_between_origins = last_origin_year_offset - origin_year_offset;
 
@@ -548,27 +1166,28 @@ static int compute_yday_distance(int days_since_epoch,
     years_between_origins -
     leap_years_between_origins;
 
-  int units_between_origins =
-    units_in_leap_year * leap_years_between_origins +
-    units_in_non_leap_year * non_leap_years_between_origins;
+  int64_t units_between_origins =
+    (int64_t) units_in_leap_year * leap_years_between_origins +
+    (int64_t) units_in_non_leap_year * non_leap_years_between_origins;
 
-  int out = units_between_origins + units_in_year;
+  int64_t out = units_between_origins + units_in_year;
 
   return out;
 }
 
 // Returns the number of days between 1970-01-01 and the beginning of the `year`
-// defined as the number of `year_offset` from 1970, 0-based
+// defined as the number of `year_offset` from 1970, 0-based. The days of the
+// years near the ends of the `int` Date range don't fit in an `int`.
 #define YEARS_FROM_0001_01_01_TO_EPOCH 1969
 #define DAYS_FROM_0001_01_01_TO_EPOCH 719162
 
-static inline int days_before_year(int year_offset) {
+static inline int64_t days_before_year(int year_offset) {
   int year = year_offset + YEARS_FROM_0001_01_01_TO_EPOCH;
 
-  int days = year * 365 +
-    int_div(year, 4) -
-    int_div(year, 100) +
-    int_div(year, 400);
+  int64_t days = (int64_t) year * 365 +
+    divider_div(year, &divider_4) -
+    divider_div(year, &divider_100) +
+    divider_div(year, &divider_400);
 
   days -= DAYS_FROM_0001_01_01_TO_EPOCH;
 
@@ -607,127 +1226,35 @@ static inline int yday_leap_adjustment(int year_offset, int yday, bool origin_le
 
 // -----------------------------------------------------------------------------
 
-static SEXP date_warp_distance_mday(SEXP x, int every, SEXP origin);
-static SEXP posixct_warp_distance_mday(SEXP x, int every, SEXP origin);
-static SEXP posixlt_warp_distance_mday(SEXP x, int every, SEXP origin);
-
-static SEXP warp_distance_mday(SEXP x, int every, SEXP origin) {
-  if (every > 30) {
-    r_error(
-      "warp_distance_mday",
-      "The maximum allowed value of `every` for `period = 'mday'` is 30."
-    );
-  }
-
-  switch (time_class_type(x)) {
-  case warp_class_date: return date_warp_distance_mday(x, every, origin);
-  case warp_class_posixct: return posixct_warp_distance_mday(x, every, origin);
-  case warp_class_posixlt: return posixlt_warp_distance_mday(x, every, origin);
-  default: r_error("warp_distance_mday", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
-  }
-}
-
-
-static SEXP int_date_warp_distance_mday(SEXP x, int every, SEXP origin);
-static SEXP dbl_date_warp_distance_mday(SEXP x, int every, SEXP origin);
-
-static SEXP date_warp_distance_mday(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_date_warp_distance_mday(x, every, origin);
-  case REALSXP: return dbl_date_warp_distance_mday(x, every, origin);
-  default: r_error("date_warp_distance_mday", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
-  }
-}
-
-
-static SEXP posixct_warp_distance_mday(SEXP x, int every, SEXP origin) {
-  x = PROTECT(as_posixlt_from_posixct(x));
-  SEXP out = posixlt_warp_distance_mday(x, every, origin);
-  UNPROTECT(1);
-  return out;
-}
-
 #define is_leap_year(year) ((((year) % 4) == 0 && ((year) % 100) != 0) || ((year) % 400) == 0)
 
 static inline void fill_units_per_month(int* x, int every);
 static inline void fill_units_per_month_leap(int* x, int every);
-static inline int units_per_year(int* x);
+static inline int units_per_year(const int* x);
 static inline int units_up_to_month(int month, const int* units_in_month, int every);
 
-static inline int compute_mday_distance(int day,
-                                        int month,
-                                        int year_offset,
-                                        int origin_year_offset,
-                                        int units_per_year_leap_year,
-                                        int units_per_year_non_leap_year,
-                                        int* units_per_month_leap_year,
-                                        int* units_per_month_non_leap_year,
-                                        int units_up_to_origin_month,
-                                        int leap_years_before_and_including_origin_year,
-                                        int every);
-
-static SEXP posixlt_warp_distance_mday(SEXP x, int every, SEXP origin) {
-  SEXP year = VECTOR_ELT(x, 5);
-  SEXP month = VECTOR_ELT(x, 4);
-  SEXP day = VECTOR_ELT(x, 3);
-
-  if (TYPEOF(year) != INTSXP) {
-    r_error(
-      "posixlt_warp_distance_mday",
-      "Internal error: The 5th element of the POSIXlt object should be an integer."
-    );
-  }
-
-  if (TYPEOF(month) != INTSXP) {
-    r_error(
-      "posixlt_warp_distance_mday",
-      "Internal error: The 4th element of the POSIXlt object should be an integer."
-    );
-  }
-
-  if (TYPEOF(day) != INTSXP) {
-    r_error(
-      "posixlt_warp_distance_mday",
-      "Internal error: The 3rd element of the POSIXlt object should be an integer."
-    );
-  }
-
-  int* p_year = INTEGER(year);
-  int* p_month = INTEGER(month);
-  int* p_day = INTEGER(day);
-
-  R_xlen_t size = Rf_xlength(year);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  int units_per_month_non_leap_year[12];
-  int units_per_month_leap_year[12];
-
-  fill_units_per_month(units_per_month_non_leap_year, every);
-  fill_units_per_month_leap(units_per_month_leap_year, every);
-
-  int units_per_year_non_leap_year = units_per_year(units_per_month_non_leap_year);
-  int units_per_year_leap_year = units_per_year(units_per_month_leap_year);
-
-  struct warp_mday_components origin_components = get_origin_mday_components(origin);
-  int origin_year_offset = origin_components.year_offset;
-  int origin_year = origin_year_offset + 1970;
-  int origin_month = origin_components.month;
-
-  int* units_per_month =
-    is_leap_year(origin_year) ?
-    units_per_month_leap_year :
-    units_per_month_non_leap_year;
-
-  int units_up_to_origin_month = units_up_to_month(
-    origin_month,
-    units_per_month,
-    every
-  );
-
-  int leap_years_before_and_including_origin_year =
-    leap_years_before_and_including_year(origin_year_offset);
+static inline int64_t compute_mday_distance(int day,
+                                            int month,
+                                            int year_offset,
+                                            int origin_year_offset,
+                                            int units_per_year_leap_year,
+                                            int units_per_year_non_leap_year,
+                                            const int* units_per_month_leap_year,
+                                            const int* units_per_month_non_leap_year,
+                                            int units_up_to_origin_month,
+                                            int leap_years_before_and_including_origin_year,
+                                            const struct warp_divider* p_every);
+
+static void posixlt_warp_distance_mday(const struct warp_kernel* p_kernel,
+                                       R_xlen_t from,
+                                       R_xlen_t size,
+                                       double* p_out) {
+  const int* p_year = p_kernel->p_year + from;
+  const int* p_month = p_kernel->p_month + from;
+  const int* p_day = p_kernel->p_day + from;
+
+  const struct warp_mday_info* p_info = &p_kernel->mday;
+  const struct warp_divider* p_every = &p_kernel->every_divider;
 
   for (R_xlen_t i = 0; i < size; ++i) {
     int year_offset = p_year[i];
@@ -746,165 +1273,265 @@ static SEXP posixlt_warp_distance_mday(SEXP x, int every, SEXP origin) {
       day,
       month,
       year_offset,
-      origin_year_offset,
-      units_per_year_leap_year,
-      units_per_year_non_leap_year,
-      units_per_month_leap_year,
-      units_per_month_non_leap_year,
-      units_up_to_origin_month,
-      leap_years_before_and_including_origin_year,
-      every
+      p_info->origin_year_offset,
+      p_info->units_per_year_leap_year,
+      p_info->units_per_year_non_leap_year,
+      p_info->units_per_month_leap_year,
+      p_info->units_per_month_non_leap_year,
+      p_info->units_up_to_origin_month,
+      p_info->leap_years_before_and_including_origin_year,
+      p_every
     );
   }
-
-  UNPROTECT(1);
-  return out;
 }
 
-static SEXP int_date_warp_distance_mday(SEXP x, int every, SEXP origin) {
-  int* p_x = INTEGER(x);
-
-  R_xlen_t size = Rf_xlength(x);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  int units_per_month_non_leap_year[12];
-  int units_per_month_leap_year[12];
-
-  fill_units_per_month(units_per_month_non_leap_year, every);
-  fill_units_per_month_leap(units_per_month_leap_year, every);
-
-  int units_per_year_non_leap_year = units_per_year(units_per_month_non_leap_year);
-  int units_per_year_leap_year = units_per_year(units_per_month_leap_year);
-
-  struct warp_mday_components origin_components = get_origin_mday_components(origin);
-  int origin_year_offset = origin_components.year_offset;
-  int origin_year = origin_year_offset + 1970;
-  int origin_month = origin_components.month;
-
-  int* units_per_month =
-    is_leap_year(origin_year) ?
-    units_per_month_leap_year :
-    units_per_month_non_leap_year;
-
-  int units_up_to_origin_month = units_up_to_month(
-    origin_month,
-    units_per_month,
-    every
-  );
-
-  int leap_years_before_and_including_origin_year =
-    leap_years_before_and_including_year(origin_year_offset);
+#define MDAY_KERNEL(NAME, CTYPE, P_X, IS_MISSING, TO_DAYS)              \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const CTYPE* p_x = p_kernel->P_X + from;                              \
+                                                                        \
+  const struct warp_mday_info* p_info = &p_kernel->mday;                \
+  const struct warp_divider* p_every = &p_kernel->every_divider;        \
+                                                                        \
+  struct warp_zone_cursor cursor;                                       \
+  warp_zone_cursor_init(&cursor, &p_kernel->zone);                      \
+                                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const CTYPE x_elt = p_x[i];                                         \
+                                                                        \
+    if (IS_MISSING(x_elt)) {                                            \
+      p_out[i] = NA_REAL;                                               \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    const int elt = TO_DAYS(x_elt, &cursor);                            \
+                                                                        \
+    struct warp_components components = days_to_components(elt);       \
+                                                                        \
+    p_out[i] = compute_mday_distance(                                   \
+      components.day,                                                   \
+      components.month,                                                 \
+      components.year_offset,                                           \
+      p_info->origin_year_offset,                                       \
+      p_info->units_per_year_leap_year,                                 \
+      p_info->units_per_year_non_leap_year,                             \
+      p_info->units_per_month_leap_year,                                \
+      p_info->units_per_month_non_leap_year,                            \
+      p_info->units_up_to_origin_month,                                 \
+      p_info->leap_years_before_and_including_origin_year,              \
+      p_every                                                           \
+    );                                                                  \
+  }                                                                     \
+}
+
+MDAY_KERNEL(int_date_warp_distance_mday, int, p_int, INT_IS_MISSING, INT_DATE_TO_DAYS)
+MDAY_KERNEL(dbl_date_warp_distance_mday, double, p_dbl, DBL_IS_MISSING, DBL_DATE_TO_DAYS)
+MDAY_KERNEL(int_posixct_warp_distance_mday, int, p_int, INT_IS_MISSING, INT_POSIXCT_TO_DAYS)
+MDAY_KERNEL(dbl_posixct_warp_distance_mday, double, p_dbl, DBL_IS_MISSING, DBL_POSIXCT_TO_DAYS)
+
+#undef MDAY_KERNEL
+
+// Like `dbl_date_wide_warp_distance_yday()`
+static void dbl_date_wide_warp_distance_mday(const struct warp_kernel* p_kernel,
+                                             R_xlen_t from,
+                                             R_xlen_t size,
+                                             double* p_out) {
+  const double* p_x = p_kernel->p_dbl + from;
+
+  const struct warp_mday_info* p_info = &p_kernel->mday;
+  const struct warp_divider* p_every = &p_kernel->every_divider;
+
+  const int64_t units_in_400_years =
+    (int64_t) p_info->units_per_year_leap_year * LEAP_YEARS_IN_400_YEARS +
+    (int64_t) p_info->units_per_year_non_leap_year * (400 - LEAP_YEARS_IN_400_YEARS);
 
   for (R_xlen_t i = 0; i < size; ++i) {
-    int elt = p_x[i];
+    const double x_elt = p_x[i];
 
-    if (elt == NA_INTEGER) {
+    if (DBL_IS_MISSING(x_elt)) {
       p_out[i] = NA_REAL;
       continue;
     }
 
-    struct warp_components components = convert_days_to_components(elt);
+    double cycles;
+    const int elt = dbl_days_to_cycle_day(trunc(x_elt), &cycles);
 
-    p_out[i] = compute_mday_distance(
+    struct warp_components components = days_to_components(elt);
+
+    const int64_t distance = compute_mday_distance(
       components.day,
       components.month,
       components.year_offset,
-      origin_year_offset,
-      units_per_year_leap_year,
-      units_per_year_non_leap_year,
-      units_per_month_leap_year,
-      units_per_month_non_leap_year,
-      units_up_to_origin_month,
-      leap_years_before_and_including_origin_year,
-      every
+      p_info->origin_year_offset,
+      p_info->units_per_year_leap_year,
+      p_info->units_per_year_non_leap_year,
+      p_info->units_per_month_leap_year,
+      p_info->units_per_month_non_leap_year,
+      p_info->units_up_to_origin_month,
+      p_info->leap_years_before_and_including_origin_year,
+      p_every
     );
-  }
 
-  UNPROTECT(1);
-  return out;
+    p_out[i] = cycles * units_in_400_years + distance;
+  }
 }
 
-static SEXP dbl_date_warp_distance_mday(SEXP x, int every, SEXP origin) {
-  double* p_x = REAL(x);
+#undef LEAP_YEARS_IN_400_YEARS
+
+static SEXP kernel_init_mday(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin) {
+  if (every > 30) {
+    r_error(
+      "warp_distance_mday",
+      "The maximum allowed value of `every` for `period = 'mday'` is 30."
+    );
+  }
+
+  // POSIXct only goes through POSIXlt when its local days can't be computed
+  // natively
+  SEXP zone = R_NilValue;
 
-  R_xlen_t size = Rf_xlength(x);
+  if (time_class_type(x) == warp_class_posixct) {
+    zone = posixct_load_native_zone(&p_kernel->zone, x);
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
+    if (zone == R_NilValue) {
+      x = as_posixlt_from_posixct(x);
+    }
+  }
 
-  int units_per_month_non_leap_year[12];
-  int units_per_month_leap_year[12];
+  PROTECT(zone);
+  PROTECT(x);
 
-  fill_units_per_month(units_per_month_non_leap_year, every);
-  fill_units_per_month_leap(units_per_month_leap_year, every);
+  struct warp_mday_info* p_info = &p_kernel->mday;
 
-  int units_per_year_non_leap_year = units_per_year(units_per_month_non_leap_year);
-  int units_per_year_leap_year = units_per_year(units_per_month_leap_year);
+  fill_units_per_month(p_info->units_per_month_non_leap_year, every);
+  fill_units_per_month_leap(p_info->units_per_month_leap_year, every);
+
+  p_info->units_per_year_non_leap_year = units_per_year(p_info->units_per_month_non_leap_year);
+  p_info->units_per_year_leap_year = units_per_year(p_info->units_per_month_leap_year);
 
   struct warp_mday_components origin_components = get_origin_mday_components(origin);
   int origin_year_offset = origin_components.year_offset;
   int origin_year = origin_year_offset + 1970;
   int origin_month = origin_components.month;
 
-  int* units_per_month =
+  const int* units_per_month =
     is_leap_year(origin_year) ?
-    units_per_month_leap_year :
-    units_per_month_non_leap_year;
+    p_info->units_per_month_leap_year :
+    p_info->units_per_month_non_leap_year;
+
+  p_info->origin_year_offset = origin_year_offset;
 
-  int units_up_to_origin_month = units_up_to_month(
+  p_info->units_up_to_origin_month = units_up_to_month(
     origin_month,
     units_per_month,
     every
   );
 
-  int leap_years_before_and_including_origin_year =
+  p_info->leap_years_before_and_including_origin_year =
     leap_years_before_and_including_year(origin_year_offset);
 
-  for (R_xlen_t i = 0; i < size; ++i) {
-    double x_elt = p_x[i];
+  p_kernel->every = every;
 
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
+  switch (time_class_type(x)) {
+  case warp_class_date: {
+    p_kernel->size = Rf_xlength(x);
+
+    switch (TYPEOF(x)) {
+    case INTSXP: {
+      p_kernel->p_int = INTEGER_RO(x);
+      p_kernel->fn = int_date_warp_distance_mday;
+      break;
     }
+    case REALSXP: {
+      p_kernel->p_dbl = REAL_RO(x);
 
-    // Truncate fractional pieces towards 0
-    int elt = x_elt;
+      if (dbl_is_days_compatible(p_kernel, p_kernel->p_dbl, p_kernel->size)) {
+        p_kernel->fn = dbl_date_warp_distance_mday;
+        p_kernel->check = warp_kernel_check_days;
+      } else {
+        p_kernel->fn = dbl_date_wide_warp_distance_mday;
+      }
 
-    struct warp_components components = convert_days_to_components(elt);
+      break;
+    }
+    default: {
+      r_error("date_warp_distance_mday", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
+    }
+    }
 
-    p_out[i] = compute_mday_distance(
-      components.day,
-      components.month,
-      components.year_offset,
-      origin_year_offset,
-      units_per_year_leap_year,
-      units_per_year_non_leap_year,
-      units_per_month_leap_year,
-      units_per_month_non_leap_year,
-      units_up_to_origin_month,
-      leap_years_before_and_including_origin_year,
-      every
-    );
+    break;
   }
+  case warp_class_posixct: {
+    p_kernel->size = Rf_xlength(x);
 
-  UNPROTECT(1);
+    if (TYPEOF(x) == INTSXP) {
+      p_kernel->p_int = INTEGER_RO(x);
+      p_kernel->fn = int_posixct_warp_distance_mday;
+    } else {
+      p_kernel->p_dbl = REAL_RO(x);
+      p_kernel->fn = dbl_posixct_warp_distance_mday;
+      p_kernel->check = warp_kernel_check_local_days;
+    }
+
+    break;
+  }
+  case warp_class_posixlt: {
+    SEXP year = VECTOR_ELT(x, 5);
+    SEXP month = VECTOR_ELT(x, 4);
+    SEXP day = VECTOR_ELT(x, 3);
+
+    if (TYPEOF(year) != INTSXP) {
+      r_error(
+        "posixlt_warp_distance_mday",
+        "Internal error: The 5th element of the POSIXlt object should be an integer."
+      );
+    }
+
+    if (TYPEOF(month) != INTSXP) {
+      r_error(
+        "posixlt_warp_distance_mday",
+        "Internal error: The 4th element of the POSIXlt object should be an integer."
+      );
+    }
+
+    if (TYPEOF(day) != INTSXP) {
+      r_error(
+        "posixlt_warp_distance_mday",
+        "Internal error: The 3rd element of the POSIXlt object should be an integer."
+      );
+    }
+
+    p_kernel->size = Rf_xlength(year);
+    p_kernel->p_year = INTEGER_RO(year);
+    p_kernel->p_month = INTEGER_RO(month);
+    p_kernel->p_day = INTEGER_RO(day);
+    p_kernel->fn = posixlt_warp_distance_mday;
+    break;
+  }
+  default: {
+    r_error("warp_distance_mday", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
+  }
+  }
+
+  SEXP out = new_shelter(x, zone);
+
+  UNPROTECT(2);
   return out;
 }
 
-static inline int compute_mday_distance(int day,
-                                        int month,
-                                        int year_offset,
-                                        int origin_year_offset,
-                                        int units_per_year_leap_year,
-                                        int units_per_year_non_leap_year,
-                                        int* units_per_month_leap_year,
-                                        int* units_per_month_non_leap_year,
-                                        int units_up_to_origin_month,
-                                        int leap_years_before_and_including_origin_year,
-                                        int every) {
+static inline int64_t compute_mday_distance(int day,
+                                            int month,
+                                            int year_offset,
+                                            int origin_year_offset,
+                                            int units_per_year_leap_year,
+                                            int units_per_year_non_leap_year,
+                                            const int* units_per_month_leap_year,
+                                            const int* units_per_month_non_leap_year,
+                                            int units_up_to_origin_month,
+                                            int leap_years_before_and_including_origin_year,
+                                            const struct warp_divider* p_every) {
 
   int years_between = year_offset - origin_year_offset;
 
@@ -916,14 +1543,14 @@ static inline int compute_mday_distance(int day,
     years_between -
     leap_years_between;
 
-  int units_between_years =
-    leap_years_between * units_per_year_leap_year +
-    non_leap_years_between * units_per_year_non_leap_year;
+  int64_t units_between_years =
+    (int64_t) leap_years_between * units_per_year_leap_year +
+    (int64_t) non_leap_years_between * units_per_year_non_leap_year;
 
   int year = year_offset + 1970;
   bool is_leap = is_leap_year(year);
 
-  int* units_per_month =
+  const int* units_per_month =
     is_leap ?
     units_per_month_leap_year :
     units_per_month_non_leap_year;
@@ -931,1116 +1558,1238 @@ static inline int compute_mday_distance(int day,
   int units_up_to_elt_month = units_up_to_month(
     month,
     units_per_month,
-    every
+    p_every->divisor
   );
 
-  int units_in_month = day / every;
+  int units_in_month = divider_div(day, p_every);
 
-  int out =
+  int64_t out =
     units_between_years -
     units_up_to_origin_month +
     units_up_to_elt_month +
     units_in_month;
 
-  return out;
-}
-
-#undef is_leap_year
-
-static const int DAYS_IN_MONTH[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-static const int DAYS_IN_MONTH_LEAP[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-
-static inline void fill_units_per_month(int* x, int every) {
-  for (int i = 0; i < 12; ++i) {
-    x[i] = (DAYS_IN_MONTH[i] - 1) / every + 1;
-  }
-}
-
-static inline void fill_units_per_month_leap(int* x, int every) {
-  for (int i = 0; i < 12; ++i) {
-    x[i] = (DAYS_IN_MONTH_LEAP[i] - 1) / every + 1;
-  }
-}
-
-static inline int units_per_year(int* x) {
-  int out = 0;
-
-  for (int i = 0; i < 12; ++i) {
-    out += x[i];
-  }
-
-  return out;
-}
-
-static inline int units_up_to_month(int month, const int* units_per_month, int every) {
-  int out = 0;
-
-  for (int i = 0; i < month; ++i) {
-    out += units_per_month[i];
-  }
-
-  return out;
-}
-
-// -----------------------------------------------------------------------------
-
-static SEXP date_warp_distance_hour(SEXP x, int every, SEXP origin);
-static SEXP posixct_warp_distance_hour(SEXP x, int every, SEXP origin);
-static SEXP posixlt_warp_distance_hour(SEXP x, int every, SEXP origin);
-
-static SEXP warp_distance_hour(SEXP x, int every, SEXP origin) {
-  switch (time_class_type(x)) {
-  case warp_class_date: return date_warp_distance_hour(x, every, origin);
-  case warp_class_posixct: return posixct_warp_distance_hour(x, every, origin);
-  case warp_class_posixlt: return posixlt_warp_distance_hour(x, every, origin);
-  default: r_error("warp_distance_hour", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
-  }
-}
-
-
-static SEXP int_date_warp_distance_hour(SEXP x, int every, SEXP origin);
-static SEXP dbl_date_warp_distance_hour(SEXP x, int every, SEXP origin);
-
-static SEXP date_warp_distance_hour(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_date_warp_distance_hour(x, every, origin);
-  case REALSXP: return dbl_date_warp_distance_hour(x, every, origin);
-  default: r_error("date_warp_distance_hour", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
-  }
-}
-
-
-static SEXP int_posixct_warp_distance_hour(SEXP x, int every, SEXP origin);
-static SEXP dbl_posixct_warp_distance_hour(SEXP x, int every, SEXP origin);
-
-static SEXP posixct_warp_distance_hour(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_posixct_warp_distance_hour(x, every, origin);
-  case REALSXP: return dbl_posixct_warp_distance_hour(x, every, origin);
-  default: r_error("posixct_warp_distance_hour", "Unknown `POSIXct` type %s.", Rf_type2char(TYPEOF(x)));
-  }
-}
-
-
-static SEXP posixlt_warp_distance_hour(SEXP x, int every, SEXP origin) {
-  x = PROTECT(as_datetime(x));
-  SEXP out = PROTECT(posixct_warp_distance_hour(x, every, origin));
-
-  UNPROTECT(2);
-  return out;
-}
-
-
-#define HOURS_IN_DAY 24
-
-static SEXP int_date_warp_distance_hour(SEXP x, int every, SEXP origin) {
-  R_xlen_t size = Rf_xlength(x);
-
-  int* p_x = INTEGER(x);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_days_from_epoch(origin);
-  }
-
-  for (R_xlen_t i = 0; i < size; ++i) {
-    int elt = p_x[i];
-
-    if (elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
-
-    elt *= HOURS_IN_DAY;
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
-
-    p_out[i] = elt;
-  }
-
-  UNPROTECT(1);
-  return out;
-}
-
-static SEXP dbl_date_warp_distance_hour(SEXP x, int every, SEXP origin) {
-  R_xlen_t size = Rf_xlength(x);
-
-  double* p_x = REAL(x);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_days_from_epoch(origin);
-  }
-
-  for (R_xlen_t i = 0; i < size; ++i) {
-    double x_elt = p_x[i];
-
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
-
-    // Truncate to completely ignore fractional Date parts
-    int elt = x_elt;
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
-
-    elt *= HOURS_IN_DAY;
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
-
-    p_out[i] = elt;
-  }
-
-  UNPROTECT(1);
-  return out;
-}
-
-#undef HOURS_IN_DAY
-
-#define SECONDS_IN_HOUR 3600
-
-static SEXP int_posixct_warp_distance_hour(SEXP x, int every, SEXP origin) {
-  R_xlen_t size = Rf_xlength(x);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int64_t origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_seconds_from_epoch(origin);
-  }
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  int* p_x = INTEGER(x);
-
-  for (R_xlen_t i = 0; i < size; ++i) {
-    int x_elt = p_x[i];
-
-    if (x_elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
-
-    // Avoid overflow
-    int64_t elt = x_elt;
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (SECONDS_IN_HOUR - 1)) / SECONDS_IN_HOUR;
-    } else {
-      elt = elt / SECONDS_IN_HOUR;
-    }
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
-
-    p_out[i] = elt;
-  }
-
-  UNPROTECT(1);
-  return out;
-}
-
-static SEXP dbl_posixct_warp_distance_hour(SEXP x, int every, SEXP origin) {
-  R_xlen_t size = Rf_xlength(x);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int64_t origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_seconds_from_epoch(origin);
-  }
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  double* p_x = REAL(x);
-
-  for (R_xlen_t i = 0; i < size; ++i) {
-    double x_elt = p_x[i];
-
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
-
-    int64_t elt = guarded_floor(x_elt);
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (SECONDS_IN_HOUR - 1)) / SECONDS_IN_HOUR;
-    } else {
-      elt = elt / SECONDS_IN_HOUR;
-    }
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
-
-    p_out[i] = elt;
-  }
-
-  UNPROTECT(1);
-  return out;
-}
-
-#undef SECONDS_IN_HOUR
-
-// -----------------------------------------------------------------------------
-
-static SEXP date_warp_distance_minute(SEXP x, int every, SEXP origin);
-static SEXP posixct_warp_distance_minute(SEXP x, int every, SEXP origin);
-static SEXP posixlt_warp_distance_minute(SEXP x, int every, SEXP origin);
-
-static SEXP warp_distance_minute(SEXP x, int every, SEXP origin) {
-  switch (time_class_type(x)) {
-  case warp_class_date: return date_warp_distance_minute(x, every, origin);
-  case warp_class_posixct: return posixct_warp_distance_minute(x, every, origin);
-  case warp_class_posixlt: return posixlt_warp_distance_minute(x, every, origin);
-  default: r_error("warp_distance_minute", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
-  }
-}
-
-
-static SEXP int_date_warp_distance_minute(SEXP x, int every, SEXP origin);
-static SEXP dbl_date_warp_distance_minute(SEXP x, int every, SEXP origin);
-
-static SEXP date_warp_distance_minute(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_date_warp_distance_minute(x, every, origin);
-  case REALSXP: return dbl_date_warp_distance_minute(x, every, origin);
-  default: r_error("date_warp_distance_minute", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
-  }
-}
-
-
-static SEXP int_posixct_warp_distance_minute(SEXP x, int every, SEXP origin);
-static SEXP dbl_posixct_warp_distance_minute(SEXP x, int every, SEXP origin);
-
-static SEXP posixct_warp_distance_minute(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_posixct_warp_distance_minute(x, every, origin);
-  case REALSXP: return dbl_posixct_warp_distance_minute(x, every, origin);
-  default: r_error("posixct_warp_distance_minute", "Unknown `POSIXct` type %s.", Rf_type2char(TYPEOF(x)));
-  }
-}
-
-
-static SEXP posixlt_warp_distance_minute(SEXP x, int every, SEXP origin) {
-  x = PROTECT(as_datetime(x));
-  SEXP out = PROTECT(posixct_warp_distance_minute(x, every, origin));
-
-  UNPROTECT(2);
-  return out;
-}
-
-
-#define MINUTES_IN_DAY 1440
-
-static SEXP int_date_warp_distance_minute(SEXP x, int every, SEXP origin) {
-  R_xlen_t size = Rf_xlength(x);
-
-  int* p_x = INTEGER(x);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_days_from_epoch(origin);
-  }
-
-  for (R_xlen_t i = 0; i < size; ++i) {
-    int elt = p_x[i];
-
-    if (elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
-
-    elt *= MINUTES_IN_DAY;
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
-
-    p_out[i] = elt;
-  }
-
-  UNPROTECT(1);
-  return out;
-}
-
-static SEXP dbl_date_warp_distance_minute(SEXP x, int every, SEXP origin) {
-  R_xlen_t size = Rf_xlength(x);
-
-  double* p_x = REAL(x);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_days_from_epoch(origin);
-  }
-
-  for (R_xlen_t i = 0; i < size; ++i) {
-    double x_elt = p_x[i];
-
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
-
-    // Truncate to completely ignore fractional Date parts
-    int elt = x_elt;
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
-
-    elt *= MINUTES_IN_DAY;
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
-
-    p_out[i] = elt;
-  }
-
-  UNPROTECT(1);
-  return out;
-}
-
-#undef MINUTES_IN_DAY
-
-#define SECONDS_IN_MINUTE 60
-
-static SEXP int_posixct_warp_distance_minute(SEXP x, int every, SEXP origin) {
-  R_xlen_t size = Rf_xlength(x);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int64_t origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_seconds_from_epoch(origin);
-  }
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  int* p_x = INTEGER(x);
-
-  for (R_xlen_t i = 0; i < size; ++i) {
-    int x_elt = p_x[i];
-
-    if (x_elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
-
-    // Avoid overflow
-    int64_t elt = x_elt;
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (SECONDS_IN_MINUTE - 1)) / SECONDS_IN_MINUTE;
-    } else {
-      elt = elt / SECONDS_IN_MINUTE;
-    }
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
-
-    p_out[i] = elt;
-  }
-
-  UNPROTECT(1);
-  return out;
-}
-
-static SEXP dbl_posixct_warp_distance_minute(SEXP x, int every, SEXP origin) {
-  R_xlen_t size = Rf_xlength(x);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int64_t origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_seconds_from_epoch(origin);
-  }
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, size));
-  double* p_out = REAL(out);
-
-  double* p_x = REAL(x);
-
-  for (R_xlen_t i = 0; i < size; ++i) {
-    double x_elt = p_x[i];
-
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
-
-    int64_t elt = guarded_floor(x_elt);
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (SECONDS_IN_MINUTE - 1)) / SECONDS_IN_MINUTE;
-    } else {
-      elt = elt / SECONDS_IN_MINUTE;
-    }
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
-
-    p_out[i] = elt;
-  }
-
-  UNPROTECT(1);
-  return out;
-}
-
-#undef SECONDS_IN_MINUTE
-
-// -----------------------------------------------------------------------------
-
-static SEXP date_warp_distance_second(SEXP x, int every, SEXP origin);
-static SEXP posixct_warp_distance_second(SEXP x, int every, SEXP origin);
-static SEXP posixlt_warp_distance_second(SEXP x, int every, SEXP origin);
-
-static SEXP warp_distance_second(SEXP x, int every, SEXP origin) {
-  switch (time_class_type(x)) {
-  case warp_class_date: return date_warp_distance_second(x, every, origin);
-  case warp_class_posixct: return posixct_warp_distance_second(x, every, origin);
-  case warp_class_posixlt: return posixlt_warp_distance_second(x, every, origin);
-  default: r_error("warp_distance_second", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
-  }
+  return out;
 }
 
+#undef is_leap_year
 
-static SEXP int_date_warp_distance_second(SEXP x, int every, SEXP origin);
-static SEXP dbl_date_warp_distance_second(SEXP x, int every, SEXP origin);
+static const int DAYS_IN_MONTH[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+static const int DAYS_IN_MONTH_LEAP[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 
-static SEXP date_warp_distance_second(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_date_warp_distance_second(x, every, origin);
-  case REALSXP: return dbl_date_warp_distance_second(x, every, origin);
-  default: r_error("date_warp_distance_second", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
+static inline void fill_units_per_month(int* x, int every) {
+  for (int i = 0; i < 12; ++i) {
+    x[i] = (DAYS_IN_MONTH[i] - 1) / every + 1;
   }
 }
 
-
-static SEXP int_posixct_warp_distance_second(SEXP x, int every, SEXP origin);
-static SEXP dbl_posixct_warp_distance_second(SEXP x, int every, SEXP origin);
-
-static SEXP posixct_warp_distance_second(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_posixct_warp_distance_second(x, every, origin);
-  case REALSXP: return dbl_posixct_warp_distance_second(x, every, origin);
-  default: r_error("posixct_warp_distance_second", "Unknown `POSIXct` type %s.", Rf_type2char(TYPEOF(x)));
+static inline void fill_units_per_month_leap(int* x, int every) {
+  for (int i = 0; i < 12; ++i) {
+    x[i] = (DAYS_IN_MONTH_LEAP[i] - 1) / every + 1;
   }
 }
 
+static inline int units_per_year(const int* x) {
+  int out = 0;
 
-static SEXP posixlt_warp_distance_second(SEXP x, int every, SEXP origin) {
-  x = PROTECT(as_datetime(x));
-  SEXP out = PROTECT(posixct_warp_distance_second(x, every, origin));
+  for (int i = 0; i < 12; ++i) {
+    out += x[i];
+  }
 
-  UNPROTECT(2);
   return out;
 }
 
+static inline int units_up_to_month(int month, const int* units_per_month, int every) {
+  int out = 0;
 
-#define SECONDS_IN_DAY 86400
+  for (int i = 0; i < month; ++i) {
+    out += units_per_month[i];
+  }
 
-static SEXP int_date_warp_distance_second(SEXP x, int every, SEXP origin) {
-  R_xlen_t x_size = Rf_xlength(x);
+  return out;
+}
 
-  int* p_x = INTEGER(x);
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, x_size));
-  double* p_out = REAL(out);
+// -----------------------------------------------------------------------------
 
-  bool needs_every = (every != 1);
+/*
+ * The `"hour"`, `"minute"`, `"second"`, and `"millisecond"` kernels work on
+ * fixed width units, so no calendar information is required.
+ *
+ * - Date: days since the origin, scaled up to the unit.
+ * - POSIXct: seconds (or milliseconds) since the origin, floored down to
+ *   the unit.
+ * - POSIXlt: the seconds are computed from the fields natively, see
+ *   `posixlt_seconds()`, or the input is converted to POSIXct through R up
+ *   front when that isn't possible.
+ *
+ * Both Date and integer POSIXct compute in 64-bit arithmetic, and divide by
+ * `every` with a hardware division. With `every` other than `1`, a range
+ * scan of the input picks a narrow kernel instead, if every value fits in
+ * `int` arithmetic. The narrow kernels fold the unit and `every` into a
+ * single fast divider, and are specialized on the storage type, whether
+ * there are missing values, and whether there is an origin offset, so their
+ * loops don't branch on anything that is fixed for the call. With
+ * `every = 1`, the only division is by a constant unit, which the compiler
+ * already turns into a multiplication, and the scan would cost more than it
+ * saves. Double POSIXct already computes in doubles, see `simd.c`.
+ *
+ * With `clock = "local"`, POSIXct and POSIXlt count units of the local wall
+ * clock instead of elapsed units. The seconds are shifted by the UTC offset
+ * in effect, so buckets stay aligned with the wall clock across DST
+ * transitions, and the repeated hour of a fall back transition shares its
+ * buckets with the first one. Date has no time of day, so both clocks are
+ * the same for it.
+ */
 
-  bool needs_offset = (origin != R_NilValue);
-  int origin_offset;
+// The days are 64-bit, so any `int` Date, and any double Date within
+// `WARP_WIDE_DAYS_LIMIT`, can be scaled to milliseconds without overflow
+#define DATE_FIXED_KERNEL(NAME, CTYPE, P_X, IS_MISSING, UNITS_IN_DAY)    \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const CTYPE* p_x = p_kernel->P_X + from;                              \
+                                                                        \
+  const bool needs_offset = p_kernel->needs_offset;                     \
+  const int64_t origin_offset = p_kernel->origin_offset;                \
+                                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const CTYPE x_elt = p_x[i];                                         \
+                                                                        \
+    if (IS_MISSING(x_elt)) {                                            \
+      p_out[i] = NA_REAL;                                               \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    /* Truncate to completely ignore fractional Date parts */           \
+    int64_t elt = (int64_t) x_elt;                                      \
+                                                                        \
+    if (needs_offset) {                                                 \
+      elt -= origin_offset;                                             \
+    }                                                                   \
+                                                                        \
+    elt *= UNITS_IN_DAY;                                                \
+                                                                        \
+    APPLY_EVERY_WIDE(elt, p_kernel);                                    \
+                                                                        \
+    p_out[i] = elt;                                                     \
+  }                                                                     \
+}
+
+#define POSIXCT_FIXED_KERNEL(NAME, CTYPE, P_X, IS_MISSING, TO_INT64, UNIT) \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const CTYPE* p_x = p_kernel->P_X + from;                              \
+                                                                        \
+  const bool needs_offset = p_kernel->needs_offset;                     \
+  const int64_t origin_offset = p_kernel->origin_offset;                \
+                                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const CTYPE x_elt = p_x[i];                                         \
+                                                                        \
+    if (IS_MISSING(x_elt)) {                                            \
+      p_out[i] = NA_REAL;                                               \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    int64_t elt = TO_INT64(x_elt);                                      \
+                                                                        \
+    if (needs_offset) {                                                 \
+      elt -= origin_offset;                                             \
+    }                                                                   \
+                                                                        \
+    if (UNIT != 1) {                                                    \
+      if (elt < 0) {                                                    \
+        elt = (elt - (UNIT - 1)) / UNIT;                                \
+      } else {                                                          \
+        elt = elt / UNIT;                                               \
+      }                                                                 \
+    }                                                                   \
+                                                                        \
+    APPLY_EVERY_WIDE(elt, p_kernel);                                    \
+                                                                        \
+    p_out[i] = elt;                                                     \
+  }                                                                     \
+}
+
+// `TO_INT64()` gives seconds, or milliseconds if `SCALE` is `1000`. The UTC
+// offset is looked up for the second that the value falls in.
+#define POSIXCT_LOCAL_KERNEL(NAME, CTYPE, P_X, IS_MISSING, TO_INT64, SCALE, UNIT) \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const CTYPE* p_x = p_kernel->P_X + from;                              \
+                                                                        \
+  const bool needs_offset = p_kernel->needs_offset;                     \
+  const int64_t origin_offset = p_kernel->origin_offset;                \
+                                                                        \
+  struct warp_zone_cursor cursor;                                       \
+  warp_zone_cursor_init(&cursor, &p_kernel->zone);                      \
+                                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const CTYPE x_elt = p_x[i];                                         \
+                                                                        \
+    if (IS_MISSING(x_elt)) {                                            \
+      p_out[i] = NA_REAL;                                               \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    int64_t elt = TO_INT64(x_elt);                                      \
+                                                                        \
+    const int64_t seconds = SCALE == 1 ? elt : floor_div64(elt, SCALE); \
+    elt += (int64_t) warp_zone_cursor_offset(&cursor, seconds) * SCALE; \
+                                                                        \
+    if (needs_offset) {                                                 \
+      elt -= origin_offset;                                             \
+    }                                                                   \
+                                                                        \
+    if (UNIT != 1) {                                                    \
+      if (elt < 0) {                                                    \
+        elt = (elt - (UNIT - 1)) / UNIT;                                \
+      } else {                                                          \
+        elt = elt / UNIT;                                               \
+      }                                                                 \
+    }                                                                   \
+                                                                        \
+    APPLY_EVERY_WIDE(elt, p_kernel);                                    \
+                                                                        \
+    p_out[i] = elt;                                                     \
+  }                                                                     \
+}
 
-  if (needs_offset) {
-    origin_offset = origin_to_days_from_epoch(origin);
-  }
+/*
+ * The POSIXct seconds of element `i` of POSIXlt fields, like `as.POSIXct()`
+ * would compute them: the whole seconds of the local civil time, minus the
+ * UTC offset, plus the fractional seconds. Any missing field results in a
+ * missing value.
+ *
+ * The fields have been checked by `posixlt_is_native_compatible()`, so the
+ * whole seconds are exact in a double.
+ */
+static inline double posixlt_seconds(const struct warp_kernel* p_kernel, R_xlen_t i) {
+  const int year = p_kernel->p_year[i];
+  const int month = p_kernel->p_month[i];
+  const int day = p_kernel->p_day[i];
+  const int hour = p_kernel->p_hour[i];
+  const int minute = p_kernel->p_minute[i];
+  const double second = p_kernel->p_second[i];
+
+  if (year == NA_INTEGER ||
+      month == NA_INTEGER ||
+      day == NA_INTEGER ||
+      hour == NA_INTEGER ||
+      minute == NA_INTEGER ||
+      !R_FINITE(second)) {
+    return NA_REAL;
+  }
+
+  const int gmtoff = p_kernel->p_gmtoff == NULL ? p_kernel->gmtoff : p_kernel->p_gmtoff[i];
+
+  // Months past December count into the following years
+  int year_shift;
+  int month_of_year;
+  floor_divmod(month, 12, &year_shift, &month_of_year);
+
+  const int64_t days =
+    days_from_civil64((int64_t) year + 1900 + year_shift, month_of_year + 1, 1) + day - 1;
+
+  const double whole_second = floor(second);
+
+  const int64_t seconds =
+    days * 86400 +
+    (int64_t) hour * 3600 +
+    (int64_t) minute * 60 +
+    (int64_t) whole_second -
+    gmtoff;
+
+  return (double) seconds + (second - whole_second);
+}
+
+#define POSIXLT_FIXED_KERNEL(NAME, TO_INT64, UNIT)                      \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const bool needs_offset = p_kernel->needs_offset;                     \
+  const int64_t origin_offset = p_kernel->origin_offset;                \
+                                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const double x_elt = posixlt_seconds(p_kernel, from + i);           \
+                                                                        \
+    if (DBL_IS_MISSING(x_elt)) {                                        \
+      p_out[i] = NA_REAL;                                               \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    int64_t elt = TO_INT64(x_elt);                                      \
+                                                                        \
+    if (needs_offset) {                                                 \
+      elt -= origin_offset;                                             \
+    }                                                                   \
+                                                                        \
+    if (UNIT != 1) {                                                    \
+      if (elt < 0) {                                                    \
+        elt = (elt - (UNIT - 1)) / UNIT;                                \
+      } else {                                                          \
+        elt = elt / UNIT;                                               \
+      }                                                                 \
+    }                                                                   \
+                                                                        \
+    APPLY_EVERY_WIDE(elt, p_kernel);                                    \
+                                                                        \
+    p_out[i] = elt;                                                     \
+  }                                                                     \
+}
 
-  for (R_xlen_t i = 0; i < x_size; ++i) {
-    int x_elt = p_x[i];
+/*
+ * `floor((x - offset) * scale / divisor)`, see `struct warp_narrow_info`.
+ * The range scan guarantees that every non-missing value, and every
+ * intermediate result, fits in an `int`. Double input within that range is
+ * only ever missing as `NaN`.
+ */
+#define NARROW_FIXED_KERNEL(NAME, CTYPE, P_X, IS_MISSING, HAS_MISSING, HAS_OFFSET) \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const CTYPE* p_x = p_kernel->P_X + from;                              \
+                                                                        \
+  const int offset = p_kernel->narrow.offset;                           \
+  const int scale = p_kernel->narrow.scale;                             \
+  const struct warp_divider divider = p_kernel->narrow.divider;         \
+                                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const CTYPE x_elt = p_x[i];                                         \
+                                                                        \
+    if (HAS_MISSING && IS_MISSING(x_elt)) {                             \
+      p_out[i] = NA_REAL;                                               \
+      continue;                                                         \
+    }                                                                   \
+                                                                        \
+    int elt = (int) x_elt;                                              \
+                                                                        \
+    if (HAS_OFFSET) {                                                   \
+      elt -= offset;                                                    \
+    }                                                                   \
+                                                                        \
+    elt *= scale;                                                       \
+                                                                        \
+    p_out[i] = divider_div(elt, &divider);                              \
+  }                                                                     \
+}
+
+#define DBL_IS_NAN(x) isnan(x)
+
+NARROW_FIXED_KERNEL(int_narrow_warp_distance_fixed, int, p_int, INT_IS_MISSING, false, false)
+NARROW_FIXED_KERNEL(int_narrow_warp_distance_fixed_offset, int, p_int, INT_IS_MISSING, false, true)
+NARROW_FIXED_KERNEL(int_narrow_warp_distance_fixed_missing, int, p_int, INT_IS_MISSING, true, false)
+NARROW_FIXED_KERNEL(int_narrow_warp_distance_fixed_missing_offset, int, p_int, INT_IS_MISSING, true, true)
+NARROW_FIXED_KERNEL(dbl_narrow_warp_distance_fixed, double, p_dbl, DBL_IS_NAN, false, false)
+NARROW_FIXED_KERNEL(dbl_narrow_warp_distance_fixed_offset, double, p_dbl, DBL_IS_NAN, false, true)
+NARROW_FIXED_KERNEL(dbl_narrow_warp_distance_fixed_missing, double, p_dbl, DBL_IS_NAN, true, false)
+NARROW_FIXED_KERNEL(dbl_narrow_warp_distance_fixed_missing_offset, double, p_dbl, DBL_IS_NAN, true, true)
+
+#undef DBL_IS_NAN
+#undef NARROW_FIXED_KERNEL
+
+// `int64_t` to avoid overflow. Milliseconds have to be scaled before the
+// offset subtraction because the offset is already in milliseconds.
+#define INT_TO_SECONDS(x) ((int64_t) (x))
+#define DBL_TO_SECONDS(x) guarded_floor(x)
+#define INT_TO_MILLISECONDS(x) ((int64_t) (x) * 1000)
+#define DBL_TO_MILLISECONDS(x) guarded_floor_to_millisecond(x)
+
+DATE_FIXED_KERNEL(int_date_warp_distance_hour, int, p_int, INT_IS_MISSING, 24)
+DATE_FIXED_KERNEL(dbl_date_warp_distance_hour, double, p_dbl, DBL_IS_MISSING_WIDE, 24)
+POSIXCT_FIXED_KERNEL(int_posixct_warp_distance_hour, int, p_int, INT_IS_MISSING, INT_TO_SECONDS, 3600)
+POSIXCT_FIXED_KERNEL(dbl_posixct_warp_distance_hour_scalar, double, p_dbl, DBL_IS_MISSING, DBL_TO_SECONDS, 3600)
+POSIXLT_FIXED_KERNEL(posixlt_warp_distance_hour, DBL_TO_SECONDS, 3600)
+POSIXCT_LOCAL_KERNEL(int_posixct_local_warp_distance_hour, int, p_int, INT_IS_MISSING, INT_TO_SECONDS, 1, 3600)
+POSIXCT_LOCAL_KERNEL(dbl_posixct_local_warp_distance_hour, double, p_dbl, DBL_IS_MISSING, DBL_TO_SECONDS, 1, 3600)
+
+DATE_FIXED_KERNEL(int_date_warp_distance_minute, int, p_int, INT_IS_MISSING, 1440)
+DATE_FIXED_KERNEL(dbl_date_warp_distance_minute, double, p_dbl, DBL_IS_MISSING_WIDE, 1440)
+POSIXCT_FIXED_KERNEL(int_posixct_warp_distance_minute, int, p_int, INT_IS_MISSING, INT_TO_SECONDS, 60)
+POSIXCT_FIXED_KERNEL(dbl_posixct_warp_distance_minute_scalar, double, p_dbl, DBL_IS_MISSING, DBL_TO_SECONDS, 60)
+POSIXLT_FIXED_KERNEL(posixlt_warp_distance_minute, DBL_TO_SECONDS, 60)
+POSIXCT_LOCAL_KERNEL(int_posixct_local_warp_distance_minute, int, p_int, INT_IS_MISSING, INT_TO_SECONDS, 1, 60)
+POSIXCT_LOCAL_KERNEL(dbl_posixct_local_warp_distance_minute, double, p_dbl, DBL_IS_MISSING, DBL_TO_SECONDS, 1, 60)
+
+DATE_FIXED_KERNEL(int_date_warp_distance_second, int, p_int, INT_IS_MISSING, 86400)
+DATE_FIXED_KERNEL(dbl_date_warp_distance_second, double, p_dbl, DBL_IS_MISSING_WIDE, 86400)
+POSIXCT_FIXED_KERNEL(int_posixct_warp_distance_second, int, p_int, INT_IS_MISSING, INT_TO_SECONDS, 1)
+POSIXCT_FIXED_KERNEL(dbl_posixct_warp_distance_second_scalar, double, p_dbl, DBL_IS_MISSING, DBL_TO_SECONDS, 1)
+POSIXLT_FIXED_KERNEL(posixlt_warp_distance_second, DBL_TO_SECONDS, 1)
+POSIXCT_LOCAL_KERNEL(int_posixct_local_warp_distance_second, int, p_int, INT_IS_MISSING, INT_TO_SECONDS, 1, 1)
+POSIXCT_LOCAL_KERNEL(dbl_posixct_local_warp_distance_second, double, p_dbl, DBL_IS_MISSING, DBL_TO_SECONDS, 1, 1)
+
+DATE_FIXED_KERNEL(int_date_warp_distance_millisecond, int, p_int, INT_IS_MISSING, 86400000)
+DATE_FIXED_KERNEL(dbl_date_warp_distance_millisecond, double, p_dbl, DBL_IS_MISSING_WIDE, 86400000)
+POSIXCT_FIXED_KERNEL(int_posixct_warp_distance_millisecond, int, p_int, INT_IS_MISSING, INT_TO_MILLISECONDS, 1)
+POSIXCT_FIXED_KERNEL(dbl_posixct_warp_distance_millisecond_scalar, double, p_dbl, DBL_IS_MISSING, DBL_TO_MILLISECONDS, 1)
+POSIXLT_FIXED_KERNEL(posixlt_warp_distance_millisecond, DBL_TO_MILLISECONDS, 1)
+POSIXCT_LOCAL_KERNEL(int_posixct_local_warp_distance_millisecond, int, p_int, INT_IS_MISSING, INT_TO_MILLISECONDS, 1000, 1)
+POSIXCT_LOCAL_KERNEL(dbl_posixct_local_warp_distance_millisecond, double, p_dbl, DBL_IS_MISSING, DBL_TO_MILLISECONDS, 1000, 1)
 
-    if (x_elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
+/*
+ * Double POSIXct input is the common case, so it goes through the vectorized
+ * kernels in `simd.c`. Those fall back to the scalar kernels above when the
+ * input is too far from the epoch for their double arithmetic to be exact.
+ */
 
-    // Avoid overflow
-    int64_t elt = x_elt;
+#define DBL_POSIXCT_FIXED_KERNEL(NAME, SCALAR, SIMD, UNIT)              \
+static void NAME(const struct warp_kernel* p_kernel,                    \
+                 R_xlen_t from,                                         \
+                 R_xlen_t size,                                         \
+                 double* p_out) {                                       \
+  const double origin_offset =                                          \
+    p_kernel->needs_offset ? (double) p_kernel->origin_offset : 0.0;    \
+                                                                        \
+  const double divisor =                                                \
+    (double) UNIT * (p_kernel->needs_every ? p_kernel->every : 1);      \
+                                                                        \
+  if (fabs(origin_offset) < WARP_SIMD_EXACT_LIMIT &&                    \
+      SIMD(p_kernel->p_dbl + from, size, origin_offset, divisor, p_out)) { \
+    return;                                                             \
+  }                                                                     \
+                                                                        \
+  SCALAR(p_kernel, from, size, p_out);                                  \
+}
+
+DBL_POSIXCT_FIXED_KERNEL(dbl_posixct_warp_distance_hour, dbl_posixct_warp_distance_hour_scalar, dbl_posixct_fixed_distance_seconds, 3600)
+DBL_POSIXCT_FIXED_KERNEL(dbl_posixct_warp_distance_minute, dbl_posixct_warp_distance_minute_scalar, dbl_posixct_fixed_distance_seconds, 60)
+DBL_POSIXCT_FIXED_KERNEL(dbl_posixct_warp_distance_second, dbl_posixct_warp_distance_second_scalar, dbl_posixct_fixed_distance_seconds, 1)
+DBL_POSIXCT_FIXED_KERNEL(dbl_posixct_warp_distance_millisecond, dbl_posixct_warp_distance_millisecond_scalar, dbl_posixct_fixed_distance_milliseconds, 1)
+
+#undef DBL_POSIXCT_FIXED_KERNEL
+
+#undef INT_TO_SECONDS
+#undef DBL_TO_SECONDS
+#undef INT_TO_MILLISECONDS
+#undef DBL_TO_MILLISECONDS
+#undef DATE_FIXED_KERNEL
+#undef POSIXCT_FIXED_KERNEL
+#undef POSIXLT_FIXED_KERNEL
+#undef POSIXCT_LOCAL_KERNEL
+
+struct fixed_kernels {
+  warp_kernel_fn int_date;
+  warp_kernel_fn dbl_date;
+  warp_kernel_fn int_posixct;
+  warp_kernel_fn dbl_posixct;
+  warp_kernel_fn posixlt;
+  warp_kernel_fn int_posixct_local;
+  warp_kernel_fn dbl_posixct_local;
+  bool milliseconds;
+  int units_in_day;
+  int unit;
+};
+
+static void kernel_init_narrow(struct warp_kernel* p_kernel,
+                               SEXP x,
+                               int scale,
+                               int64_t divisor);
+
+static SEXP kernel_init_fixed_posixlt(struct warp_kernel* p_kernel,
+                                      SEXP x,
+                                      SEXP origin,
+                                      enum warp_clock_type clock,
+                                      const struct fixed_kernels* p_kernels);
+
+static SEXP kernel_init_fixed_local(struct warp_kernel* p_kernel,
+                                    SEXP x,
+                                    SEXP origin,
+                                    const struct fixed_kernels* p_kernels);
+
+static SEXP kernel_init_fixed(struct warp_kernel* p_kernel,
+                              SEXP x,
+                              int every,
+                              SEXP origin,
+                              enum warp_clock_type clock,
+                              const struct fixed_kernels* p_kernels) {
+  p_kernel->every = every;
+  p_kernel->needs_every = (every != 1);
+  p_kernel->needs_offset = (origin != R_NilValue);
+
+  if (clock == warp_clock_local && time_class_type(x) != warp_class_date) {
+    return kernel_init_fixed_local(p_kernel, x, origin, p_kernels);
+  }
+
+  if (time_class_type(x) == warp_class_posixlt) {
+    SEXP out = kernel_init_fixed_posixlt(p_kernel, x, origin, clock, p_kernels);
+
+    if (out != R_NilValue) {
+      return out;
+    }
+
+    x = as_datetime(x);
+  }
+
+  PROTECT(x);
+
+  p_kernel->size = Rf_xlength(x);
 
-    if (needs_offset) {
-      elt -= origin_offset;
+  switch (time_class_type(x)) {
+  case warp_class_date: {
+    if (p_kernel->needs_offset) {
+      p_kernel->origin_offset = origin_to_days_from_epoch(origin);
     }
 
-    elt *= SECONDS_IN_DAY;
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
+    switch (TYPEOF(x)) {
+    case INTSXP: {
+      p_kernel->p_int = INTEGER_RO(x);
+      p_kernel->fn = p_kernels->int_date;
+      break;
+    }
+    case REALSXP: {
+      p_kernel->p_dbl = REAL_RO(x);
+      p_kernel->fn = p_kernels->dbl_date;
+      break;
+    }
+    default: {
+      r_error("kernel_init_fixed", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
+    }
     }
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
+    if (p_kernel->needs_every) {
+      kernel_init_narrow(p_kernel, x, p_kernels->units_in_day, every);
     }
 
-    p_out[i] = elt;
+    break;
   }
+  case warp_class_posixct: {
+    if (p_kernel->needs_offset) {
+      if (p_kernels->milliseconds) {
+        p_kernel->origin_offset = origin_to_milliseconds_from_epoch(origin);
+      } else {
+        p_kernel->origin_offset = origin_to_seconds_from_epoch(origin);
+      }
+    }
 
-  UNPROTECT(1);
-  return out;
-}
-
-static SEXP dbl_date_warp_distance_second(SEXP x, int every, SEXP origin) {
-  R_xlen_t x_size = Rf_xlength(x);
-
-  double* p_x = REAL(x);
-
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, x_size));
-  double* p_out = REAL(out);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int origin_offset;
-
-  if (needs_offset) {
-    origin_offset = origin_to_days_from_epoch(origin);
-  }
+    switch (TYPEOF(x)) {
+    case INTSXP: {
+      p_kernel->p_int = INTEGER_RO(x);
+      p_kernel->fn = p_kernels->int_posixct;
 
-  for (R_xlen_t i = 0; i < x_size; ++i) {
-    double x_elt = p_x[i];
+      // Milliseconds are scaled before the origin is subtracted
+      if (p_kernel->needs_every && !p_kernels->milliseconds) {
+        kernel_init_narrow(p_kernel, x, 1, p_kernels->unit * (int64_t) every);
+      }
 
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
+      break;
     }
-
-    // Truncate to completely ignore fractional Date parts
-    // `int64_t` to avoid overflow
-    int64_t elt = x_elt;
-
-    if (needs_offset) {
-      elt -= origin_offset;
+    case REALSXP: {
+      p_kernel->p_dbl = REAL_RO(x);
+      p_kernel->fn = p_kernels->dbl_posixct;
+      break;
     }
-
-    elt *= SECONDS_IN_DAY;
-
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
+    default: {
+      r_error("kernel_init_fixed", "Unknown `POSIXct` type %s.", Rf_type2char(TYPEOF(x)));
     }
-
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
     }
 
-    p_out[i] = elt;
+    break;
+  }
+  default: {
+    r_error("kernel_init_fixed", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
+  }
   }
 
+  SEXP out = new_shelter(x, R_NilValue);
+
   UNPROTECT(1);
   return out;
 }
 
-#undef SECONDS_IN_DAY
-
-static SEXP int_posixct_warp_distance_second(SEXP x, int every, SEXP origin) {
-  R_xlen_t x_size = Rf_xlength(x);
-
-  bool needs_every = (every != 1);
+/*
+ * POSIXct is shifted by the UTC offsets of its native time zone data. When
+ * the zone can't be loaded natively, POSIXct goes through POSIXlt instead,
+ * whose fields already hold the wall clock time.
+ */
+static SEXP kernel_init_fixed_local(struct warp_kernel* p_kernel,
+                                    SEXP x,
+                                    SEXP origin,
+                                    const struct fixed_kernels* p_kernels) {
+  if (time_class_type(x) == warp_class_posixlt) {
+    SEXP out = kernel_init_fixed_posixlt(p_kernel, x, origin, warp_clock_local, p_kernels);
 
-  bool needs_offset = (origin != R_NilValue);
-  int64_t origin_offset;
+    if (out != R_NilValue) {
+      return out;
+    }
 
-  if (needs_offset) {
-    origin_offset = origin_to_seconds_from_epoch(origin);
+    // Fields that aren't normalized are normalized by R
+    x = as_datetime(x);
   }
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, x_size));
-  double* p_out = REAL(out);
+  PROTECT(x);
 
-  int* p_x = INTEGER(x);
+  SEXP zone = PROTECT(posixct_load_native_zone(&p_kernel->zone, x));
 
-  for (R_xlen_t i = 0; i < x_size; ++i) {
-    int x_elt = p_x[i];
+  if (zone == R_NilValue) {
+    SEXP x_posixlt = PROTECT(as_posixlt_from_posixct(x));
+    SEXP out = kernel_init_fixed_posixlt(p_kernel, x_posixlt, origin, warp_clock_local, p_kernels);
 
-    if (x_elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
+    if (out == R_NilValue) {
+      r_error(
+        "kernel_init_fixed_local",
+        "`x` is too far from 1970 to compute distances with `clock = \"local\"`."
+      );
     }
 
-    // Avoid overflow
-    int64_t elt = x_elt;
-
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
+    UNPROTECT(3);
+    return out;
+  }
 
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
+  p_kernel->size = Rf_xlength(x);
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
+  if (TYPEOF(x) == INTSXP) {
+    p_kernel->p_int = INTEGER_RO(x);
+    p_kernel->fn = p_kernels->int_posixct_local;
+  } else {
+    p_kernel->p_dbl = REAL_RO(x);
+    p_kernel->fn = p_kernels->dbl_posixct_local;
+    p_kernel->check = warp_kernel_check_local_days;
+  }
 
-    p_out[i] = elt;
+  if (p_kernel->needs_offset) {
+    p_kernel->origin_offset = origin_to_local_from_epoch(origin, &p_kernel->zone, p_kernels->milliseconds);
   }
 
-  UNPROTECT(1);
+  SEXP out = new_shelter(x, zone);
+
+  UNPROTECT(2);
   return out;
 }
 
-static SEXP dbl_posixct_warp_distance_second(SEXP x, int every, SEXP origin) {
-  R_xlen_t x_size = Rf_xlength(x);
-
-  bool needs_every = (every != 1);
-
-  bool needs_offset = (origin != R_NilValue);
-  int64_t origin_offset;
+/*
+ * Switches a fixed width kernel that was just initialized with its `wide`
+ * kernel over to a narrow one, when the range of `x` allows it. The origin
+ * offset and the divisor have to fit in an `int` for that, otherwise the
+ * `wide` kernel is kept regardless of the input.
+ */
+static void kernel_init_narrow(struct warp_kernel* p_kernel,
+                               SEXP x,
+                               int scale,
+                               int64_t divisor) {
+  const int64_t offset = p_kernel->needs_offset ? p_kernel->origin_offset : 0;
 
-  if (needs_offset) {
-    origin_offset = origin_to_seconds_from_epoch(origin);
+  if (divisor > INT_MAX || offset <= INT_MIN || offset > INT_MAX) {
+    return;
   }
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, x_size));
-  double* p_out = REAL(out);
+  struct warp_narrow_info* p_narrow = &p_kernel->narrow;
 
-  double* p_x = REAL(x);
+  p_narrow->wide = p_kernel->fn;
+  p_narrow->offset = (int) offset;
+  p_narrow->scale = scale;
+  p_narrow->divider = new_divider((int) divisor);
 
-  for (R_xlen_t i = 0; i < x_size; ++i) {
-    double x_elt = p_x[i];
+  p_kernel->check = warp_kernel_check_narrow;
 
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
+  const R_xlen_t size = Rf_xlength(x);
 
-    int64_t elt = guarded_floor(x_elt);
+  switch (TYPEOF(x)) {
+  case INTSXP: kernel_select_narrow(p_kernel, INTSXP, int_scan_range(INTEGER_RO(x), size)); break;
+  case REALSXP: kernel_select_narrow(p_kernel, REALSXP, dbl_scan_range(REAL_RO(x), size)); break;
+  default: r_error("kernel_init_narrow", "Internal error: Unknown type %s.", Rf_type2char(TYPEOF(x)));
+  }
+}
+
+static const struct fixed_kernels hour_kernels = {
+  int_date_warp_distance_hour,
+  dbl_date_warp_distance_hour,
+  int_posixct_warp_distance_hour,
+  dbl_posixct_warp_distance_hour,
+  posixlt_warp_distance_hour,
+  int_posixct_local_warp_distance_hour,
+  dbl_posixct_local_warp_distance_hour,
+  false,
+  24,
+  3600
+};
+
+static const struct fixed_kernels minute_kernels = {
+  int_date_warp_distance_minute,
+  dbl_date_warp_distance_minute,
+  int_posixct_warp_distance_minute,
+  dbl_posixct_warp_distance_minute,
+  posixlt_warp_distance_minute,
+  int_posixct_local_warp_distance_minute,
+  dbl_posixct_local_warp_distance_minute,
+  false,
+  1440,
+  60
+};
+
+static const struct fixed_kernels second_kernels = {
+  int_date_warp_distance_second,
+  dbl_date_warp_distance_second,
+  int_posixct_warp_distance_second,
+  dbl_posixct_warp_distance_second,
+  posixlt_warp_distance_second,
+  int_posixct_local_warp_distance_second,
+  dbl_posixct_local_warp_distance_second,
+  false,
+  86400,
+  1
+};
+
+static const struct fixed_kernels millisecond_kernels = {
+  int_date_warp_distance_millisecond,
+  dbl_date_warp_distance_millisecond,
+  int_posixct_warp_distance_millisecond,
+  dbl_posixct_warp_distance_millisecond,
+  posixlt_warp_distance_millisecond,
+  int_posixct_local_warp_distance_millisecond,
+  dbl_posixct_local_warp_distance_millisecond,
+  true,
+  86400000,
+  1
+};
+
+static SEXP posixlt_gmtoff(SEXP x);
+static bool posixlt_is_native_compatible(const struct warp_kernel* p_kernel, R_xlen_t size, bool normalized);
 
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
+/*
+ * Points the kernel at the fields of POSIXlt `x`, to compute the POSIXct
+ * seconds natively rather than through `as.POSIXct()`.
+ *
+ * The UTC offset of each element comes from its `gmtoff` field. Zones with a
+ * fixed offset, like UTC, don't need it. The local time of an element is only
+ * unambiguous if its fields are normalized, so elements with a `gmtoff` must
+ * also be normalized, as they are when they come from `as.POSIXlt()`.
+ *
+ * With `clock = "local"`, the fields are the wall clock time, so the UTC
+ * offset is `0` for every element. They must still be normalized.
+ *
+ * Returns `R_NilValue` if `x` has to be converted through R instead. This is
+ * the case when `gmtoff` is required but missing or `NA`, as it is for the
+ * result of `strptime()`, and when the fields have unexpected types.
+ */
+static SEXP kernel_init_fixed_posixlt(struct warp_kernel* p_kernel,
+                                      SEXP x,
+                                      SEXP origin,
+                                      enum warp_clock_type clock,
+                                      const struct fixed_kernels* p_kernels) {
+  if (Rf_xlength(x) < 6) {
+    return R_NilValue;
+  }
+
+  SEXP second = VECTOR_ELT(x, 0);
+  SEXP minute = VECTOR_ELT(x, 1);
+  SEXP hour = VECTOR_ELT(x, 2);
+  SEXP day = VECTOR_ELT(x, 3);
+  SEXP month = VECTOR_ELT(x, 4);
+  SEXP year = VECTOR_ELT(x, 5);
 
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
+  if (TYPEOF(second) != REALSXP ||
+      TYPEOF(minute) != INTSXP ||
+      TYPEOF(hour) != INTSXP ||
+      TYPEOF(day) != INTSXP ||
+      TYPEOF(month) != INTSXP ||
+      TYPEOF(year) != INTSXP) {
+    return R_NilValue;
+  }
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
+  const R_xlen_t size = Rf_xlength(year);
 
-    p_out[i] = elt;
+  // Fields that are recycled are left to R
+  if (Rf_xlength(second) != size ||
+      Rf_xlength(minute) != size ||
+      Rf_xlength(hour) != size ||
+      Rf_xlength(day) != size ||
+      Rf_xlength(month) != size) {
+    return R_NilValue;
   }
 
-  UNPROTECT(1);
-  return out;
-}
+  struct warp_zone zone;
+  SEXP zone_data = PROTECT(warp_zone_load(&zone, get_time_zone(x)));
 
-// -----------------------------------------------------------------------------
+  const bool local = clock == warp_clock_local;
+  const bool fixed_offset = zone_data != R_NilValue && zone.size == 0 && !zone.has_rule;
+
+  if (local) {
+    p_kernel->p_gmtoff = NULL;
+    p_kernel->gmtoff = 0;
+  } else if (fixed_offset) {
+    p_kernel->p_gmtoff = NULL;
+    p_kernel->gmtoff = zone.initial_offset;
+  } else {
+    SEXP gmtoff = posixlt_gmtoff(x);
 
-static SEXP date_warp_distance_millisecond(SEXP x, int every, SEXP origin);
-static SEXP posixct_warp_distance_millisecond(SEXP x, int every, SEXP origin);
-static SEXP posixlt_warp_distance_millisecond(SEXP x, int every, SEXP origin);
+    if (TYPEOF(gmtoff) != INTSXP || Rf_xlength(gmtoff) != size) {
+      UNPROTECT(1);
+      return R_NilValue;
+    }
 
-static SEXP warp_distance_millisecond(SEXP x, int every, SEXP origin) {
-  switch (time_class_type(x)) {
-  case warp_class_date: return date_warp_distance_millisecond(x, every, origin);
-  case warp_class_posixct: return posixct_warp_distance_millisecond(x, every, origin);
-  case warp_class_posixlt: return posixlt_warp_distance_millisecond(x, every, origin);
-  default: r_error("warp_distance_millisecond", "Unknown object with type, %s.", Rf_type2char(TYPEOF(x)));
+    p_kernel->p_gmtoff = INTEGER_RO(gmtoff);
   }
-}
 
+  p_kernel->p_second = REAL_RO(second);
+  p_kernel->p_minute = INTEGER_RO(minute);
+  p_kernel->p_hour = INTEGER_RO(hour);
+  p_kernel->p_day = INTEGER_RO(day);
+  p_kernel->p_month = INTEGER_RO(month);
+  p_kernel->p_year = INTEGER_RO(year);
 
-static SEXP int_date_warp_distance_millisecond(SEXP x, int every, SEXP origin);
-static SEXP dbl_date_warp_distance_millisecond(SEXP x, int every, SEXP origin);
+  const bool normalized = local || p_kernel->p_gmtoff != NULL;
 
-static SEXP date_warp_distance_millisecond(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_date_warp_distance_millisecond(x, every, origin);
-  case REALSXP: return dbl_date_warp_distance_millisecond(x, every, origin);
-  default: r_error("date_warp_distance_millisecond", "Unknown `Date` type %s.", Rf_type2char(TYPEOF(x)));
+  if (!posixlt_is_native_compatible(p_kernel, size, normalized)) {
+    UNPROTECT(1);
+    return R_NilValue;
   }
-}
-
-
-static SEXP int_posixct_warp_distance_millisecond(SEXP x, int every, SEXP origin);
-static SEXP dbl_posixct_warp_distance_millisecond(SEXP x, int every, SEXP origin);
 
-static SEXP posixct_warp_distance_millisecond(SEXP x, int every, SEXP origin) {
-  switch (TYPEOF(x)) {
-  case INTSXP: return int_posixct_warp_distance_millisecond(x, every, origin);
-  case REALSXP: return dbl_posixct_warp_distance_millisecond(x, every, origin);
-  default: r_error("posixct_warp_distance_millisecond", "Unknown `POSIXct` type %s.", Rf_type2char(TYPEOF(x)));
+  if (p_kernel->needs_offset && local) {
+    const struct warp_zone* p_zone = zone_data == R_NilValue ? NULL : &zone;
+    p_kernel->origin_offset = origin_to_local_from_epoch(origin, p_zone, p_kernels->milliseconds);
+  } else if (p_kernel->needs_offset) {
+    if (p_kernels->milliseconds) {
+      p_kernel->origin_offset = origin_to_milliseconds_from_epoch(origin);
+    } else {
+      p_kernel->origin_offset = origin_to_seconds_from_epoch(origin);
+    }
   }
-}
 
+  p_kernel->size = size;
+  p_kernel->fn = p_kernels->posixlt;
 
-static SEXP posixlt_warp_distance_millisecond(SEXP x, int every, SEXP origin) {
-  x = PROTECT(as_datetime(x));
-  SEXP out = PROTECT(posixct_warp_distance_millisecond(x, every, origin));
+  SEXP out = new_shelter(x, R_NilValue);
 
-  UNPROTECT(2);
+  UNPROTECT(1);
   return out;
 }
 
+static SEXP posixlt_gmtoff(SEXP x) {
+  SEXP names = Rf_getAttrib(x, R_NamesSymbol);
 
-#define MILLISECONDS_IN_DAY 86400000
-
-static SEXP int_date_warp_distance_millisecond(SEXP x, int every, SEXP origin) {
-  R_xlen_t x_size = Rf_xlength(x);
+  if (TYPEOF(names) != STRSXP) {
+    return R_NilValue;
+  }
 
-  int* p_x = INTEGER(x);
+  const R_len_t size = Rf_length(names);
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, x_size));
-  double* p_out = REAL(out);
+  for (R_len_t i = 0; i < size; ++i) {
+    if (str_equal(CHAR(STRING_ELT(names, i)), "gmtoff")) {
+      return VECTOR_ELT(x, i);
+    }
+  }
 
-  bool needs_every = (every != 1);
+  return R_NilValue;
+}
 
-  bool needs_offset = (origin != R_NilValue);
-  int origin_offset;
+#define is_leap_year(year) ((((year) % 4) == 0 && ((year) % 100) != 0) || ((year) % 400) == 0)
 
-  if (needs_offset) {
-    origin_offset = origin_to_days_from_epoch(origin);
-  }
+// Fields are limited to magnitudes that keep the whole seconds of
+// `posixlt_seconds()` below 2^53, where they are exact in a double
+#define POSIXLT_FIELD_LIMIT 100000000
 
-  for (R_xlen_t i = 0; i < x_size; ++i) {
-    int x_elt = p_x[i];
+/*
+ * Every non-missing element must have fields of a limited magnitude, and
+ * elements that use their own `gmtoff` must have a non-missing `gmtoff`.
+ * If `normalized`, the fields must also be normalized.
+ */
+static bool posixlt_is_native_compatible(const struct warp_kernel* p_kernel, R_xlen_t size, bool normalized) {
+  const bool needs_gmtoff = p_kernel->p_gmtoff != NULL;
 
-    if (x_elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
+  for (R_xlen_t i = 0; i < size; ++i) {
+    const int year = p_kernel->p_year[i];
+    const int month = p_kernel->p_month[i];
+    const int day = p_kernel->p_day[i];
+    const int hour = p_kernel->p_hour[i];
+    const int minute = p_kernel->p_minute[i];
+    const double second = p_kernel->p_second[i];
+
+    if (year == NA_INTEGER ||
+        month == NA_INTEGER ||
+        day == NA_INTEGER ||
+        hour == NA_INTEGER ||
+        minute == NA_INTEGER ||
+        !R_FINITE(second)) {
       continue;
     }
 
-    // `int64_t` to avoid overflow
-    int64_t elt = x_elt;
-
-    if (needs_offset) {
-      elt -= origin_offset;
+    if (abs(year) > POSIXLT_FIELD_LIMIT ||
+        abs(month) > POSIXLT_FIELD_LIMIT ||
+        abs(day) > POSIXLT_FIELD_LIMIT ||
+        abs(hour) > POSIXLT_FIELD_LIMIT ||
+        abs(minute) > POSIXLT_FIELD_LIMIT ||
+        fabs(second) > POSIXLT_FIELD_LIMIT) {
+      return false;
     }
 
-    elt *= MILLISECONDS_IN_DAY;
+    if (needs_gmtoff && p_kernel->p_gmtoff[i] == NA_INTEGER) {
+      return false;
+    }
 
-    if (!needs_every) {
-      p_out[i] = elt;
+    if (!normalized) {
       continue;
     }
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
+    if (month < 0 || month > 11) {
+      return false;
     }
 
-    p_out[i] = elt;
+    const int days_in_month =
+      DAYS_IN_MONTH[month] + (month == 1 && is_leap_year(year + 1900));
+
+    if (day < 1 || day > days_in_month ||
+        hour < 0 || hour > 23 ||
+        minute < 0 || minute > 59 ||
+        second < 0 || second >= 61) {
+      return false;
+    }
   }
 
-  UNPROTECT(1);
-  return out;
+  return true;
 }
 
-static SEXP dbl_date_warp_distance_millisecond(SEXP x, int every, SEXP origin) {
-  R_xlen_t x_size = Rf_xlength(x);
+#undef is_leap_year
+#undef POSIXLT_FIELD_LIMIT
 
-  double* p_x = REAL(x);
+static SEXP kernel_init_hour(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin, enum warp_clock_type clock) {
+  return kernel_init_fixed(p_kernel, x, every, origin, clock, &hour_kernels);
+}
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, x_size));
-  double* p_out = REAL(out);
+static SEXP kernel_init_minute(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin, enum warp_clock_type clock) {
+  return kernel_init_fixed(p_kernel, x, every, origin, clock, &minute_kernels);
+}
 
-  bool needs_every = (every != 1);
+static SEXP kernel_init_second(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin, enum warp_clock_type clock) {
+  return kernel_init_fixed(p_kernel, x, every, origin, clock, &second_kernels);
+}
 
-  bool needs_offset = (origin != R_NilValue);
-  int origin_offset;
+static SEXP kernel_init_millisecond(struct warp_kernel* p_kernel, SEXP x, int every, SEXP origin, enum warp_clock_type clock) {
+  return kernel_init_fixed(p_kernel, x, every, origin, clock, &millisecond_kernels);
+}
 
-  if (needs_offset) {
-    origin_offset = origin_to_days_from_epoch(origin);
-  }
+// -----------------------------------------------------------------------------
 
-  for (R_xlen_t i = 0; i < x_size; ++i) {
-    double x_elt = p_x[i];
+/*
+ * The names of the kernels, as reported by `warp_stats()`. Every kernel that
+ * `warp_kernel_init()` can select must be listed here.
+ */
 
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
+struct kernel_name {
+  warp_kernel_fn fn;
+  const char* name;
+};
+
+#define KERNEL_NAME(FN) { FN, #FN }
+
+static const struct kernel_name kernel_names[] = {
+  KERNEL_NAME(int_date_warp_distance_year),
+  KERNEL_NAME(dbl_date_warp_distance_year),
+  KERNEL_NAME(int_date_wide_warp_distance_year),
+  KERNEL_NAME(dbl_date_wide_warp_distance_year),
+  KERNEL_NAME(int_posixct_warp_distance_year),
+  KERNEL_NAME(dbl_posixct_warp_distance_year),
+
+  KERNEL_NAME(int_date_warp_distance_month),
+  KERNEL_NAME(dbl_date_warp_distance_month),
+  KERNEL_NAME(int_date_wide_warp_distance_month),
+  KERNEL_NAME(dbl_date_wide_warp_distance_month),
+  KERNEL_NAME(int_posixct_warp_distance_month),
+  KERNEL_NAME(dbl_posixct_warp_distance_month),
+
+  KERNEL_NAME(int_date_warp_distance_day),
+  KERNEL_NAME(dbl_date_warp_distance_day),
+  KERNEL_NAME(int_date_wide_warp_distance_day),
+  KERNEL_NAME(dbl_date_wide_warp_distance_day),
+  KERNEL_NAME(int_posixct_warp_distance_day),
+  KERNEL_NAME(dbl_posixct_warp_distance_day),
+
+  KERNEL_NAME(int_offset_warp_distance),
+
+  KERNEL_NAME(posixlt_warp_distance_yday),
+  KERNEL_NAME(int_date_warp_distance_yday),
+  KERNEL_NAME(dbl_date_warp_distance_yday),
+  KERNEL_NAME(dbl_date_wide_warp_distance_yday),
+  KERNEL_NAME(int_posixct_warp_distance_yday),
+  KERNEL_NAME(dbl_posixct_warp_distance_yday),
+
+  KERNEL_NAME(posixlt_warp_distance_mday),
+  KERNEL_NAME(int_date_warp_distance_mday),
+  KERNEL_NAME(dbl_date_warp_distance_mday),
+  KERNEL_NAME(dbl_date_wide_warp_distance_mday),
+  KERNEL_NAME(int_posixct_warp_distance_mday),
+  KERNEL_NAME(dbl_posixct_warp_distance_mday),
+
+  KERNEL_NAME(int_date_warp_distance_hour),
+  KERNEL_NAME(dbl_date_warp_distance_hour),
+  KERNEL_NAME(int_posixct_warp_distance_hour),
+  KERNEL_NAME(dbl_posixct_warp_distance_hour),
+  KERNEL_NAME(posixlt_warp_distance_hour),
+  KERNEL_NAME(int_posixct_local_warp_distance_hour),
+  KERNEL_NAME(dbl_posixct_local_warp_distance_hour),
+
+  KERNEL_NAME(int_date_warp_distance_minute),
+  KERNEL_NAME(dbl_date_warp_distance_minute),
+  KERNEL_NAME(int_posixct_warp_distance_minute),
+  KERNEL_NAME(dbl_posixct_warp_distance_minute),
+  KERNEL_NAME(posixlt_warp_distance_minute),
+  KERNEL_NAME(int_posixct_local_warp_distance_minute),
+  KERNEL_NAME(dbl_posixct_local_warp_distance_minute),
+
+  KERNEL_NAME(int_date_warp_distance_second),
+  KERNEL_NAME(dbl_date_warp_distance_second),
+  KERNEL_NAME(int_posixct_warp_distance_second),
+  KERNEL_NAME(dbl_posixct_warp_distance_second),
+  KERNEL_NAME(posixlt_warp_distance_second),
+  KERNEL_NAME(int_posixct_local_warp_distance_second),
+  KERNEL_NAME(dbl_posixct_local_warp_distance_second),
+
+  KERNEL_NAME(int_date_warp_distance_millisecond),
+  KERNEL_NAME(dbl_date_warp_distance_millisecond),
+  KERNEL_NAME(int_posixct_warp_distance_millisecond),
+  KERNEL_NAME(dbl_posixct_warp_distance_millisecond),
+  KERNEL_NAME(posixlt_warp_distance_millisecond),
+  KERNEL_NAME(int_posixct_local_warp_distance_millisecond),
+  KERNEL_NAME(dbl_posixct_local_warp_distance_millisecond),
+
+  KERNEL_NAME(int_narrow_warp_distance_fixed),
+  KERNEL_NAME(int_narrow_warp_distance_fixed_offset),
+  KERNEL_NAME(int_narrow_warp_distance_fixed_missing),
+  KERNEL_NAME(int_narrow_warp_distance_fixed_missing_offset),
+  KERNEL_NAME(dbl_narrow_warp_distance_fixed),
+  KERNEL_NAME(dbl_narrow_warp_distance_fixed_offset),
+  KERNEL_NAME(dbl_narrow_warp_distance_fixed_missing),
+  KERNEL_NAME(dbl_narrow_warp_distance_fixed_missing_offset),
+};
+
+#undef KERNEL_NAME
+
+// [[ include("kernel.h") ]]
+const char* warp_kernel_name(warp_kernel_fn fn) {
+  const size_t size = sizeof(kernel_names) / sizeof(kernel_names[0]);
+
+  for (size_t i = 0; i < size; ++i) {
+    if (kernel_names[i].fn == fn) {
+      return kernel_names[i].name;
+    }
+  }
+
+  return "unknown";
+}
+
+#undef INT_IS_MISSING
+#undef DBL_IS_MISSING
+#undef DBL_IS_MISSING_WIDE
+#undef NA_FALLBACK
+#undef INT_DATE_TO_DAYS
+#undef DBL_DATE_TO_DAYS
+#undef INT_DATE_TO_DAYS_WIDE
+#undef DBL_DATE_TO_DAYS_WIDE
+#undef INT_POSIXCT_TO_DAYS
+#undef DBL_POSIXCT_TO_DAYS
+#undef APPLY_EVERY
+#undef APPLY_EVERY_WIDE
 
-    // Truncate to completely ignore fractional Date parts
-    // `int64_t` to avoid overflow
-    int64_t elt = x_elt;
+// -----------------------------------------------------------------------------
 
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
+// The shelter keeps the prepared input, and any time zone data, alive for
+// as long as the kernel is in use
+static SEXP new_shelter(SEXP x, SEXP zone) {
+  SEXP out = PROTECT(Rf_allocVector(VECSXP, 2));
 
-    elt *= MILLISECONDS_IN_DAY;
+  SET_VECTOR_ELT(out, 0, x);
+  SET_VECTOR_ELT(out, 1, zone);
 
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
+  UNPROTECT(1);
+  return out;
+}
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
+/*
+ * The range scans that pick between the `int` Date kernels and the `wide`
+ * ones. The `int` kernels need every day, truncated towards 0, to fit in an
+ * `int`, and to still fit once the origin offset is subtracted. The origin
+ * offset isn't always in days, but for the year and month kernels it is
+ * small enough that treating it as days only sends values within a few
+ * million days of the `int` limits to the `wide` kernels.
+ */
+static bool days_fit_int(const struct warp_kernel* p_kernel, struct warp_range range) {
+  // No non-missing values
+  if (range.smallest > range.largest) {
+    return true;
+  }
+
+  const double shift = p_kernel->needs_offset ? (double) p_kernel->origin_offset : 0;
+
+  return range.smallest > INT_MIN &&
+    range.largest <= INT_MAX &&
+    range.smallest - shift > INT_MIN &&
+    range.largest - shift <= INT_MAX;
+}
 
-    p_out[i] = elt;
+static bool int_is_days_compatible(const struct warp_kernel* p_kernel, const int* p_x, R_xlen_t size) {
+  // Every `int` fits, so only the origin offset can overflow
+  if (!p_kernel->needs_offset || p_kernel->origin_offset == 0) {
+    return true;
   }
 
-  UNPROTECT(1);
-  return out;
+  return days_fit_int(p_kernel, int_scan_range(p_x, size));
 }
 
-#undef MILLISECONDS_IN_DAY
+// Infinite values pick the `wide` kernels, which treat them as missing too
+static bool dbl_is_days_compatible(const struct warp_kernel* p_kernel, const double* p_x, R_xlen_t size) {
+  return days_fit_int(p_kernel, dbl_scan_range(p_x, size));
+}
 
-#define MILLISECONDS_IN_SECOND 1000
+/*
+ * The range scans are a single pass without branches, so they cost a small
+ * fraction of any kernel. The missing values are tracked alongside the range
+ * for the narrow kernels, which have variants that never check for them.
+ */
+static struct warp_range int_scan_range(const int* p_x, R_xlen_t size) {
+  int smallest = INT_MAX;
+  int largest = INT_MIN;
+  bool has_missing = false;
 
-static SEXP int_posixct_warp_distance_millisecond(SEXP x, int every, SEXP origin) {
-  R_xlen_t x_size = Rf_xlength(x);
+  for (R_xlen_t i = 0; i < size; ++i) {
+    const int elt = p_x[i];
+    const bool missing = (elt == NA_INTEGER);
 
-  bool needs_every = (every != 1);
+    has_missing |= missing;
 
-  bool needs_offset = (origin != R_NilValue);
-  int64_t origin_offset;
+    // `NA_INTEGER` is `INT_MIN`, which never raises `largest`, but has to be
+    // kept out of `smallest`
+    const int elt_smallest = missing ? INT_MAX : elt;
 
-  if (needs_offset) {
-    origin_offset = origin_to_milliseconds_from_epoch(origin);
+    smallest = elt_smallest < smallest ? elt_smallest : smallest;
+    largest = elt > largest ? elt : largest;
   }
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, x_size));
-  double* p_out = REAL(out);
+  struct warp_range out = { smallest, largest, has_missing };
+  return out;
+}
 
-  int* p_x = INTEGER(x);
+static struct warp_range dbl_scan_range(const double* p_x, R_xlen_t size) {
+  // Two independent lanes, so that each comparison doesn't have to wait on
+  // the result of the previous one
+  double smallest0 = R_PosInf;
+  double smallest1 = R_PosInf;
+  double largest0 = R_NegInf;
+  double largest1 = R_NegInf;
+  int has_missing = 0;
 
-  for (R_xlen_t i = 0; i < x_size; ++i) {
-    int x_elt = p_x[i];
+  R_xlen_t i = 0;
 
-    if (x_elt == NA_INTEGER) {
-      p_out[i] = NA_REAL;
-      continue;
-    }
+  // `NaN` fails every comparison, so it is skipped by the range, and is the
+  // only value that isn't equal to itself
+  for (; i + 1 < size; i += 2) {
+    const double elt0 = p_x[i];
+    const double elt1 = p_x[i + 1];
 
-    // `int64_t` to avoid overflow
-    // Note - Have to do `* MILLISECONDS_IN_SECOND` before the
-    // offset subtraction because the offset is already in milliseconds
-    int64_t elt = x_elt * MILLISECONDS_IN_SECOND;
+    smallest0 = elt0 < smallest0 ? elt0 : smallest0;
+    smallest1 = elt1 < smallest1 ? elt1 : smallest1;
+    largest0 = elt0 > largest0 ? elt0 : largest0;
+    largest1 = elt1 > largest1 ? elt1 : largest1;
 
-    if (needs_offset) {
-      elt -= origin_offset;
-    }
+    has_missing |= (elt0 != elt0) | (elt1 != elt1);
+  }
 
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
+  if (i < size) {
+    const double elt = p_x[i];
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
+    smallest0 = elt < smallest0 ? elt : smallest0;
+    largest0 = elt > largest0 ? elt : largest0;
 
-    p_out[i] = elt;
+    has_missing |= (elt != elt);
   }
 
-  UNPROTECT(1);
+  const double smallest = smallest0 < smallest1 ? smallest0 : smallest1;
+  const double largest = largest0 > largest1 ? largest0 : largest1;
+
+  struct warp_range out = { trunc(smallest), trunc(largest), has_missing };
   return out;
 }
 
-static SEXP dbl_posixct_warp_distance_millisecond(SEXP x, int every, SEXP origin) {
-  R_xlen_t x_size = Rf_xlength(x);
+/*
+ * Points `p_kernel` at the narrow kernel for input of `type` with `range`,
+ * or at the `wide` kernel if any value, or any intermediate result of the
+ * narrow arithmetic, doesn't fit in an `int`. `scale` is positive, so the
+ * range of the result only depends on the ends of the range of the input.
+ */
+static void kernel_select_narrow(struct warp_kernel* p_kernel, SEXPTYPE type, struct warp_range range) {
+  const struct warp_narrow_info* p_narrow = &p_kernel->narrow;
 
-  bool needs_every = (every != 1);
+  const double offset = p_narrow->offset;
+  const double scale = p_narrow->scale;
 
-  bool needs_offset = (origin != R_NilValue);
-  int64_t origin_offset;
+  const bool fits = range.smallest > range.largest || (
+    range.smallest > INT_MIN &&
+    range.largest <= INT_MAX &&
+    (range.smallest - offset) * scale > INT_MIN &&
+    (range.largest - offset) * scale <= INT_MAX
+  );
 
-  if (needs_offset) {
-    origin_offset = origin_to_milliseconds_from_epoch(origin);
+  if (!fits) {
+    p_kernel->fn = p_narrow->wide;
+    return;
   }
 
-  SEXP out = PROTECT(Rf_allocVector(REALSXP, x_size));
-  double* p_out = REAL(out);
+  const bool has_offset = (p_narrow->offset != 0);
 
-  double* p_x = REAL(x);
+  if (type == INTSXP) {
+    if (range.has_missing) {
+      p_kernel->fn = has_offset ? int_narrow_warp_distance_fixed_missing_offset : int_narrow_warp_distance_fixed_missing;
+    } else {
+      p_kernel->fn = has_offset ? int_narrow_warp_distance_fixed_offset : int_narrow_warp_distance_fixed;
+    }
+  } else {
+    if (range.has_missing) {
+      p_kernel->fn = has_offset ? dbl_narrow_warp_distance_fixed_missing_offset : dbl_narrow_warp_distance_fixed_missing;
+    } else {
+      p_kernel->fn = has_offset ? dbl_narrow_warp_distance_fixed_offset : dbl_narrow_warp_distance_fixed;
+    }
+  }
+}
 
-  for (R_xlen_t i = 0; i < x_size; ++i) {
-    double x_elt = p_x[i];
+// Can every finite value be converted to local days natively?
+static bool dbl_is_local_days_compatible(const double* p_x, R_xlen_t size) {
+  for (R_xlen_t i = 0; i < size; ++i) {
+    const double elt = p_x[i];
 
-    if (!R_FINITE(x_elt)) {
-      p_out[i] = NA_REAL;
+    if (!R_FINITE(elt)) {
       continue;
     }
 
-    int64_t elt = guarded_floor_to_millisecond(x_elt);
-
-    if (needs_offset) {
-      elt -= origin_offset;
+    if (elt < WARP_ZONE_SMALLEST_SECONDS || elt > WARP_ZONE_LARGEST_SECONDS) {
+      return false;
     }
+  }
 
-    if (!needs_every) {
-      p_out[i] = elt;
-      continue;
-    }
+  return true;
+}
 
-    if (elt < 0) {
-      elt = (elt - (every - 1)) / every;
-    } else {
-      elt = elt / every;
-    }
+/*
+ * Loads the time zone of POSIXct `x` into `p_zone` if the local days of `x`
+ * can be computed natively. Returns the zone data, which must be protected
+ * for as long as `p_zone` is used, or `R_NilValue` if `x` has to go through
+ * POSIXlt instead.
+ */
+static SEXP posixct_load_native_zone(struct warp_zone* p_zone, SEXP x) {
+  const SEXPTYPE type = TYPEOF(x);
 
-    p_out[i] = elt;
+  if (type != INTSXP && type != REALSXP) {
+    return R_NilValue;
   }
 
-  UNPROTECT(1);
-  return out;
-}
+  if (type == REALSXP && !dbl_is_local_days_compatible(REAL_RO(x), Rf_xlength(x))) {
+    return R_NilValue;
+  }
 
-#undef MILLISECONDS_IN_SECOND
+  return warp_zone_load(p_zone, get_time_zone(x));
+}
 
-// -----------------------------------------------------------------------------
+// [[ include("kernel.h") ]]
+bool warp_posixct_has_native_days(SEXP x) {
+  struct warp_zone zone;
+  return posixct_load_native_zone(&zone, x) != R_NilValue;
+}
 
 static void validate_every(int every) {
   if (every == NA_INTEGER) {
@@ -2068,9 +2817,8 @@ static void validate_origin(SEXP origin) {
   }
 }
 
-// `as_date()` will always return a double with no fractional component,
-// and the double will always fit inside an int
-static int origin_to_days_from_epoch(SEXP origin) {
+// `as_date()` will always return a double with no fractional component
+static int64_t origin_to_days_from_epoch(SEXP origin) {
   origin = PROTECT(as_date(origin));
 
   double out = REAL(origin)[0];
@@ -2079,8 +2827,12 @@ static int origin_to_days_from_epoch(SEXP origin) {
     r_error("origin_to_days_from_epoch", "`origin` must not be `NA`.");
   }
 
+  if (fabs(out) >= WARP_WIDE_DAYS_LIMIT) {
+    r_error("origin_to_days_from_epoch", "`origin` is too far from 1970.");
+  }
+
   UNPROTECT(1);
-  return (int) out;
+  return (int64_t) out;
 }
 
 static int64_t origin_to_seconds_from_epoch(SEXP origin) {
@@ -2114,85 +2866,53 @@ static int64_t origin_to_milliseconds_from_epoch(SEXP origin) {
 }
 
 /*
- * `double` values are represented with 64 bits:
- * - 1 sign bit
- * - 11 exponent bits
- * - 52 significand bits
- *
- * The 52 significand bits are the ones that store the true value, this
- * corresponds to about ~16 significand digits, with everything after
- * that being garbage.
- *
- * Internally doubles are represented with scientific notation to put them in
- * the exponent-significand representation. So the following date, which
- * is represented as a double, really looks like this in scientific notation:
- *
- * unclass(as.POSIXct("2011-05-01 17:55:23.123456"))
- * =
- * 1304286923.1234560013
- * =
- * 1.3042869231234560013e+09
- *                 ^ 16th digit
- *
- * Because only ~16 digits are stable, this is where we draw the line on
- * assuming that the user might have some valuable information stored here.
- * This corresponds to microseconds. Sure, we could use
- * a date that has less digits before the decimal to get more fractional
- * precision (see below) but most dates are in this form: 10 digits before
- * the decimal representing whole seconds, meaning 6 stable digits after it.
- *
- * The other part of the story is that not all floating point numbers can be
- * represented exactly in binary. For example:
- *
- * unclass(as.POSIXct("1969-12-31 23:59:59.998", "UTC"))
- * =
- * -0.002000000000002444267
- *
- * Because of this, `floor()` will give results that (to us) are incorrect if
- * we were to try and floor to milliseconds. We would first times by 1000 to
- * get milliseconds of `-2.000000000002444267`, and then `floor()` would give
- * us -3, not -2 which is the correct group.
- *
- * To get around this, we need to guard against this floating point error. The
- * best way I can come up with is to add a small value before flooring, which
- * would push us into the -1.9999999 range, which would floor correctly.
- *
- * I chose the value of just beyond 1 microsecond because that is generally
- * where the 17th digit falls for most dates
- * (10 digits of whole seconds, 5 of stable fractional seconds). This seems to
- * work well for the millisecond grouping, and we apply it to anywhere that
- * uses seconds "just in case", but it is hard to come up with tests for them.
+ * The wall clock time of `origin` in its own time zone, as seconds or
+ * milliseconds since 1970-01-01 00:00:00 of that time zone. `p_zone` is the
+ * time zone of `origin`, or `NULL` if it can't be resolved natively, in which
+ * case the wall clock time comes from `as.POSIXlt()`.
  */
+static int64_t origin_to_local_from_epoch(SEXP origin, const struct warp_zone* p_zone, bool milliseconds) {
+  const int64_t out = milliseconds ?
+    origin_to_milliseconds_from_epoch(origin) :
+    origin_to_seconds_from_epoch(origin);
+
+  // Dates have no time of day, so they are the same on both clocks
+  if (time_class_type(origin) == warp_class_date) {
+    return out;
+  }
 
-static inline int64_t guarded_floor(double x) {
-  // Scale and trim past microseconds
-  x *= 1e6;
-  x = trunc(x);
-  x *= 1e-6;
+  if (p_zone != NULL) {
+    const int64_t seconds = milliseconds ? floor_div64(out, 1000) : out;
+    const int64_t offset = warp_zone_offset(p_zone, seconds);
+    return out + (milliseconds ? offset * 1000 : offset);
+  }
 
-  // Add guard and floor
-  x += 1e-7;
-  x = floor(x);
+  SEXP origin_posixct = PROTECT(as_datetime(origin));
+  SEXP origin_posixlt = PROTECT(as_posixlt_from_posixct(origin_posixct));
 
-  return (int64_t) x;
-}
+  if (Rf_xlength(origin_posixlt) < 6 ||
+      TYPEOF(VECTOR_ELT(origin_posixlt, 0)) != REALSXP ||
+      TYPEOF(VECTOR_ELT(origin_posixlt, 1)) != INTSXP ||
+      TYPEOF(VECTOR_ELT(origin_posixlt, 2)) != INTSXP ||
+      TYPEOF(VECTOR_ELT(origin_posixlt, 3)) != INTSXP ||
+      TYPEOF(VECTOR_ELT(origin_posixlt, 4)) != INTSXP ||
+      TYPEOF(VECTOR_ELT(origin_posixlt, 5)) != INTSXP) {
+    r_error("origin_to_local_from_epoch", "Internal error: `as.POSIXlt()` returned unexpected fields.");
+  }
 
-// The order here is slightly different. We want to convert
-// seconds to milliseconds while still guarding correctly.
-// - Scale and trim past microseconds
-// - Guard while still at the second level to put it on the right decimal
-// - Now scale to millisecond and floor
+  // A single element kernel over the fields, with no UTC offset
+  struct warp_kernel kernel;
+  memset(&kernel, 0, sizeof(struct warp_kernel));
 
-static inline int64_t guarded_floor_to_millisecond(double x) {
-  // Scale and trim past microseconds
-  x *= 1e6;
-  x = trunc(x);
-  x *= 1e-6;
+  kernel.p_second = REAL_RO(VECTOR_ELT(origin_posixlt, 0));
+  kernel.p_minute = INTEGER_RO(VECTOR_ELT(origin_posixlt, 1));
+  kernel.p_hour = INTEGER_RO(VECTOR_ELT(origin_posixlt, 2));
+  kernel.p_day = INTEGER_RO(VECTOR_ELT(origin_posixlt, 3));
+  kernel.p_month = INTEGER_RO(VECTOR_ELT(origin_posixlt, 4));
+  kernel.p_year = INTEGER_RO(VECTOR_ELT(origin_posixlt, 5));
 
-  // Add guard, scale to milliseconds, and floor
-  x += 1e-7;
-  x *= 1e3;
-  x = floor(x);
+  const double local = posixlt_seconds(&kernel, 0);
 
-  return (int64_t) x;
+  UNPROTECT(2);
+  return milliseconds ? guarded_floor_to_millisecond(local) : guarded_floor(local);
 }
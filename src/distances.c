@@ -0,0 +1,189 @@
+#include "warp.h"
+#include "utils.h"
+#include "kernel.h"
+#include <limits.h> // For INT_MIN and INT_MAX
+
+// -----------------------------------------------------------------------------
+
+static SEXP warp_distances_impl(const struct warp_kernel* kernels,
+                                R_len_t n_periods,
+                                SEXP names,
+                                int threads);
+
+/*
+ * `warp_distances()` computes the distances for several periods of the same
+ * `x`. Every kernel is prepared up front, and then `x` is processed one block
+ * at a time, running all of the kernels over a block before moving on to the
+ * next, so each block of `x` is read from memory once and reused from cache.
+ *
+ * The `"yday"` and `"mday"` based periods need POSIXct input as POSIXlt when
+ * its local days can't be computed natively. That conversion goes through R,
+ * so it is done once and shared by all of them.
+ */
+
+static inline bool period_needs_posixlt(enum warp_period_type type);
+static int pull_every_elt(SEXP every, R_len_t i);
+
+// [[ include("warp.h") ]]
+SEXP warp_distances(SEXP x,
+                    SEXP periods,
+                    SEXP every,
+                    SEXP origin,
+                    int threads) {
+  if (TYPEOF(periods) != STRSXP) {
+    r_error("warp_distances", "`periods` must be a character vector.");
+  }
+
+  const R_len_t n_periods = Rf_length(periods);
+  const R_len_t n_every = Rf_length(every);
+
+  if (n_periods == 0) {
+    r_error("warp_distances", "`periods` must have at least one element.");
+  }
+
+  if (n_every != 1 && n_every != n_periods) {
+    r_error(
+      "warp_distances",
+      "`every` must have size 1 or the same size as `periods` (%i), not %i.",
+      n_periods,
+      n_every
+    );
+  }
+
+  int n_prot = 0;
+
+  struct warp_kernel* kernels = (struct warp_kernel*) R_alloc(n_periods, sizeof(struct warp_kernel));
+
+  // Holds the shelters owning the memory of each kernel
+  SEXP shelters = PROTECT_N(Rf_allocVector(VECSXP, n_periods), &n_prot);
+
+  // Shared POSIXlt version of POSIXct `x`, created on first use
+  SEXP x_posixlt = R_NilValue;
+  PROTECT_INDEX x_posixlt_pi;
+  PROTECT_WITH_INDEX(x_posixlt, &x_posixlt_pi);
+  ++n_prot;
+
+  const bool needs_posixlt =
+    time_class_type(x) == warp_class_posixct &&
+    !warp_posixct_has_native_days(x);
+
+  for (R_len_t i = 0; i < n_periods; ++i) {
+    SEXP period = PROTECT(Rf_ScalarString(STRING_ELT(periods, i)));
+    enum warp_period_type type = as_period_type(period);
+    UNPROTECT(1);
+
+    const int every_ = pull_every_elt(every, n_every == 1 ? 0 : i);
+
+    SEXP x_elt = x;
+
+    if (needs_posixlt && period_needs_posixlt(type)) {
+      if (x_posixlt == R_NilValue) {
+        x_posixlt = as_posixlt_from_posixct(x);
+        REPROTECT(x_posixlt, x_posixlt_pi);
+      }
+
+      x_elt = x_posixlt;
+    }
+
+    SET_VECTOR_ELT(shelters, i, warp_kernel_init(&kernels[i], x_elt, type, every_, origin, warp_clock_elapsed));
+  }
+
+  SEXP out = warp_distances_impl(kernels, n_periods, periods, threads);
+
+  UNPROTECT(n_prot);
+  return out;
+}
+
+// [[ register() ]]
+SEXP warp_warp_distances(SEXP x,
+                         SEXP periods,
+                         SEXP every,
+                         SEXP origin,
+                         SEXP threads) {
+  int threads_ = pull_threads(threads);
+  return warp_distances(x, periods, every, origin, threads_);
+}
+
+static inline bool period_needs_posixlt(enum warp_period_type type) {
+  switch (type) {
+  case warp_period_yweek:
+  case warp_period_mweek:
+  case warp_period_yday:
+  case warp_period_mday: return true;
+  default: return false;
+  }
+}
+
+// Values are validated by `warp_kernel_init()`
+static int pull_every_elt(SEXP every, R_len_t i) {
+  if (OBJECT(every) != 0) {
+    r_error("pull_every_elt", "`every` must be a bare integer-ish vector.");
+  }
+
+  switch (TYPEOF(every)) {
+  case INTSXP: return INTEGER(every)[i];
+  case REALSXP: {
+    const double elt = REAL(every)[i];
+    return (ISNAN(elt) || elt > INT_MAX || elt <= INT_MIN) ? NA_INTEGER : (int) elt;
+  }
+  default: r_error("pull_every_elt", "`every` must be integer-ish, not %s", Rf_type2char(TYPEOF(every)));
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+// The number of elements of `x` processed by every kernel before moving on to
+// the next block, per thread
+#define WARP_DISTANCES_BLOCK_SIZE 4096
+
+static SEXP new_distances_df(SEXP names, R_xlen_t size);
+
+static SEXP warp_distances_impl(const struct warp_kernel* kernels,
+                                R_len_t n_periods,
+                                SEXP names,
+                                int threads) {
+  const R_xlen_t size = kernels[0].size;
+
+  SEXP out = PROTECT(new_distances_df(names, size));
+
+  double** p_cols = (double**) R_alloc(n_periods, sizeof(double*));
+
+  for (R_len_t i = 0; i < n_periods; ++i) {
+    SEXP col = Rf_allocVector(REALSXP, size);
+    SET_VECTOR_ELT(out, i, col);
+    p_cols[i] = REAL(col);
+  }
+
+  const R_xlen_t block_size = WARP_DISTANCES_BLOCK_SIZE * (R_xlen_t) (threads > 1 ? threads : 1);
+
+  for (R_xlen_t from = 0; from < size; from += block_size) {
+    const R_xlen_t remaining = size - from;
+    const R_xlen_t n = remaining < block_size ? remaining : block_size;
+
+    for (R_len_t i = 0; i < n_periods; ++i) {
+      warp_kernel_run(&kernels[i], from, n, p_cols[i] + from, threads);
+    }
+  }
+
+  UNPROTECT(1);
+  return out;
+}
+
+#undef WARP_DISTANCES_BLOCK_SIZE
+
+static SEXP new_distances_df(SEXP names, R_xlen_t size) {
+  const R_len_t n_cols = Rf_length(names);
+
+  SEXP out = PROTECT(Rf_allocVector(VECSXP, n_cols));
+
+  SEXP row_names = PROTECT(Rf_allocVector(INTSXP, 2));
+  INTEGER(row_names)[0] = NA_INTEGER;
+  INTEGER(row_names)[1] = (int) -size;
+
+  Rf_setAttrib(out, R_NamesSymbol, names);
+  Rf_setAttrib(out, R_ClassSymbol, classes_data_frame);
+  Rf_setAttrib(out, R_RowNamesSymbol, row_names);
+
+  UNPROTECT(2);
+  return out;
+}
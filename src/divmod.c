@@ -157,16 +157,7 @@ void divmod(int x, int y, int* p_quot, int* p_rem) {
     Rf_errorcall(R_NilValue, "Division by zero is not allowed.");
   }
 
-  int quot = x / y;
-  int rem = (int)(x - (unsigned int)quot * y);
-
-  if (rem && ((y ^ rem) < 0)) {
-    rem += y;
-    --quot;
-  }
-
-  *p_quot = quot;
-  *p_rem = rem;
+  floor_divmod(x, y, p_quot, p_rem);
 }
 
 int int_div(int x, int y) {
@@ -180,6 +171,36 @@ int int_div(int x, int y) {
 
 // -----------------------------------------------------------------------------
 
+/*
+ * `new_divider()`
+ *
+ * Floor division by a positive `d` is reduced to unsigned division of an
+ * `n` in `[0, 2^31)` (see `divider_div()`). That is computed as:
+ *
+ * floor(n * m / 2^(31 + L))
+ *
+ * with `L = ceil(log2(d))` and `m = ceil(2^(31 + L) / d)`. Writing
+ * `m * d = 2^(31 + L) + e` with `0 <= e < d <= 2^L`, this is:
+ *
+ * floor(n / d + n * e / (d * 2^(31 + L)))
+ *
+ * Since `n * e < 2^31 * 2^L`, the error term is smaller than `1 / d`. The
+ * fractional part of `n / d` is at most `(d - 1) / d`, so the error can never
+ * carry the result over to the next whole number, and the quotient is exact.
+ * `m <= 2^32 + 1`, so `n * m` fits in 64 bits.
+ */
+
+// [[ include("divmod.h") ]]
+struct warp_divider new_divider(int divisor) {
+  if (divisor <= 0) {
+    Rf_errorcall(R_NilValue, "Internal error: Fast dividers require a positive divisor.");
+  }
+
+  return make_divider(divisor);
+}
+
+// -----------------------------------------------------------------------------
+
 // Exposed for testing
 // [[ register() ]]
 SEXP warp_divmod(SEXP x, SEXP y) {
@@ -200,6 +221,28 @@ SEXP warp_divmod(SEXP x, SEXP y) {
   return out;
 }
 
+// Exposed for testing
+// [[ register() ]]
+SEXP warp_divider_divmod(SEXP x, SEXP y) {
+  int x_ = INTEGER(x)[0];
+  int y_ = INTEGER(y)[0];
+
+  struct warp_divider divider = new_divider(y_);
+
+  int quot;
+  int rem;
+
+  divider_divmod(x_, &divider, &quot, &rem);
+
+  SEXP out = PROTECT(Rf_allocVector(INTSXP, 2));
+
+  INTEGER(out)[0] = quot;
+  INTEGER(out)[1] = rem;
+
+  UNPROTECT(1);
+  return out;
+}
+
 // Exposed for testing
 // [[ register() ]]
 SEXP warp_div(SEXP x, SEXP y) {
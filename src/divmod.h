@@ -5,8 +5,12 @@
 #include <R.h>
 #include <Rinternals.h>
 #include <float.h>
+#include <stdint.h>
+#include "arith.h"
 
 void divmod(int x, int y, int* p_quot, int* p_rem);
 int int_div(int x, int y);
 
+struct warp_divider new_divider(int divisor);
+
 #endif
@@ -1,6 +1,9 @@
 #include "warp.h"
 #include "utils.h"
 #include "divmod.h"
+#include "zone.h"
+#include "cache.h"
+#include <string.h> // For memcpy()
 
 /*
  * `get_year_offset()`
@@ -31,9 +34,33 @@ SEXP get_year_offset(SEXP x) {
   }
 }
 
+static SEXP posixct_get_local_days(SEXP x);
+
 static SEXP posixct_get_year_offset(SEXP x) {
-  x = PROTECT(as_posixlt_from_posixct(x));
-  SEXP out = posixlt_get_year_offset(x);
+  SEXP out = PROTECT(posixct_get_local_days(x));
+
+  // Fall back to R when the time zone can't be resolved natively
+  if (out == R_NilValue) {
+    x = PROTECT(as_posixlt_from_posixct(x));
+    out = posixlt_get_year_offset(x);
+    UNPROTECT(2);
+    return out;
+  }
+
+  int* p_out = INTEGER(out);
+
+  R_xlen_t size = Rf_xlength(out);
+
+  for (R_xlen_t i = 0; i < size; ++i) {
+    if (p_out[i] == NA_INTEGER) {
+      continue;
+    }
+
+    struct warp_components components = days_to_components(p_out[i]);
+
+    p_out[i] = components.year_offset;
+  }
+
   UNPROTECT(1);
   return out;
 }
@@ -81,8 +108,30 @@ SEXP get_month_offset(SEXP x) {
 }
 
 static SEXP posixct_get_month_offset(SEXP x) {
-  x = PROTECT(as_posixlt_from_posixct(x));
-  SEXP out = posixlt_get_month_offset(x);
+  SEXP out = PROTECT(posixct_get_local_days(x));
+
+  // Fall back to R when the time zone can't be resolved natively
+  if (out == R_NilValue) {
+    x = PROTECT(as_posixlt_from_posixct(x));
+    out = posixlt_get_month_offset(x);
+    UNPROTECT(2);
+    return out;
+  }
+
+  int* p_out = INTEGER(out);
+
+  R_xlen_t size = Rf_xlength(out);
+
+  for (R_xlen_t i = 0; i < size; ++i) {
+    if (p_out[i] == NA_INTEGER) {
+      continue;
+    }
+
+    struct warp_components components = days_to_components(p_out[i]);
+
+    p_out[i] = components.year_offset * 12 + components.month;
+  }
+
   UNPROTECT(1);
   return out;
 }
@@ -171,9 +220,10 @@ static SEXP dbl_date_get_day_offset(SEXP x) {
   SEXP out = PROTECT(Rf_allocVector(INTSXP, size));
   int* p_out = INTEGER(out);
 
-  // Truncate any fractional pieces towards 0
+  // Truncate any fractional pieces towards 0. Days that don't fit in an
+  // `int` are `NA`.
   for (R_xlen_t i = 0; i < size; ++i) {
-    if (!R_FINITE(p_x[i])) {
+    if (!dbl_date_fits_int(p_x[i])) {
       p_out[i] = NA_INTEGER;
       continue;
     }
@@ -186,9 +236,17 @@ static SEXP dbl_date_get_day_offset(SEXP x) {
 }
 
 static SEXP posixct_get_day_offset(SEXP x) {
-  x = PROTECT(as_posixlt_from_posixct(x));
-  SEXP out = posixlt_get_day_offset(x);
-  UNPROTECT(1);
+  SEXP out = PROTECT(posixct_get_local_days(x));
+
+  // Fall back to R when the time zone can't be resolved natively
+  if (out == R_NilValue) {
+    x = PROTECT(as_posixlt_from_posixct(x));
+    out = posixlt_get_day_offset(x);
+    UNPROTECT(2);
+  } else {
+    UNPROTECT(1);
+  }
+
   return out;
 }
 
@@ -242,9 +300,9 @@ static inline int days_before_year(int year) {
   year -= 1;
 
   int days = year * 365 +
-    int_div(year, 4) -
-    int_div(year, 100) +
-    int_div(year, 400);
+    divider_div(year, &divider_4) -
+    divider_div(year, &divider_100) +
+    divider_div(year, &divider_400);
 
   days -= DAYS_FROM_0001_01_01_TO_EPOCH;
 
@@ -256,6 +314,121 @@ static inline int days_before_year(int year) {
 
 // -----------------------------------------------------------------------------
 
+/*
+ * `posixct_get_local_days()`
+ *
+ * Computes the number of days since 1970-01-01 in the local time of `x`,
+ * without going through POSIXlt. The UTC offset of each element is resolved
+ * from the zoneinfo database through a `warp_zone_cursor`. This is the POSIXct
+ * equivalent of `unclass(<Date>)`, and can be fed straight into
+ * `days_to_components()`.
+ *
+ * Returns `R_NilValue` when the time zone can't be resolved natively, or if
+ * a value falls outside of `WARP_ZONE_SMALLEST_SECONDS` and
+ * `WARP_ZONE_LARGEST_SECONDS`.
+ * The caller is then expected to fall back to `as.POSIXlt()`.
+ */
+
+static SEXP posixct_get_local_days(SEXP x) {
+  struct warp_zone zone;
+
+  SEXP zone_data = PROTECT(warp_zone_load(&zone, get_time_zone(x)));
+
+  if (zone_data == R_NilValue) {
+    UNPROTECT(1);
+    return R_NilValue;
+  }
+
+  R_xlen_t size = Rf_xlength(x);
+
+  SEXP out = PROTECT(Rf_allocVector(INTSXP, size));
+  int* p_out = INTEGER(out);
+
+  struct warp_zone_cursor cursor;
+  warp_zone_cursor_init(&cursor, &zone);
+
+  switch (TYPEOF(x)) {
+  case INTSXP: {
+    const int* p_x = INTEGER_RO(x);
+
+    for (R_xlen_t i = 0; i < size; ++i) {
+      int elt = p_x[i];
+
+      if (elt == NA_INTEGER) {
+        p_out[i] = NA_INTEGER;
+        continue;
+      }
+
+      p_out[i] = warp_zone_cursor_local_days(elt, &cursor);
+    }
+
+    break;
+  }
+  case REALSXP: {
+    const double* p_x = REAL_RO(x);
+
+    for (R_xlen_t i = 0; i < size; ++i) {
+      double elt = p_x[i];
+
+      if (!R_FINITE(elt)) {
+        p_out[i] = NA_INTEGER;
+        continue;
+      }
+
+      if (elt < WARP_ZONE_SMALLEST_SECONDS || elt > WARP_ZONE_LARGEST_SECONDS) {
+        UNPROTECT(2);
+        return R_NilValue;
+      }
+
+      p_out[i] = warp_zone_cursor_local_days(guarded_floor(elt), &cursor);
+    }
+
+    break;
+  }
+  default: {
+    r_error("posixct_get_local_days", "Unknown `POSIXct` type %s.", Rf_type2char(TYPEOF(x)));
+  }
+  }
+
+  UNPROTECT(2);
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+/*
+ * The components of a POSIXct origin require a trip through `as.POSIXlt()`,
+ * so they are cached by the origin's time zone and value. The components are
+ * stored as a raw vector holding the struct.
+ */
+
+static bool posixct_origin_cache_key(char* p_key, const char* kind, SEXP origin) {
+  double value;
+
+  switch (TYPEOF(origin)) {
+  case INTSXP: {
+    const int elt = INTEGER(origin)[0];
+    if (elt == NA_INTEGER) {
+      return false;
+    }
+    value = (double) elt;
+    break;
+  }
+  case REALSXP: {
+    value = REAL(origin)[0];
+    if (!R_FINITE(value)) {
+      return false;
+    }
+    break;
+  }
+  default: return false;
+  }
+
+  return warp_cache_key(p_key, kind, get_time_zone(origin), value);
+}
+
+// -----------------------------------------------------------------------------
+
 static struct warp_yday_components posixct_get_origin_yday_components(SEXP origin);
 static struct warp_yday_components posixlt_get_origin_yday_components(SEXP origin);
 
@@ -277,8 +450,30 @@ struct warp_yday_components get_origin_yday_components(SEXP origin) {
 }
 
 static struct warp_yday_components posixct_get_origin_yday_components(SEXP origin) {
+  struct warp_yday_components out;
+
+  char key[WARP_CACHE_KEY_SIZE];
+  const bool cacheable = posixct_origin_cache_key(key, "yday", origin);
+
+  if (cacheable) {
+    SEXP cached = warp_cache_get(key);
+
+    if (cached != NULL) {
+      memcpy(&out, RAW(cached), sizeof(out));
+      return out;
+    }
+  }
+
   origin = PROTECT(as_posixlt_from_posixct(origin));
-  struct warp_yday_components out = posixlt_get_origin_yday_components(origin);
+  out = posixlt_get_origin_yday_components(origin);
+
+  if (cacheable) {
+    SEXP cached = PROTECT(Rf_allocVector(RAWSXP, sizeof(out)));
+    memcpy(RAW(cached), &out, sizeof(out));
+    warp_cache_set(key, cached);
+    UNPROTECT(1);
+  }
+
   UNPROTECT(1);
   return out;
 }
@@ -342,8 +537,30 @@ struct warp_mday_components get_origin_mday_components(SEXP origin) {
 }
 
 static struct warp_mday_components posixct_get_origin_mday_components(SEXP origin) {
+  struct warp_mday_components out;
+
+  char key[WARP_CACHE_KEY_SIZE];
+  const bool cacheable = posixct_origin_cache_key(key, "mday", origin);
+
+  if (cacheable) {
+    SEXP cached = warp_cache_get(key);
+
+    if (cached != NULL) {
+      memcpy(&out, RAW(cached), sizeof(out));
+      return out;
+    }
+  }
+
   origin = PROTECT(as_posixlt_from_posixct(origin));
-  struct warp_mday_components out = posixlt_get_origin_mday_components(origin);
+  out = posixlt_get_origin_mday_components(origin);
+
+  if (cacheable) {
+    SEXP cached = PROTECT(Rf_allocVector(RAWSXP, sizeof(out)));
+    memcpy(RAW(cached), &out, sizeof(out));
+    warp_cache_set(key, cached);
+    UNPROTECT(1);
+  }
+
   UNPROTECT(1);
   return out;
 }
@@ -4,41 +4,73 @@
 #include <R_ext/Rdynload.h>
 
 /* .Call calls */
-extern SEXP warp_warp_distance(SEXP, SEXP, SEXP, SEXP);
-extern SEXP warp_warp_change(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
-extern SEXP warp_warp_boundary(SEXP, SEXP, SEXP, SEXP);
+extern SEXP warp_warp_distance(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP warp_warp_distances(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP warp_warp_change(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP warp_warp_boundary(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP warp_warp_bucketer(SEXP, SEXP, SEXP);
+extern SEXP warp_warp_bucketer_push(SEXP, SEXP, SEXP);
+extern SEXP warp_warp_clear_cache();
+extern SEXP warp_warp_prepare(SEXP, SEXP, SEXP, SEXP);
+extern SEXP warp_warp_distance_prepared(SEXP, SEXP, SEXP, SEXP);
+extern SEXP warp_warp_stats();
+extern SEXP warp_warp_stats_reset();
+extern SEXP warp_warp_stats_enable(SEXP);
 
 extern SEXP warp_class_type(SEXP);
 extern SEXP warp_date_get_year_offset(SEXP);
 extern SEXP warp_date_get_month_offset(SEXP);
 extern SEXP warp_divmod(SEXP, SEXP);
 extern SEXP warp_div(SEXP, SEXP);
+extern SEXP warp_divider_divmod(SEXP, SEXP);
+extern SEXP warp_is_compact(SEXP);
 
 // Defined below
 SEXP warp_init_library(SEXP);
 
 static const R_CallMethodDef CallEntries[] = {
-  {"warp_warp_distance",         (DL_FUNC) &warp_warp_distance, 4},
-  {"warp_warp_change",           (DL_FUNC) &warp_warp_change, 6},
-  {"warp_warp_boundary",         (DL_FUNC) &warp_warp_boundary, 4},
+  {"warp_warp_distance",         (DL_FUNC) &warp_warp_distance, 8},
+  {"warp_warp_distances",        (DL_FUNC) &warp_warp_distances, 5},
+  {"warp_warp_change",           (DL_FUNC) &warp_warp_change, 8},
+  {"warp_warp_boundary",         (DL_FUNC) &warp_warp_boundary, 6},
+  {"warp_warp_bucketer",         (DL_FUNC) &warp_warp_bucketer, 3},
+  {"warp_warp_bucketer_push",    (DL_FUNC) &warp_warp_bucketer_push, 3},
+  {"warp_warp_clear_cache",      (DL_FUNC) &warp_warp_clear_cache, 0},
+  {"warp_warp_prepare",          (DL_FUNC) &warp_warp_prepare, 4},
+  {"warp_warp_distance_prepared", (DL_FUNC) &warp_warp_distance_prepared, 4},
+  {"warp_warp_stats",            (DL_FUNC) &warp_warp_stats, 0},
+  {"warp_warp_stats_reset",      (DL_FUNC) &warp_warp_stats_reset, 0},
+  {"warp_warp_stats_enable",     (DL_FUNC) &warp_warp_stats_enable, 1},
   {"warp_class_type",            (DL_FUNC) &warp_class_type, 1},
   {"warp_date_get_year_offset",  (DL_FUNC) &warp_date_get_year_offset, 1},
   {"warp_date_get_month_offset", (DL_FUNC) &warp_date_get_month_offset, 1},
   {"warp_divmod",                (DL_FUNC) &warp_divmod, 2},
   {"warp_div",                   (DL_FUNC) &warp_div, 2},
+  {"warp_divider_divmod",        (DL_FUNC) &warp_divider_divmod, 2},
+  {"warp_is_compact",            (DL_FUNC) &warp_is_compact, 1},
   {"warp_init_library",          (DL_FUNC) &warp_init_library, 1},
   {NULL, NULL, 0}
 };
 
+void warp_init_altrep(DllInfo* dll);
+void warp_init_compact(DllInfo* dll);
+
 void R_init_warp(DllInfo *dll)
 {
   R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
   R_useDynamicSymbols(dll, FALSE);
+
+  warp_init_altrep(dll);
+  warp_init_compact(dll);
 }
 
 void warp_init_utils(SEXP ns);
+void warp_init_cache(void);
+void warp_init_stats(void);
 
 SEXP warp_init_library(SEXP ns) {
   warp_init_utils(ns);
+  warp_init_cache();
+  warp_init_stats();
   return R_NilValue;
 }
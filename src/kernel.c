@@ -0,0 +1,81 @@
+#include "kernel.h"
+#include "stats.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * `warp_kernel_run()`
+ *
+ * Runs a distance kernel over `[from, from + size)`, writing the results to
+ * `p_out`. The range is split into fixed size chunks, which keeps the working
+ * set of each chunk in cache. When `threads > 1` and warp was built with
+ * OpenMP support, the chunks are distributed over that many threads.
+ *
+ * Each element of the output only depends on the corresponding element of
+ * the input, and the chunk boundaries don't depend on `threads`, so the
+ * result is identical to the serial computation.
+ *
+ * When statistics are enabled, the time spent in the kernel is recorded.
+ */
+
+// The number of elements processed per chunk. Chunks of doubles are 32kb.
+#define WARP_CHUNK_SIZE 4096
+
+static void kernel_run(const struct warp_kernel* p_kernel,
+                       R_xlen_t from,
+                       R_xlen_t size,
+                       double* p_out,
+                       int threads);
+
+// [[ include("kernel.h") ]]
+void warp_kernel_run(const struct warp_kernel* p_kernel,
+                     R_xlen_t from,
+                     R_xlen_t size,
+                     double* p_out,
+                     int threads) {
+  if (!warp_stats_enabled) {
+    kernel_run(p_kernel, from, size, p_out, threads);
+    return;
+  }
+
+  const double start = warp_stats_now();
+
+  kernel_run(p_kernel, from, size, p_out, threads);
+
+  const double elapsed = warp_stats_now() - start;
+  warp_stats_add("kernel", warp_kernel_name(p_kernel->fn), 1, (double) size, elapsed);
+}
+
+static void kernel_run(const struct warp_kernel* p_kernel,
+                       R_xlen_t from,
+                       R_xlen_t size,
+                       double* p_out,
+                       int threads) {
+  const R_xlen_t n_chunks = (size + WARP_CHUNK_SIZE - 1) / WARP_CHUNK_SIZE;
+
+  if (threads > n_chunks) {
+    threads = (int) n_chunks;
+  }
+
+  if (threads <= 1) {
+    p_kernel->fn(p_kernel, from, size, p_out);
+    return;
+  }
+
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+  for (R_xlen_t i = 0; i < n_chunks; ++i) {
+    const R_xlen_t offset = i * WARP_CHUNK_SIZE;
+    const R_xlen_t remaining = size - offset;
+    const R_xlen_t chunk_size = remaining < WARP_CHUNK_SIZE ? remaining : WARP_CHUNK_SIZE;
+
+    p_kernel->fn(p_kernel, from + offset, chunk_size, p_out + offset);
+  }
+#else
+  p_kernel->fn(p_kernel, from, size, p_out);
+#endif
+}
+
+#undef WARP_CHUNK_SIZE
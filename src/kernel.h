@@ -0,0 +1,180 @@
+#ifndef WARP_KERNEL_H
+#define WARP_KERNEL_H
+
+#include "warp.h"
+#include "zone.h"
+#include "buffer.h"
+#include "divmod.h"
+
+// -----------------------------------------------------------------------------
+
+struct warp_kernel;
+
+/*
+ * A distance kernel computes `size` distances, starting at the 0-based
+ * location `from` of the prepared input, and writes them to `p_out`.
+ *
+ * Kernels must never call the R API. Everything that requires R, such as
+ * origin resolution, time zone lookup, and input validation, happens up front
+ * in `warp_kernel_init()`. This makes it safe to run disjoint ranges of the
+ * same kernel concurrently.
+ */
+typedef void (*warp_kernel_fn)(const struct warp_kernel* p_kernel,
+                               R_xlen_t from,
+                               R_xlen_t size,
+                               double* p_out);
+
+/*
+ * Precomputed origin information for the `"yday"` kernels
+ */
+struct warp_yday_info {
+  int units_in_leap_year;
+  int units_in_non_leap_year;
+  int origin_year_offset;
+  int origin_yday;
+  bool origin_leap;
+  int leap_years_before_and_including_origin_year;
+};
+
+/*
+ * Precomputed origin information for the `"mday"` kernels
+ */
+struct warp_mday_info {
+  int units_per_month_leap_year[12];
+  int units_per_month_non_leap_year[12];
+  int units_per_year_leap_year;
+  int units_per_year_non_leap_year;
+  int origin_year_offset;
+  int units_up_to_origin_month;
+  int leap_years_before_and_including_origin_year;
+};
+
+/*
+ * Precomputed information for the narrow fixed width kernels, which compute
+ * `floor((x - offset) * scale / divisor)` entirely in `int` arithmetic. They
+ * are selected over `wide` by a range scan of the input, see
+ * `kernel_select_narrow()` in `distance.c`.
+ */
+struct warp_narrow_info {
+  warp_kernel_fn wide;
+  int offset;
+  int scale;
+  struct warp_divider divider;
+};
+
+/*
+ * The check that new input has to pass before a kernel can be pointed at it
+ * with `warp_kernel_bind()`, mirroring the checks of `warp_kernel_init()`.
+ */
+enum warp_kernel_check {
+  warp_kernel_check_none,
+  warp_kernel_check_days,
+  warp_kernel_check_local_days,
+  warp_kernel_check_narrow
+};
+
+/*
+ * @member fn
+ *   The kernel to run.
+ * @member size
+ *   The size of the input.
+ * @member every
+ *   The number of periods to group together.
+ * @member every_divider
+ *   A fast divider for `every`.
+ * @member needs_every
+ *   Whether or not `every` is something other than `1`.
+ * @member needs_offset
+ *   Whether or not `origin_offset` should be subtracted.
+ * @member origin_offset
+ *   The origin, in the units of the kernel before `every` is applied.
+ * @member p_int, p_dbl
+ *   The input for kernels working on a single vector.
+ * @member p_year, p_month, p_day, p_yday
+ *   The input for kernels working on POSIXlt fields.
+ * @member p_hour, p_minute, p_second, p_gmtoff
+ *   The time of day fields of POSIXlt input, for the sub-daily kernels.
+ *   `p_gmtoff` is `NULL` when every element has the UTC offset `gmtoff`.
+ * @member zone
+ *   The time zone of POSIXct input that is converted to local days natively.
+ * @member check
+ *   The check required by `warp_kernel_bind()`.
+ * @member narrow
+ *   The arithmetic of the narrow fixed width kernels.
+ */
+struct warp_kernel {
+  warp_kernel_fn fn;
+  R_xlen_t size;
+
+  int every;
+  struct warp_divider every_divider;
+  bool needs_every;
+  bool needs_offset;
+  int64_t origin_offset;
+
+  const int* p_int;
+  const double* p_dbl;
+
+  const int* p_year;
+  const int* p_month;
+  const int* p_day;
+  const int* p_yday;
+
+  const int* p_hour;
+  const int* p_minute;
+  const double* p_second;
+  const int* p_gmtoff;
+  int gmtoff;
+
+  struct warp_zone zone;
+  enum warp_kernel_check check;
+
+  struct warp_yday_info yday;
+  struct warp_mday_info mday;
+  struct warp_narrow_info narrow;
+};
+
+SEXP warp_kernel_init(struct warp_kernel* p_kernel,
+                      SEXP x,
+                      enum warp_period_type type,
+                      int every,
+                      SEXP origin,
+                      enum warp_clock_type clock);
+
+bool warp_kernel_bind(struct warp_kernel* p_kernel, SEXP x);
+
+// In `distance.c`
+const char* warp_kernel_name(warp_kernel_fn fn);
+
+// Can the `"yday"` and `"mday"` kernels compute the local days of POSIXct `x`
+// without going through POSIXlt? In `distance.c`.
+bool warp_posixct_has_native_days(SEXP x);
+
+void warp_kernel_run(const struct warp_kernel* p_kernel,
+                     R_xlen_t from,
+                     R_xlen_t size,
+                     double* p_out,
+                     int threads);
+
+// In `distance.c`
+SEXP warp_distance_eager(const struct warp_kernel* p_kernel,
+                         enum warp_output_type output,
+                         int threads);
+
+// In `lazy.c`
+SEXP warp_lazy_distance(const struct warp_kernel* p_kernel,
+                        SEXP shelter,
+                        enum warp_output_type output,
+                        int threads);
+
+// In `change.c`
+bool warp_kernel_is_sorted(const struct warp_kernel* p_kernel, SEXP x);
+
+void warp_change_scan(const struct warp_kernel* p_kernel,
+                      bool last,
+                      bool endpoint,
+                      bool sorted,
+                      int threads,
+                      struct warp_buffer* p_locations);
+
+#endif
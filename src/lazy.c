@@ -0,0 +1,318 @@
+#include "warp.h"
+#include "utils.h"
+#include "kernel.h"
+#include <string.h> // For memcpy()
+#include <stddef.h> // For ptrdiff_t
+#include <limits.h> // For INT_MIN and INT_MAX
+#include <R_ext/Rdynload.h>
+
+/*
+ * `warp_distance(lazy = TRUE)` returns an ALTREP vector that holds on to a
+ * prepared kernel rather than to the distances. `warp_kernel_init()` has
+ * already done all of the validation and R work by the time the vector is
+ * created, so single elements and regions are computed on demand by running
+ * the kernel over just that range. The full distance vector is only computed
+ * and cached when something asks for a pointer to the data.
+ *
+ * - `data1` is a list holding the kernel's shelter and a raw vector with a
+ *   copy of the `struct warp_lazy`. The kernel points into the shelter, which
+ *   R never moves, so the copy stays valid for as long as the vector is alive.
+ *
+ * - `data2` is the materialized distance vector, or `NULL`.
+ *
+ * ALTREP requires R >= 3.5.0. On older versions of R, the distances are
+ * computed eagerly.
+ */
+
+struct warp_lazy {
+  struct warp_kernel kernel;
+  int threads;
+};
+
+#if (R_VERSION >= R_Version(3, 5, 0))
+
+#include <R_ext/Altrep.h>
+
+static R_altrep_class_t warp_lazy_dbl_class;
+static R_altrep_class_t warp_lazy_int_class;
+
+// [[ include("kernel.h") ]]
+SEXP warp_lazy_distance(const struct warp_kernel* p_kernel,
+                        SEXP shelter,
+                        enum warp_output_type output,
+                        int threads) {
+  R_altrep_class_t cls;
+
+  switch (output) {
+  case warp_output_double: cls = warp_lazy_dbl_class; break;
+  case warp_output_integer: cls = warp_lazy_int_class; break;
+  default: r_error("warp_distance", "`lazy = TRUE` can't be used with `output = \"auto\"`.");
+  }
+
+  // The kernel reads from the prepared input, so it must not be modified
+  // in place behind the vector's back
+  for (R_xlen_t i = 0; i < Rf_xlength(shelter); ++i) {
+    SEXP elt = VECTOR_ELT(shelter, i);
+
+    if (elt != R_NilValue) {
+      MARK_NOT_MUTABLE(elt);
+    }
+  }
+
+  SEXP lazy = PROTECT(Rf_allocVector(RAWSXP, sizeof(struct warp_lazy)));
+
+  struct warp_lazy* p_lazy = (struct warp_lazy*) RAW(lazy);
+  p_lazy->kernel = *p_kernel;
+  p_lazy->threads = threads;
+
+  SEXP data1 = PROTECT(Rf_allocVector(VECSXP, 2));
+  SET_VECTOR_ELT(data1, 0, shelter);
+  SET_VECTOR_ELT(data1, 1, lazy);
+
+  SEXP out = R_new_altrep(cls, data1, R_NilValue);
+
+  UNPROTECT(2);
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+static inline const struct warp_lazy* lazy_deref(SEXP x) {
+  return (const struct warp_lazy*) RAW(VECTOR_ELT(R_altrep_data1(x), 1));
+}
+
+static inline SEXP lazy_materialized(SEXP x) {
+  return R_altrep_data2(x);
+}
+
+static R_xlen_t warp_lazy_length(SEXP x) {
+  return lazy_deref(x)->kernel.size;
+}
+
+static Rboolean warp_lazy_inspect(SEXP x,
+                                  int pre,
+                                  int deep,
+                                  int pvec,
+                                  void (*inspect_subtree)(SEXP, int, int, int)) {
+  const bool materialized = lazy_materialized(x) != R_NilValue;
+
+  Rprintf(
+    "warp_lazy_distance (len=%td, materialized=%s)\n",
+    (ptrdiff_t) warp_lazy_length(x),
+    materialized ? "T" : "F"
+  );
+
+  return TRUE;
+}
+
+// -----------------------------------------------------------------------------
+
+static SEXP lazy_materialize_dbl(SEXP x) {
+  SEXP data2 = lazy_materialized(x);
+
+  if (data2 != R_NilValue) {
+    return data2;
+  }
+
+  const struct warp_lazy* p_lazy = lazy_deref(x);
+  const R_xlen_t size = p_lazy->kernel.size;
+
+  data2 = PROTECT(Rf_allocVector(REALSXP, size));
+
+  warp_kernel_run(&p_lazy->kernel, 0, size, REAL(data2), p_lazy->threads);
+
+  R_set_altrep_data2(x, data2);
+
+  UNPROTECT(1);
+  return data2;
+}
+
+static void* warp_lazy_dbl_dataptr(SEXP x, Rboolean writeable) {
+  return REAL(lazy_materialize_dbl(x));
+}
+
+static const void* warp_lazy_dbl_dataptr_or_null(SEXP x) {
+  SEXP data2 = lazy_materialized(x);
+  return data2 == R_NilValue ? NULL : REAL(data2);
+}
+
+static double warp_lazy_dbl_elt(SEXP x, R_xlen_t i) {
+  SEXP data2 = lazy_materialized(x);
+
+  if (data2 != R_NilValue) {
+    return REAL(data2)[i];
+  }
+
+  const struct warp_lazy* p_lazy = lazy_deref(x);
+
+  double out;
+  p_lazy->kernel.fn(&p_lazy->kernel, i, 1, &out);
+
+  return out;
+}
+
+static R_xlen_t warp_lazy_dbl_get_region(SEXP x, R_xlen_t i, R_xlen_t n, double* p_buf) {
+  const R_xlen_t size = warp_lazy_length(x);
+  const R_xlen_t remaining = size - i;
+
+  if (n > remaining) {
+    n = remaining;
+  }
+
+  SEXP data2 = lazy_materialized(x);
+
+  if (data2 != R_NilValue) {
+    memcpy(p_buf, REAL(data2) + i, n * sizeof(double));
+    return n;
+  }
+
+  const struct warp_lazy* p_lazy = lazy_deref(x);
+
+  warp_kernel_run(&p_lazy->kernel, i, n, p_buf, p_lazy->threads);
+
+  return n;
+}
+
+// -----------------------------------------------------------------------------
+
+// The number of distances computed at a time before they are narrowed
+#define WARP_LAZY_BLOCK_SIZE 4096
+
+// Computes the integer distances of `[from, from + n)`. Like
+// `warp_distance(output = "integer")`, it is an error for a distance to not
+// fit in an integer.
+static void lazy_int_fill(const struct warp_lazy* p_lazy, R_xlen_t from, R_xlen_t n, int* p_out) {
+  double block[WARP_LAZY_BLOCK_SIZE];
+
+  for (R_xlen_t offset = 0; offset < n; offset += WARP_LAZY_BLOCK_SIZE) {
+    const R_xlen_t remaining = n - offset;
+    const R_xlen_t block_size = remaining < WARP_LAZY_BLOCK_SIZE ? remaining : WARP_LAZY_BLOCK_SIZE;
+
+    warp_kernel_run(&p_lazy->kernel, from + offset, block_size, block, p_lazy->threads);
+
+    for (R_xlen_t j = 0; j < block_size; ++j) {
+      const double elt = block[j];
+
+      if (isnan(elt)) {
+        p_out[offset + j] = NA_INTEGER;
+        continue;
+      }
+
+      if (elt <= INT_MIN || elt > INT_MAX) {
+        r_error(
+          "warp_distance",
+          "Distance %.0f at location %td can't be represented as an integer. Use `output = \"double\"`.",
+          elt,
+          (ptrdiff_t) (from + offset + j + 1)
+        );
+      }
+
+      p_out[offset + j] = (int) elt;
+    }
+  }
+}
+
+#undef WARP_LAZY_BLOCK_SIZE
+
+static SEXP lazy_materialize_int(SEXP x) {
+  SEXP data2 = lazy_materialized(x);
+
+  if (data2 != R_NilValue) {
+    return data2;
+  }
+
+  const struct warp_lazy* p_lazy = lazy_deref(x);
+  const R_xlen_t size = p_lazy->kernel.size;
+
+  data2 = PROTECT(Rf_allocVector(INTSXP, size));
+
+  lazy_int_fill(p_lazy, 0, size, INTEGER(data2));
+
+  R_set_altrep_data2(x, data2);
+
+  UNPROTECT(1);
+  return data2;
+}
+
+static void* warp_lazy_int_dataptr(SEXP x, Rboolean writeable) {
+  return INTEGER(lazy_materialize_int(x));
+}
+
+static const void* warp_lazy_int_dataptr_or_null(SEXP x) {
+  SEXP data2 = lazy_materialized(x);
+  return data2 == R_NilValue ? NULL : INTEGER(data2);
+}
+
+static int warp_lazy_int_elt(SEXP x, R_xlen_t i) {
+  SEXP data2 = lazy_materialized(x);
+
+  if (data2 != R_NilValue) {
+    return INTEGER(data2)[i];
+  }
+
+  int out;
+  lazy_int_fill(lazy_deref(x), i, 1, &out);
+
+  return out;
+}
+
+static R_xlen_t warp_lazy_int_get_region(SEXP x, R_xlen_t i, R_xlen_t n, int* p_buf) {
+  const R_xlen_t size = warp_lazy_length(x);
+  const R_xlen_t remaining = size - i;
+
+  if (n > remaining) {
+    n = remaining;
+  }
+
+  SEXP data2 = lazy_materialized(x);
+
+  if (data2 != R_NilValue) {
+    memcpy(p_buf, INTEGER(data2) + i, n * sizeof(int));
+    return n;
+  }
+
+  lazy_int_fill(lazy_deref(x), i, n, p_buf);
+
+  return n;
+}
+
+// -----------------------------------------------------------------------------
+
+void warp_init_altrep(DllInfo* dll) {
+  warp_lazy_dbl_class = R_make_altreal_class("warp_lazy_distance_dbl", "warp", dll);
+
+  R_set_altrep_Length_method(warp_lazy_dbl_class, warp_lazy_length);
+  R_set_altrep_Inspect_method(warp_lazy_dbl_class, warp_lazy_inspect);
+  R_set_altvec_Dataptr_method(warp_lazy_dbl_class, warp_lazy_dbl_dataptr);
+  R_set_altvec_Dataptr_or_null_method(warp_lazy_dbl_class, warp_lazy_dbl_dataptr_or_null);
+  R_set_altreal_Elt_method(warp_lazy_dbl_class, warp_lazy_dbl_elt);
+  R_set_altreal_Get_region_method(warp_lazy_dbl_class, warp_lazy_dbl_get_region);
+
+  warp_lazy_int_class = R_make_altinteger_class("warp_lazy_distance_int", "warp", dll);
+
+  R_set_altrep_Length_method(warp_lazy_int_class, warp_lazy_length);
+  R_set_altrep_Inspect_method(warp_lazy_int_class, warp_lazy_inspect);
+  R_set_altvec_Dataptr_method(warp_lazy_int_class, warp_lazy_int_dataptr);
+  R_set_altvec_Dataptr_or_null_method(warp_lazy_int_class, warp_lazy_int_dataptr_or_null);
+  R_set_altinteger_Elt_method(warp_lazy_int_class, warp_lazy_int_elt);
+  R_set_altinteger_Get_region_method(warp_lazy_int_class, warp_lazy_int_get_region);
+}
+
+#else
+
+// [[ include("kernel.h") ]]
+SEXP warp_lazy_distance(const struct warp_kernel* p_kernel,
+                        SEXP shelter,
+                        enum warp_output_type output,
+                        int threads) {
+  if (output == warp_output_auto) {
+    r_error("warp_distance", "`lazy = TRUE` can't be used with `output = \"auto\"`.");
+  }
+
+  return warp_distance_eager(p_kernel, output, threads);
+}
+
+void warp_init_altrep(DllInfo* dll) {
+}
+
+#endif
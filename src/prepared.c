@@ -0,0 +1,177 @@
+#include "warp.h"
+#include "utils.h"
+#include "kernel.h"
+#include <stdlib.h> // For getenv()
+
+// -----------------------------------------------------------------------------
+
+/*
+ * A prepared handle front loads the fixed cost of `warp_distance()` for
+ * callers that compute the distances of many small inputs with the same
+ * period, `every`, `origin`, class, and time zone, such as the windows of a
+ * sliding aggregation. For inputs of a few elements, parsing the period,
+ * validating the arguments, and resolving the origin and time zone cost far
+ * more than the kernel itself.
+ *
+ * `warp_prepare()` initializes a kernel for a zero-length prototype of the
+ * expected input, and keeps it in the handle. `warp_distance_prepared()`
+ * points a copy of that kernel at `x` with `warp_kernel_bind()`, and runs
+ * it. Input that the prepared kernel can't be pointed at, like input of
+ * another class or time zone, or input that has to be converted through R
+ * first, such as POSIXlt, goes through the regular `warp_distance()` path,
+ * so the result is always the same as `warp_distance()`.
+ *
+ * Local time is resolved when the handle is prepared. The value of the `TZ`
+ * environment variable is recorded, and the prepared kernel is only used
+ * while it hasn't changed.
+ *
+ * @member kernel
+ *   The kernel initialized for the prototype.
+ * @member type, every
+ *   The period and the number of periods to group together.
+ * @member class_type, storage
+ *   The class and storage type that input must have to use `kernel`.
+ * @member bindable
+ *   Whether or not `kernel` reads the prototype directly, rather than a
+ *   converted version of it. If not, `kernel` is never used.
+ */
+struct warp_prepared {
+  struct warp_kernel kernel;
+  enum warp_period_type type;
+  int every;
+  enum warp_class_type class_type;
+  SEXPTYPE storage;
+  bool bindable;
+};
+
+#define PREPARED_RAW 0
+#define PREPARED_ORIGIN 1
+#define PREPARED_PROTOTYPE 2
+#define PREPARED_SHELTER 3
+#define PREPARED_TZ_ENV 4
+
+static SEXP current_tz_env(void);
+
+// [[ register() ]]
+SEXP warp_warp_prepare(SEXP period, SEXP every, SEXP origin, SEXP prototype) {
+  enum warp_period_type type = as_period_type(period);
+  int every_ = pull_every(every);
+
+  SEXP raw = PROTECT(Rf_allocVector(RAWSXP, sizeof(struct warp_prepared)));
+  struct warp_prepared* p_prepared = (struct warp_prepared*) RAW(raw);
+
+  // Protect the shelter owning the kernel's memory
+  SEXP shelter = PROTECT(warp_kernel_init(&p_prepared->kernel, prototype, type, every_, origin, warp_clock_elapsed));
+
+  p_prepared->type = type;
+  p_prepared->every = every_;
+  p_prepared->class_type = time_class_type(prototype);
+  p_prepared->storage = TYPEOF(prototype);
+  p_prepared->bindable = VECTOR_ELT(shelter, 0) == prototype;
+
+  SEXP prot = PROTECT(Rf_allocVector(VECSXP, 5));
+  SET_VECTOR_ELT(prot, PREPARED_RAW, raw);
+  SET_VECTOR_ELT(prot, PREPARED_ORIGIN, origin);
+  SET_VECTOR_ELT(prot, PREPARED_PROTOTYPE, prototype);
+  SET_VECTOR_ELT(prot, PREPARED_SHELTER, shelter);
+  SET_VECTOR_ELT(prot, PREPARED_TZ_ENV, current_tz_env());
+
+  SEXP out = PROTECT(R_MakeExternalPtr(p_prepared, R_NilValue, prot));
+  Rf_setAttrib(out, R_ClassSymbol, classes_warp_prepared);
+
+  UNPROTECT(4);
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+static const struct warp_prepared* prepared_deref(SEXP prepared);
+static bool prepared_can_bind(const struct warp_prepared* p_prepared, SEXP prot, SEXP x);
+
+// [[ register() ]]
+SEXP warp_warp_distance_prepared(SEXP prepared, SEXP x, SEXP output, SEXP threads) {
+  const struct warp_prepared* p_prepared = prepared_deref(prepared);
+  enum warp_output_type output_ = as_output_type(output);
+  int threads_ = pull_threads(threads);
+
+  SEXP prot = R_ExternalPtrProtected(prepared);
+
+  if (prepared_can_bind(p_prepared, prot, x)) {
+    struct warp_kernel kernel = p_prepared->kernel;
+
+    if (warp_kernel_bind(&kernel, x)) {
+      return warp_distance_eager(&kernel, output_, threads_);
+    }
+  }
+
+  SEXP origin = VECTOR_ELT(prot, PREPARED_ORIGIN);
+
+  return warp_distance(x, p_prepared->type, p_prepared->every, origin, warp_clock_elapsed, output_, false, threads_);
+}
+
+// -----------------------------------------------------------------------------
+
+static const struct warp_prepared* prepared_deref(SEXP prepared) {
+  if (TYPEOF(prepared) != EXTPTRSXP || !Rf_inherits(prepared, "warp_prepared")) {
+    r_error("prepared_deref", "`prepared` must be created by `warp_prepare()`.");
+  }
+
+  const struct warp_prepared* p_prepared = (const struct warp_prepared*) R_ExternalPtrAddr(prepared);
+
+  // The address is lost when the handle is serialized
+  if (p_prepared == NULL) {
+    r_error("prepared_deref", "`prepared` is no longer valid. Was it saved and reloaded?");
+  }
+
+  return p_prepared;
+}
+
+static bool prepared_can_bind(const struct warp_prepared* p_prepared, SEXP prot, SEXP x) {
+  if (!p_prepared->bindable) {
+    return false;
+  }
+
+  if (TYPEOF(x) != p_prepared->storage) {
+    return false;
+  }
+
+  if (time_class_type(x) != p_prepared->class_type) {
+    return false;
+  }
+
+  if (p_prepared->class_type != warp_class_posixct) {
+    return true;
+  }
+
+  const char* time_zone = get_time_zone(x);
+  const char* prototype_time_zone = get_time_zone(VECTOR_ELT(prot, PREPARED_PROTOTYPE));
+
+  if (!str_equal(time_zone, prototype_time_zone)) {
+    return false;
+  }
+
+  if (time_zone[0] != '\0') {
+    return true;
+  }
+
+  // Local time also depends on `TZ`
+  SEXP tz_env = STRING_ELT(VECTOR_ELT(prot, PREPARED_TZ_ENV), 0);
+  const char* current = getenv("TZ");
+
+  if (tz_env == NA_STRING || current == NULL) {
+    return tz_env == NA_STRING && current == NULL;
+  }
+
+  return str_equal(CHAR(tz_env), current);
+}
+
+static SEXP current_tz_env(void) {
+  const char* tz_env = getenv("TZ");
+  return Rf_ScalarString(tz_env == NULL ? NA_STRING : Rf_mkChar(tz_env));
+}
+
+#undef PREPARED_RAW
+#undef PREPARED_ORIGIN
+#undef PREPARED_PROTOTYPE
+#undef PREPARED_SHELTER
+#undef PREPARED_TZ_ENV
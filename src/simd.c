@@ -0,0 +1,111 @@
+/*
+ * Vectorized kernels
+ *
+ * GCC won't vectorize `floor()` and `trunc()`, or if-convert the selects that
+ * mask out missing values, unless it may assume that floating point
+ * operations don't trap. warp never inspects the floating point exception
+ * flags, so this changes no results. It has to come before any function
+ * definition, including the inline ones from the headers, and it is the
+ * reason these kernels live in their own file. Clang doesn't need it.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+# pragma GCC optimize ("no-trapping-math")
+#endif
+
+#include "simd.h"
+#include "utils.h"
+#include <float.h> // For DBL_MAX
+#include <math.h>
+
+// -----------------------------------------------------------------------------
+
+/*
+ * `WARP_TARGET_CLONES` compiles a kernel once per instruction set listed,
+ * and the best one for the running CPU is selected when the package is
+ * loaded. The baseline x86-64 instruction set has no vectorized rounding,
+ * so SSE4.1 is the first that vectorizes the whole loop, and AVX2 doubles
+ * its width. This relies on ifunc support, so it is limited to x86-64 Linux.
+ * Elsewhere (like arm64, where NEON is always available) the kernels are
+ * compiled once for the baseline.
+ *
+ * `WARP_SIMD_LOOP` asserts that the loop that follows has no dependencies
+ * between iterations, other than counting inexact elements, which allows it
+ * to be vectorized at `-O2`. It relies on OpenMP SIMD support.
+ */
+
+#if defined(__has_attribute)
+# if __has_attribute(target_clones) && defined(__x86_64__) && defined(__linux__)
+#  define WARP_TARGET_CLONES __attribute__((target_clones("avx2", "sse4.1", "default")))
+# endif
+#endif
+
+#ifndef WARP_TARGET_CLONES
+# define WARP_TARGET_CLONES
+#endif
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+# define WARP_SIMD_LOOP _Pragma("omp simd reduction(+:n_inexact)")
+#else
+# define WARP_SIMD_LOOP
+#endif
+
+// -----------------------------------------------------------------------------
+
+/*
+ * Branch-free fixed width distances for double POSIXct input. This computes
+ * the same thing as the scalar `int64_t` kernels in `distance.c`, but stays
+ * in doubles the whole way:
+ *
+ * - The guarded floor gives a whole number of seconds (or milliseconds).
+ * - The origin is subtracted.
+ * - Flooring the division by the unit, then by `every`, is the same as one
+ *   floor division by their product, the `divisor`.
+ * - Non-finite input is masked to `NA_real_`.
+ *
+ * While the whole numbers and the origin are below `WARP_SIMD_EXACT_LIMIT`,
+ * the subtraction is exact and the rounding error of the division is smaller
+ * than the distance to the next whole quotient, so the results are identical
+ * to the scalar kernels. `+ 0.0` turns a `-0` quotient into `0`, like the
+ * round trip through `int64_t` does.
+ *
+ * Returns `false` if any finite element was too large to be exact, in which
+ * case the output must be recomputed by the scalar kernel. That only happens
+ * hundreds of thousands of years away from the epoch.
+ */
+
+#define DBL_POSIXCT_FIXED_DISTANCE(NAME, TO_UNIT)                       \
+WARP_TARGET_CLONES                                                      \
+bool NAME(const double* p_x,                                            \
+          R_xlen_t size,                                                \
+          double origin,                                                \
+          double divisor,                                               \
+          double* p_out) {                                              \
+  const double na = NA_REAL;                                            \
+  double n_inexact = 0;                                                 \
+                                                                        \
+  WARP_SIMD_LOOP                                                        \
+  for (R_xlen_t i = 0; i < size; ++i) {                                 \
+    const double x_elt = p_x[i];                                        \
+    const bool finite = fabs(x_elt) <= DBL_MAX;                         \
+                                                                        \
+    const double elt = TO_UNIT(x_elt);                                  \
+    const double distance = floor((elt - origin) / divisor) + 0.0;      \
+                                                                        \
+    const bool inexact = fabs(elt) >= WARP_SIMD_EXACT_LIMIT;            \
+    n_inexact += (finite & inexact) ? 1.0 : 0.0;                        \
+                                                                        \
+    p_out[i] = finite ? distance : na;                                  \
+  }                                                                     \
+                                                                        \
+  return n_inexact == 0;                                                \
+}
+
+// [[ include("simd.h") ]]
+DBL_POSIXCT_FIXED_DISTANCE(dbl_posixct_fixed_distance_seconds, dbl_guarded_floor)
+
+// [[ include("simd.h") ]]
+DBL_POSIXCT_FIXED_DISTANCE(dbl_posixct_fixed_distance_milliseconds, dbl_guarded_floor_to_millisecond)
+
+#undef DBL_POSIXCT_FIXED_DISTANCE
+#undef WARP_TARGET_CLONES
+#undef WARP_SIMD_LOOP
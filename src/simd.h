@@ -0,0 +1,27 @@
+#ifndef WARP_SIMD_H
+#define WARP_SIMD_H
+
+#define R_NO_REMAP
+#include <R.h>
+#include <Rinternals.h>
+#include <stdbool.h>
+
+// -----------------------------------------------------------------------------
+
+// While whole numbers of seconds (or milliseconds) and the origin stay below
+// this in magnitude, the vectorized fixed width distances are exact
+#define WARP_SIMD_EXACT_LIMIT 2251799813685248.0 // 2^51
+
+bool dbl_posixct_fixed_distance_seconds(const double* p_x,
+                                        R_xlen_t size,
+                                        double origin,
+                                        double divisor,
+                                        double* p_out);
+
+bool dbl_posixct_fixed_distance_milliseconds(const double* p_x,
+                                             R_xlen_t size,
+                                             double origin,
+                                             double divisor,
+                                             double* p_out);
+
+#endif
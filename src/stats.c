@@ -0,0 +1,191 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI // Avoids clashing with `ERROR` from R
+#include <windows.h> // For QueryPerformanceCounter()
+#else
+#include <time.h> // For clock_gettime()
+#endif
+
+#include "stats.h"
+#include "warp.h"
+#include "utils.h"
+#include <stdlib.h> // For getenv()
+
+/*
+ * Optional statistics on where the time of warp is spent, to find the callers
+ * that fall off of the fast paths. Collection is off by default, and is
+ * turned on with `warp_stats_enable()` or the `WARP_STATS` environment
+ * variable.
+ *
+ * Statistics are accumulated in a table of rows identified by a `kind` and a
+ * `name`:
+ *
+ * - `"setup"`: One call per `warp_kernel_init()`, named after the kernel that
+ *   it selected. The time includes origin and time zone resolution, and any
+ *   callbacks into R that they require.
+ * - `"kernel"`: One call per `warp_kernel_run()`, named after the kernel. The
+ *   time is the time spent in the C loop.
+ * - `"callback"`: One call per dispatch to an R function, such as
+ *   `as.POSIXlt()`, named after the function.
+ * - `"conversion"`: One call per conversion of `x` to the time zone of
+ *   `origin` by `convert_time_zone()`.
+ *
+ * Elements are the size of the input of each call. Rows are only ever added
+ * from the main thread.
+ */
+
+// [[ include("stats.h") ]]
+bool warp_stats_enabled = false;
+
+#define WARP_STATS_SIZE 128
+
+struct warp_stats_row {
+  const char* kind;
+  const char* name;
+  double calls;
+  double elements;
+  double seconds;
+};
+
+static struct warp_stats_row stats_rows[WARP_STATS_SIZE];
+static int stats_size = 0;
+
+// [[ include("stats.h") ]]
+double warp_stats_now(void) {
+#ifdef _WIN32
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+#endif
+}
+
+/*
+ * Adds to the row of `kind` and `name`, creating it if required. Both must
+ * outlive the table, like string literals or the names of symbols.
+ */
+
+// [[ include("stats.h") ]]
+void warp_stats_add(const char* kind,
+                    const char* name,
+                    double calls,
+                    double elements,
+                    double seconds) {
+  struct warp_stats_row* p_row = NULL;
+
+  for (int i = 0; i < stats_size; ++i) {
+    struct warp_stats_row* p_elt = &stats_rows[i];
+
+    if (str_equal(p_elt->name, name) && str_equal(p_elt->kind, kind)) {
+      p_row = p_elt;
+      break;
+    }
+  }
+
+  if (p_row == NULL) {
+    // Far more rows than there are kernels and callbacks
+    if (stats_size == WARP_STATS_SIZE) {
+      return;
+    }
+
+    p_row = &stats_rows[stats_size];
+    ++stats_size;
+
+    p_row->kind = kind;
+    p_row->name = name;
+    p_row->calls = 0;
+    p_row->elements = 0;
+    p_row->seconds = 0;
+  }
+
+  p_row->calls += calls;
+  p_row->elements += elements;
+  p_row->seconds += seconds;
+}
+
+// -----------------------------------------------------------------------------
+
+static SEXP new_stats_df(void);
+
+// [[ register() ]]
+SEXP warp_warp_stats(void) {
+  return new_stats_df();
+}
+
+// [[ register() ]]
+SEXP warp_warp_stats_reset(void) {
+  stats_size = 0;
+  return R_NilValue;
+}
+
+// Returns the previous state
+// [[ register() ]]
+SEXP warp_warp_stats_enable(SEXP enabled) {
+  if (!Rf_isLogical(enabled) || Rf_length(enabled) != 1 || LOGICAL(enabled)[0] == NA_LOGICAL) {
+    r_error("warp_stats_enable", "`enabled` must be a single `TRUE` or `FALSE`.");
+  }
+
+  const bool previous = warp_stats_enabled;
+  warp_stats_enabled = LOGICAL(enabled)[0];
+
+  return Rf_ScalarLogical(previous);
+}
+
+static SEXP new_stats_df(void) {
+  const int size = stats_size;
+
+  SEXP kind = PROTECT(Rf_allocVector(STRSXP, size));
+  SEXP name = PROTECT(Rf_allocVector(STRSXP, size));
+  SEXP calls = PROTECT(Rf_allocVector(REALSXP, size));
+  SEXP elements = PROTECT(Rf_allocVector(REALSXP, size));
+  SEXP seconds = PROTECT(Rf_allocVector(REALSXP, size));
+
+  for (int i = 0; i < size; ++i) {
+    const struct warp_stats_row* p_row = &stats_rows[i];
+
+    SET_STRING_ELT(kind, i, Rf_mkChar(p_row->kind));
+    SET_STRING_ELT(name, i, Rf_mkChar(p_row->name));
+    REAL(calls)[i] = p_row->calls;
+    REAL(elements)[i] = p_row->elements;
+    REAL(seconds)[i] = p_row->seconds;
+  }
+
+  SEXP out = PROTECT(Rf_allocVector(VECSXP, 5));
+  SET_VECTOR_ELT(out, 0, kind);
+  SET_VECTOR_ELT(out, 1, name);
+  SET_VECTOR_ELT(out, 2, calls);
+  SET_VECTOR_ELT(out, 3, elements);
+  SET_VECTOR_ELT(out, 4, seconds);
+
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 5));
+  SET_STRING_ELT(names, 0, Rf_mkChar("kind"));
+  SET_STRING_ELT(names, 1, Rf_mkChar("name"));
+  SET_STRING_ELT(names, 2, Rf_mkChar("calls"));
+  SET_STRING_ELT(names, 3, Rf_mkChar("elements"));
+  SET_STRING_ELT(names, 4, Rf_mkChar("seconds"));
+
+  SEXP row_names = PROTECT(Rf_allocVector(INTSXP, 2));
+  INTEGER(row_names)[0] = NA_INTEGER;
+  INTEGER(row_names)[1] = -size;
+
+  Rf_setAttrib(out, R_NamesSymbol, names);
+  Rf_setAttrib(out, R_ClassSymbol, classes_data_frame);
+  Rf_setAttrib(out, R_RowNamesSymbol, row_names);
+
+  UNPROTECT(8);
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+void warp_init_stats(void) {
+  const char* env = getenv("WARP_STATS");
+  warp_stats_enabled = env != NULL && (str_equal(env, "true") || str_equal(env, "1"));
+}
+
+#undef WARP_STATS_SIZE
@@ -0,0 +1,23 @@
+#ifndef WARP_STATS_H
+#define WARP_STATS_H
+
+#define R_NO_REMAP
+#include <R.h>
+#include <Rinternals.h>
+#include <stdbool.h>
+
+// -----------------------------------------------------------------------------
+
+// Whether or not statistics are being collected. Every call site checks this
+// before doing any work, so collection costs a predictable branch when off.
+extern bool warp_stats_enabled;
+
+double warp_stats_now(void);
+
+void warp_stats_add(const char* kind,
+                    const char* name,
+                    double calls,
+                    double elements,
+                    double seconds);
+
+#endif
@@ -1,5 +1,7 @@
 #include "warp.h"
 #include "utils.h"
+#include "cache.h"
+#include "stats.h"
 
 // -----------------------------------------------------------------------------
 
@@ -49,7 +51,9 @@ const char* get_printable_time_zone(const char* time_zone) {
 // -----------------------------------------------------------------------------
 
 static SEXP make_tzone(const char* time_zone);
+static SEXP origin_epoch_in_time_zone(const char* time_zone);
 
+// The result only depends on the time zone, and is cached
 SEXP get_origin_epoch_in_time_zone(SEXP x) {
   const char* time_zone = get_time_zone(x);
 
@@ -58,6 +62,26 @@ SEXP get_origin_epoch_in_time_zone(SEXP x) {
     return R_NilValue;
   }
 
+  char key[WARP_CACHE_KEY_SIZE];
+
+  if (!warp_cache_key(key, "epoch", time_zone, 0)) {
+    return origin_epoch_in_time_zone(time_zone);
+  }
+
+  SEXP out = warp_cache_get(key);
+
+  if (out != NULL) {
+    return out;
+  }
+
+  out = PROTECT(origin_epoch_in_time_zone(time_zone));
+  warp_cache_set(key, out);
+
+  UNPROTECT(1);
+  return out;
+}
+
+static SEXP origin_epoch_in_time_zone(const char* time_zone) {
   SEXP dummy = PROTECT(Rf_ScalarReal(0));
 
   Rf_setAttrib(dummy, syms_tzone, make_tzone(time_zone));
@@ -124,21 +148,27 @@ SEXP convert_time_zone(SEXP x, SEXP origin) {
     get_printable_time_zone(origin_time_zone)
   );
 
+  const bool stats = warp_stats_enabled;
+  const double start = stats ? warp_stats_now() : 0;
+
   SEXP out = PROTECT(as_datetime(x));
   out = PROTECT(r_maybe_duplicate(out));
 
   // Set to NULL for local time
   if (strlen(origin_time_zone) == 0) {
     Rf_setAttrib(out, syms_tzone, R_NilValue);
-    UNPROTECT(2);
-    return(out);
+  } else {
+    SEXP strings_tzone = PROTECT(Rf_allocVector(STRSXP, 1));
+    SET_STRING_ELT(strings_tzone, 0, Rf_mkChar(origin_time_zone));
+    Rf_setAttrib(out, syms_tzone, strings_tzone);
+    UNPROTECT(1);
   }
 
-  SEXP strings_tzone = PROTECT(Rf_allocVector(STRSXP, 1));
-  SET_STRING_ELT(strings_tzone, 0, Rf_mkChar(origin_time_zone));
-
-  Rf_setAttrib(out, syms_tzone, strings_tzone);
+  if (stats) {
+    const double elapsed = warp_stats_now() - start;
+    warp_stats_add("conversion", "convert_time_zone", 1, (double) Rf_xlength(out), elapsed);
+  }
 
-  UNPROTECT(3);
+  UNPROTECT(2);
   return out;
 }
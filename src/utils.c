@@ -1,5 +1,6 @@
 #include "utils.h"
 #include "divmod.h"
+#include "stats.h"
 
 // -----------------------------------------------------------------------------
 
@@ -19,6 +20,8 @@ SEXP fns_as_date = NULL;
 
 SEXP classes_data_frame = NULL;
 SEXP classes_posixct = NULL;
+SEXP classes_warp_bucketer = NULL;
+SEXP classes_warp_prepared = NULL;
 
 SEXP strings_start_stop = NULL;
 
@@ -141,6 +144,73 @@ bool pull_last(SEXP last) {
 
 // -----------------------------------------------------------------------------
 
+// [[ include("utils.h") ]]
+bool pull_sorted(SEXP sorted) {
+  if (Rf_length(sorted) != 1) {
+    r_error("pull_sorted", "`sorted` must have size 1, not %i", Rf_length(sorted));
+  }
+
+  if (OBJECT(sorted) != 0) {
+    r_error("pull_sorted", "`sorted` must be a bare logical value.");
+  }
+
+  switch (TYPEOF(sorted)) {
+  case LGLSXP: return LOGICAL(sorted)[0];
+  default: r_error("pull_sorted", "`sorted` must be logical, not %s", Rf_type2char(TYPEOF(sorted)));
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+// [[ include("utils.h") ]]
+bool pull_lazy(SEXP lazy) {
+  if (Rf_length(lazy) != 1) {
+    r_error("pull_lazy", "`lazy` must have size 1, not %i", Rf_length(lazy));
+  }
+
+  if (OBJECT(lazy) != 0) {
+    r_error("pull_lazy", "`lazy` must be a bare logical value.");
+  }
+
+  switch (TYPEOF(lazy)) {
+  case LGLSXP: return LOGICAL(lazy)[0];
+  default: r_error("pull_lazy", "`lazy` must be logical, not %s", Rf_type2char(TYPEOF(lazy)));
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+// [[ include("utils.h") ]]
+int pull_threads(SEXP threads) {
+  if (Rf_length(threads) != 1) {
+    r_error("pull_threads", "`threads` must have size 1, not %i", Rf_length(threads));
+  }
+
+  if (OBJECT(threads) != 0) {
+    r_error("pull_threads", "`threads` must be a bare integer-ish value.");
+  }
+
+  int out;
+
+  switch (TYPEOF(threads)) {
+  case INTSXP: out = INTEGER(threads)[0]; break;
+  case REALSXP: out = Rf_asInteger(threads); break;
+  default: r_error("pull_threads", "`threads` must be integer-ish, not %s", Rf_type2char(TYPEOF(threads)));
+  }
+
+  if (out == NA_INTEGER) {
+    r_error("pull_threads", "`threads` must not be `NA`");
+  }
+
+  if (out <= 0) {
+    r_error("pull_threads", "`threads` must be an integer greater than 0, not %i", out);
+  }
+
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
 #define YEARS_FROM_0001_01_01_TO_EPOCH 1969
 #define LEAP_YEARS_FROM_0001_01_01_TO_EPOCH 477
 
@@ -148,9 +218,9 @@ int leap_years_before_and_including_year(int year_offset) {
   int year = year_offset + YEARS_FROM_0001_01_01_TO_EPOCH;
 
   int n_leap_years =
-    int_div(year, 4) -
-    int_div(year, 100) +
-    int_div(year, 400);
+    divider_div(year, &divider_4) -
+    divider_div(year, &divider_100) +
+    divider_div(year, &divider_400);
 
   n_leap_years -= LEAP_YEARS_FROM_0001_01_01_TO_EPOCH;
 
@@ -232,6 +302,48 @@ enum warp_period_type as_period_type(SEXP period) {
   Rf_errorcall(R_NilValue, "Unknown `period` value '%s'.", type);
 }
 
+// [[ include("utils.h") ]]
+enum warp_output_type as_output_type(SEXP output) {
+  if (TYPEOF(output) != STRSXP || Rf_length(output) != 1) {
+    Rf_errorcall(R_NilValue, "`output` must be a single string.");
+  }
+
+  const char* type = CHAR(STRING_ELT(output, 0));
+
+  if (str_equal(type, "double")) {
+    return warp_output_double;
+  }
+
+  if (str_equal(type, "integer")) {
+    return warp_output_integer;
+  }
+
+  if (str_equal(type, "auto")) {
+    return warp_output_auto;
+  }
+
+  Rf_errorcall(R_NilValue, "Unknown `output` value '%s'.", type);
+}
+
+// [[ include("utils.h") ]]
+enum warp_clock_type as_clock_type(SEXP clock) {
+  if (TYPEOF(clock) != STRSXP || Rf_length(clock) != 1) {
+    Rf_errorcall(R_NilValue, "`clock` must be a single string.");
+  }
+
+  const char* type = CHAR(STRING_ELT(clock, 0));
+
+  if (str_equal(type, "elapsed")) {
+    return warp_clock_elapsed;
+  }
+
+  if (str_equal(type, "local")) {
+    return warp_clock_local;
+  }
+
+  Rf_errorcall(R_NilValue, "Unknown `clock` value '%s'.", type);
+}
+
 // -----------------------------------------------------------------------------
 
 #define BUFSIZE 8192
@@ -387,13 +499,31 @@ static SEXP warp_eval_mask_n_impl(SEXP fn, SEXP* syms, SEXP* args, SEXP mask) {
   return out;
 }
 
+// POSIXlt is a list of fields, so its size is the size of its first field
+static R_xlen_t dispatch_size(SEXP x) {
+  if (TYPEOF(x) == VECSXP) {
+    return Rf_xlength(x) == 0 ? 0 : Rf_xlength(VECTOR_ELT(x, 0));
+  }
+
+  return Rf_xlength(x);
+}
+
 SEXP warp_dispatch_n(SEXP fn_sym, SEXP fn, SEXP* syms, SEXP* args) {
+  const bool stats = warp_stats_enabled;
+  const double start = stats ? warp_stats_now() : 0;
+
   // Mask `fn` with `fn_sym`. We dispatch in the global environment.
   SEXP mask = PROTECT(r_new_environment(R_GlobalEnv, 4));
   Rf_defineVar(fn_sym, fn, mask);
 
   SEXP out = warp_eval_mask_n_impl(fn_sym, syms, args, mask);
 
+  // Symbol names live for the rest of the session
+  if (stats) {
+    const double elapsed = warp_stats_now() - start;
+    warp_stats_add("callback", CHAR(PRINTNAME(fn_sym)), 1, (double) dispatch_size(args[0]), elapsed);
+  }
+
   UNPROTECT(1);
   return out;
 }
@@ -463,6 +593,14 @@ void warp_init_utils(SEXP ns) {
   SET_STRING_ELT(classes_posixct, 0, Rf_mkChar("POSIXct"));
   SET_STRING_ELT(classes_posixct, 1, Rf_mkChar("POSIXt"));
 
+  classes_warp_bucketer = Rf_allocVector(STRSXP, 1);
+  R_PreserveObject(classes_warp_bucketer);
+  SET_STRING_ELT(classes_warp_bucketer, 0, Rf_mkChar("warp_bucketer"));
+
+  classes_warp_prepared = Rf_allocVector(STRSXP, 1);
+  R_PreserveObject(classes_warp_prepared);
+  SET_STRING_ELT(classes_warp_prepared, 0, Rf_mkChar("warp_prepared"));
+
   strings_start_stop = Rf_allocVector(STRSXP, 2);
   R_PreserveObject(strings_start_stop);
   SET_STRING_ELT(strings_start_stop, 0, Rf_mkChar("start"));
@@ -6,6 +6,8 @@
 #include <Rinternals.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include "arith.h"
 
 // -----------------------------------------------------------------------------
 
@@ -29,6 +31,25 @@ enum warp_period_type as_period_type(SEXP period);
 
 // -----------------------------------------------------------------------------
 
+enum warp_output_type {
+  warp_output_double,
+  warp_output_integer,
+  warp_output_auto
+};
+
+enum warp_output_type as_output_type(SEXP output);
+
+// -----------------------------------------------------------------------------
+
+enum warp_clock_type {
+  warp_clock_elapsed,
+  warp_clock_local
+};
+
+enum warp_clock_type as_clock_type(SEXP clock);
+
+// -----------------------------------------------------------------------------
+
 enum warp_class_type {
   warp_class_date,
   warp_class_posixct,
@@ -40,24 +61,10 @@ enum warp_class_type time_class_type(SEXP x);
 
 // -----------------------------------------------------------------------------
 
-/*
- * @member year_offset
- *   The year offset. The number of years since 1970.
- * @member month
- *   The month. Mapped to the range of 0-11, where 0 is January.
- * @member day
- *   The day of month. Mapped to the range of 0-30.
- * @member yday
- *   The day of the year. Mapped to the range of 0-365.
- */
-struct warp_components {
-  int year_offset;
-  int month;
-  int day;
-  int yday;
-};
-
-struct warp_components convert_days_to_components(int n);
+// Does the double Date `x` truncate to a non-missing `int`?
+static inline bool dbl_date_fits_int(double x) {
+  return x > (double) INT_MIN && x < (double) INT_MAX + 1;
+}
 
 // -----------------------------------------------------------------------------
 
@@ -84,6 +91,9 @@ struct warp_mday_components date_get_origin_mday_components(SEXP origin);
 int pull_every(SEXP every);
 bool pull_last(SEXP last);
 bool pull_endpoint(SEXP endpoint);
+bool pull_sorted(SEXP sorted);
+bool pull_lazy(SEXP lazy);
+int pull_threads(SEXP threads);
 
 void __attribute__((noreturn)) never_reached(const char* fn);
 void __attribute__((noreturn)) r_error(const char* where, const char* why, ...);
@@ -94,6 +104,8 @@ bool str_equal(const char* x, const char* y);
 
 int leap_years_before_and_including_year(int year_offset);
 
+// -----------------------------------------------------------------------------
+
 SEXP as_posixct_from_posixlt(SEXP x);
 SEXP as_posixlt_from_posixct(SEXP x);
 SEXP as_date(SEXP x);
@@ -111,6 +123,7 @@ SEXP date_get_month_offset(SEXP x);
 SEXP as_datetime(SEXP x);
 
 // In `timezone.c`
+const char* get_time_zone(SEXP x);
 SEXP get_origin_epoch_in_time_zone(SEXP x);
 SEXP convert_time_zone(SEXP x, SEXP origin);
 
@@ -119,6 +132,8 @@ extern SEXP syms_class;
 
 extern SEXP classes_data_frame;
 extern SEXP classes_posixct;
+extern SEXP classes_warp_bucketer;
+extern SEXP classes_warp_prepared;
 
 extern SEXP strings_start_stop;
 
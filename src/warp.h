@@ -12,16 +12,36 @@
 
 // Functionality ------------------------------------------------
 
-SEXP warp_distance(SEXP x, enum warp_period_type type, int every, SEXP origin);
+SEXP warp_distance(SEXP x,
+                   enum warp_period_type type,
+                   int every,
+                   SEXP origin,
+                   enum warp_clock_type clock,
+                   enum warp_output_type output,
+                   bool lazy,
+                   int threads);
+
+SEXP warp_distances(SEXP x,
+                    SEXP periods,
+                    SEXP every,
+                    SEXP origin,
+                    int threads);
 
 SEXP warp_change(SEXP x,
                  enum warp_period_type period,
                  int every,
                  SEXP origin,
                  bool last,
-                 bool endpoint);
-
-SEXP warp_boundary(SEXP x, enum warp_period_type type, int every, SEXP origin);
+                 bool endpoint,
+                 bool sorted,
+                 int threads);
+
+SEXP warp_boundary(SEXP x,
+                   enum warp_period_type type,
+                   int every,
+                   SEXP origin,
+                   bool sorted,
+                   int threads);
 
 // Compatibility ------------------------------------------------
 
@@ -0,0 +1,882 @@
+#include "zone.h"
+#include "utils.h"
+#include "cache.h"
+#include <string.h> // For memcpy()
+#include <ctype.h>
+
+/*
+ * This file implements a minimal reader for the TZif files that make up the
+ * system zoneinfo database (RFC 8536), along with a UTC offset resolver built
+ * on top of it. It allows local civil times to be computed from POSIXct
+ * seconds without round tripping through `as.POSIXlt()`.
+ *
+ * `warp_zone_load()` returns `R_NilValue` whenever the zone can't be resolved
+ * natively (unknown zone, unreadable file, leap second aware zone, or an
+ * unsupported footer rule). Callers are expected to fall back to R in those
+ * cases, which keeps the behavior identical to R's own conversion.
+ */
+
+// -----------------------------------------------------------------------------
+
+#define SECONDS_IN_DAY 86400
+#define SECONDS_IN_HOUR 3600
+
+// -----------------------------------------------------------------------------
+
+static int64_t rule_date_to_days(const struct warp_zone_rule_date* p_date, int64_t year) {
+  int64_t first = days_from_civil64(year, 1, 1);
+
+  switch (p_date->type) {
+  case 'J': {
+    // Julian day 1-365, Feb 29th is never counted
+    int64_t out = first + p_date->day - 1;
+
+    if (p_date->day >= 60 && is_leap_year64(year)) {
+      ++out;
+    }
+
+    return out;
+  }
+  case 'N': {
+    // Zero-based day of the year, Feb 29th is counted
+    return first + p_date->day;
+  }
+  case 'M': {
+    int64_t first_of_month = days_from_civil64(year, p_date->month, 1);
+
+    // 1970-01-01 was a Thursday
+    int wday_of_first = (int) (first_of_month - floor_div64(first_of_month + 4, 7) * 7 + 4);
+
+    int day = p_date->day - wday_of_first;
+    if (day < 0) {
+      day += 7;
+    }
+
+    day += (p_date->week - 1) * 7;
+
+    // Week 5 means "the last `wday` of the month"
+    if (day >= days_in_month64(year, p_date->month)) {
+      day -= 7;
+    }
+
+    return first_of_month + day;
+  }
+  }
+
+  never_reached("rule_date_to_days");
+}
+
+// The UTC seconds at which DST starts and ends in the local `year`
+static void rule_dst_bounds(const struct warp_zone_rule* p_rule,
+                            int64_t year,
+                            int64_t* p_start,
+                            int64_t* p_end) {
+  // Start time is given in local standard time, end time in local DST time
+  *p_start =
+    rule_date_to_days(&p_rule->start, year) * SECONDS_IN_DAY +
+    p_rule->start.time -
+    p_rule->std_offset;
+
+  *p_end =
+    rule_date_to_days(&p_rule->end, year) * SECONDS_IN_DAY +
+    p_rule->end.time -
+    p_rule->dst_offset;
+}
+
+// Rule dates are defined in terms of the local year
+static inline int64_t rule_year(const struct warp_zone_rule* p_rule, int64_t seconds) {
+  int64_t local = seconds + p_rule->std_offset;
+  return days_to_components64(floor_div64(local, SECONDS_IN_DAY)).year_offset + 1970;
+}
+
+static inline bool rule_is_dst(int64_t start, int64_t end, int64_t seconds) {
+  if (start < end) {
+    // Northern hemisphere
+    return start <= seconds && seconds < end;
+  } else {
+    // Southern hemisphere, DST spans the new year
+    return seconds < end || seconds >= start;
+  }
+}
+
+static int rule_offset(const struct warp_zone_rule* p_rule, int64_t seconds) {
+  if (!p_rule->has_dst) {
+    return p_rule->std_offset;
+  }
+
+  int64_t start;
+  int64_t end;
+  rule_dst_bounds(p_rule, rule_year(p_rule, seconds), &start, &end);
+
+  return rule_is_dst(start, end, seconds) ? p_rule->dst_offset : p_rule->std_offset;
+}
+
+/*
+ * Finds the last transition at or before `seconds`, which must be in
+ * `[p_transitions[0], p_transitions[size - 1])`.
+ * Invariant: `p_transitions[lo] <= seconds < p_transitions[hi]`
+ */
+static inline R_xlen_t transition_search(const int64_t* p_transitions,
+                                         R_xlen_t size,
+                                         int64_t seconds) {
+  R_xlen_t lo = 0;
+  R_xlen_t hi = size - 1;
+
+  while (hi - lo > 1) {
+    R_xlen_t mid = lo + (hi - lo) / 2;
+
+    if (p_transitions[mid] <= seconds) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+// [[ include("zone.h") ]]
+int warp_zone_offset(const struct warp_zone* p_zone, int64_t seconds) {
+  const R_xlen_t size = p_zone->size;
+  const int64_t* p_transitions = p_zone->p_transitions;
+
+  if (size == 0) {
+    if (p_zone->has_rule) {
+      return rule_offset(&p_zone->rule, seconds);
+    } else {
+      return p_zone->initial_offset;
+    }
+  }
+
+  if (seconds < p_transitions[0]) {
+    return p_zone->initial_offset;
+  }
+
+  if (seconds >= p_transitions[size - 1]) {
+    if (p_zone->has_rule) {
+      return rule_offset(&p_zone->rule, seconds);
+    } else {
+      return p_zone->p_offsets[size - 1];
+    }
+  }
+
+  return p_zone->p_offsets[transition_search(p_transitions, size, seconds)];
+}
+
+// -----------------------------------------------------------------------------
+
+/*
+ * A cursor remembers the interval `[start, end)` over which the offset of its
+ * last lookup holds, so lookups that fall in the same interval cost two
+ * comparisons. On a miss, the interval following the cached one is tried
+ * before falling back to a binary search, so sorted input advances through
+ * the transitions one at a time. Past the last transition, the interval is
+ * the stretch of the local year between two rule changes.
+ */
+
+static inline void cursor_set(struct warp_zone_cursor* p_cursor,
+                              R_xlen_t index,
+                              int64_t start,
+                              int64_t end,
+                              int offset) {
+  p_cursor->index = index;
+  p_cursor->start = start;
+  p_cursor->end = end;
+  p_cursor->offset = offset;
+}
+
+// `lower` is the start of the rule's validity, the last transition if any
+static int cursor_seek_rule(struct warp_zone_cursor* p_cursor,
+                            const struct warp_zone_rule* p_rule,
+                            R_xlen_t index,
+                            int64_t lower,
+                            int64_t seconds) {
+  if (!p_rule->has_dst) {
+    cursor_set(p_cursor, index, lower, INT64_MAX, p_rule->std_offset);
+    return p_rule->std_offset;
+  }
+
+  const int64_t year = rule_year(p_rule, seconds);
+
+  int64_t dst_start;
+  int64_t dst_end;
+  rule_dst_bounds(p_rule, year, &dst_start, &dst_end);
+
+  // Within a local year, the offset only changes at `dst_start` and `dst_end`
+  int64_t start = days_from_civil64(year, 1, 1) * SECONDS_IN_DAY - p_rule->std_offset;
+  int64_t end = days_from_civil64(year + 1, 1, 1) * SECONDS_IN_DAY - p_rule->std_offset;
+
+  if (start < lower) {
+    start = lower;
+  }
+
+  if (dst_start <= seconds) {
+    start = dst_start > start ? dst_start : start;
+  } else {
+    end = dst_start < end ? dst_start : end;
+  }
+
+  if (dst_end <= seconds) {
+    start = dst_end > start ? dst_end : start;
+  } else {
+    end = dst_end < end ? dst_end : end;
+  }
+
+  const int offset = rule_is_dst(dst_start, dst_end, seconds) ? p_rule->dst_offset : p_rule->std_offset;
+
+  cursor_set(p_cursor, index, start, end, offset);
+  return offset;
+}
+
+// [[ include("zone.h") ]]
+int warp_zone_cursor_seek(struct warp_zone_cursor* p_cursor, int64_t seconds) {
+  const struct warp_zone* p_zone = p_cursor->p_zone;
+  const R_xlen_t size = p_zone->size;
+  const int64_t* p_transitions = p_zone->p_transitions;
+
+  if (size == 0) {
+    if (p_zone->has_rule) {
+      return cursor_seek_rule(p_cursor, &p_zone->rule, -1, INT64_MIN, seconds);
+    }
+
+    cursor_set(p_cursor, -1, INT64_MIN, INT64_MAX, p_zone->initial_offset);
+    return p_zone->initial_offset;
+  }
+
+  if (seconds < p_transitions[0]) {
+    cursor_set(p_cursor, -1, INT64_MIN, p_transitions[0], p_zone->initial_offset);
+    return p_zone->initial_offset;
+  }
+
+  const R_xlen_t last = size - 1;
+
+  if (seconds >= p_transitions[last]) {
+    if (p_zone->has_rule) {
+      return cursor_seek_rule(p_cursor, &p_zone->rule, last, p_transitions[last], seconds);
+    }
+
+    cursor_set(p_cursor, last, p_transitions[last], INT64_MAX, p_zone->p_offsets[last]);
+    return p_zone->p_offsets[last];
+  }
+
+  // Sorted input usually moves on to the next interval
+  R_xlen_t index = p_cursor->index + 1;
+
+  if (index < 0 || index >= last || seconds < p_transitions[index] || seconds >= p_transitions[index + 1]) {
+    index = transition_search(p_transitions, size, seconds);
+  }
+
+  cursor_set(p_cursor, index, p_transitions[index], p_transitions[index + 1], p_zone->p_offsets[index]);
+  return p_zone->p_offsets[index];
+}
+
+// -----------------------------------------------------------------------------
+
+// POSIX TZ string parsing, i.e. `"EST5EDT,M3.2.0,M11.1.0"`
+
+static const char* parse_rule_name(const char* p) {
+  if (*p == '<') {
+    ++p;
+
+    while (*p != '\0' && *p != '>') {
+      ++p;
+    }
+
+    if (*p != '>') {
+      return NULL;
+    }
+
+    return p + 1;
+  }
+
+  const char* start = p;
+
+  while (isalpha((unsigned char) *p)) {
+    ++p;
+  }
+
+  if (p - start < 3) {
+    return NULL;
+  }
+
+  return p;
+}
+
+static const char* parse_rule_number(const char* p, int* p_out, int max) {
+  if (!isdigit((unsigned char) *p)) {
+    return NULL;
+  }
+
+  int out = 0;
+
+  while (isdigit((unsigned char) *p)) {
+    out = out * 10 + (*p - '0');
+
+    if (out > max) {
+      return NULL;
+    }
+
+    ++p;
+  }
+
+  *p_out = out;
+  return p;
+}
+
+// Parses `[+-]hh[:mm[:ss]]` into a number of seconds
+static const char* parse_rule_time(const char* p, int* p_out) {
+  int sign = 1;
+
+  if (*p == '+') {
+    ++p;
+  } else if (*p == '-') {
+    sign = -1;
+    ++p;
+  }
+
+  int hours;
+  int minutes = 0;
+  int seconds = 0;
+
+  // Version 3+ allows hours in the range of [-167, 167]
+  if ((p = parse_rule_number(p, &hours, 167)) == NULL) {
+    return NULL;
+  }
+
+  if (*p == ':') {
+    if ((p = parse_rule_number(p + 1, &minutes, 59)) == NULL) {
+      return NULL;
+    }
+
+    if (*p == ':') {
+      if ((p = parse_rule_number(p + 1, &seconds, 59)) == NULL) {
+        return NULL;
+      }
+    }
+  }
+
+  *p_out = sign * (hours * SECONDS_IN_HOUR + minutes * 60 + seconds);
+  return p;
+}
+
+// POSIX offsets are positive west of UTC, we store them as positive east
+static const char* parse_rule_offset(const char* p, int* p_out) {
+  int offset;
+
+  if ((p = parse_rule_time(p, &offset)) == NULL) {
+    return NULL;
+  }
+
+  *p_out = -offset;
+  return p;
+}
+
+static const char* parse_rule_date(const char* p, struct warp_zone_rule_date* p_date) {
+  if (*p == 'J') {
+    p_date->type = 'J';
+
+    if ((p = parse_rule_number(p + 1, &p_date->day, 365)) == NULL || p_date->day < 1) {
+      return NULL;
+    }
+  } else if (*p == 'M') {
+    p_date->type = 'M';
+
+    if ((p = parse_rule_number(p + 1, &p_date->month, 12)) == NULL || p_date->month < 1) {
+      return NULL;
+    }
+    if (*p != '.') {
+      return NULL;
+    }
+    if ((p = parse_rule_number(p + 1, &p_date->week, 5)) == NULL || p_date->week < 1) {
+      return NULL;
+    }
+    if (*p != '.') {
+      return NULL;
+    }
+    if ((p = parse_rule_number(p + 1, &p_date->day, 6)) == NULL) {
+      return NULL;
+    }
+  } else {
+    p_date->type = 'N';
+
+    if ((p = parse_rule_number(p, &p_date->day, 365)) == NULL) {
+      return NULL;
+    }
+  }
+
+  // Transitions default to 02:00:00 local time
+  p_date->time = 2 * SECONDS_IN_HOUR;
+
+  if (*p == '/') {
+    if ((p = parse_rule_time(p + 1, &p_date->time)) == NULL) {
+      return NULL;
+    }
+  }
+
+  return p;
+}
+
+static bool parse_rule(const char* p, struct warp_zone_rule* p_rule) {
+  if ((p = parse_rule_name(p)) == NULL) {
+    return false;
+  }
+  if ((p = parse_rule_offset(p, &p_rule->std_offset)) == NULL) {
+    return false;
+  }
+
+  if (*p == '\0') {
+    p_rule->has_dst = false;
+    p_rule->dst_offset = p_rule->std_offset;
+    return true;
+  }
+
+  if ((p = parse_rule_name(p)) == NULL) {
+    return false;
+  }
+
+  // DST defaults to 1 hour ahead of standard time
+  p_rule->dst_offset = p_rule->std_offset + SECONDS_IN_HOUR;
+
+  if (*p != '\0' && *p != ',') {
+    if ((p = parse_rule_offset(p, &p_rule->dst_offset)) == NULL) {
+      return false;
+    }
+  }
+
+  p_rule->has_dst = true;
+
+  if (*p == '\0') {
+    // Same default as tzcode, the US rules of `"M3.2.0,M11.1.0"`
+    p_rule->start = (struct warp_zone_rule_date) { 'M', 0, 2, 3, 2 * SECONDS_IN_HOUR };
+    p_rule->end = (struct warp_zone_rule_date) { 'M', 0, 1, 11, 2 * SECONDS_IN_HOUR };
+    return true;
+  }
+
+  if (*p != ',') {
+    return false;
+  }
+  if ((p = parse_rule_date(p + 1, &p_rule->start)) == NULL) {
+    return false;
+  }
+  if (*p != ',') {
+    return false;
+  }
+  if ((p = parse_rule_date(p + 1, &p_rule->end)) == NULL) {
+    return false;
+  }
+
+  return *p == '\0';
+}
+
+// -----------------------------------------------------------------------------
+
+#define TZIF_HEADER_SIZE 44
+#define TZIF_MAX_FILE_SIZE (1 << 20)
+
+static inline int64_t read_int32(const unsigned char* p) {
+  uint32_t out =
+    (uint32_t) p[0] << 24 |
+    (uint32_t) p[1] << 16 |
+    (uint32_t) p[2] << 8 |
+    (uint32_t) p[3];
+
+  return (int32_t) out;
+}
+
+static inline int64_t read_int64(const unsigned char* p) {
+  uint64_t out =
+    (uint64_t) p[0] << 56 |
+    (uint64_t) p[1] << 48 |
+    (uint64_t) p[2] << 40 |
+    (uint64_t) p[3] << 32 |
+    (uint64_t) p[4] << 24 |
+    (uint64_t) p[5] << 16 |
+    (uint64_t) p[6] << 8 |
+    (uint64_t) p[7];
+
+  return (int64_t) out;
+}
+
+struct tzif_header {
+  char version;
+  int64_t isutcnt;
+  int64_t isstdcnt;
+  int64_t leapcnt;
+  int64_t timecnt;
+  int64_t typecnt;
+  int64_t charcnt;
+};
+
+static bool read_tzif_header(const unsigned char* p, R_xlen_t size, struct tzif_header* p_header) {
+  if (size < TZIF_HEADER_SIZE || memcmp(p, "TZif", 4) != 0) {
+    return false;
+  }
+
+  p_header->version = (char) p[4];
+  p_header->isutcnt = read_int32(p + 20);
+  p_header->isstdcnt = read_int32(p + 24);
+  p_header->leapcnt = read_int32(p + 28);
+  p_header->timecnt = read_int32(p + 32);
+  p_header->typecnt = read_int32(p + 36);
+  p_header->charcnt = read_int32(p + 40);
+
+  if (p_header->isutcnt < 0 || p_header->isstdcnt < 0 || p_header->leapcnt < 0 ||
+      p_header->timecnt < 0 || p_header->typecnt < 1 || p_header->charcnt < 0) {
+    return false;
+  }
+
+  return true;
+}
+
+static inline int64_t tzif_data_size(const struct tzif_header* p_header, int64_t time_size) {
+  return
+    p_header->timecnt * time_size +
+    p_header->timecnt +
+    p_header->typecnt * 6 +
+    p_header->charcnt +
+    p_header->leapcnt * (time_size + 4) +
+    p_header->isstdcnt +
+    p_header->isutcnt;
+}
+
+static SEXP new_zone_data(R_xlen_t size, struct warp_zone* p_zone) {
+  SEXP out = PROTECT(Rf_allocVector(RAWSXP, size * (sizeof(int64_t) + sizeof(int))));
+
+  // `RAW()` is aligned for doubles, so the `int64_t` transitions go first
+  int64_t* p_transitions = (int64_t*) RAW(out);
+  int* p_offsets = (int*) (p_transitions + size);
+
+  p_zone->size = size;
+  p_zone->p_transitions = p_transitions;
+  p_zone->p_offsets = p_offsets;
+
+  UNPROTECT(1);
+  return out;
+}
+
+static SEXP parse_tzif(const unsigned char* p, R_xlen_t size, struct warp_zone* p_zone) {
+  struct tzif_header header;
+
+  if (!read_tzif_header(p, size, &header)) {
+    return R_NilValue;
+  }
+
+  int64_t time_size = 4;
+  const unsigned char* p_end = p + size;
+
+  p += TZIF_HEADER_SIZE;
+
+  if (header.version >= '2') {
+    // Skip the version 1 data block and use the 64-bit data block
+    int64_t v1_size = tzif_data_size(&header, 4);
+
+    if (v1_size > p_end - p) {
+      return R_NilValue;
+    }
+
+    p += v1_size;
+
+    if (!read_tzif_header(p, p_end - p, &header)) {
+      return R_NilValue;
+    }
+
+    time_size = 8;
+    p += TZIF_HEADER_SIZE;
+  }
+
+  if (tzif_data_size(&header, time_size) > p_end - p) {
+    return R_NilValue;
+  }
+
+  // Leap second aware zones ("right/") don't match R's POSIXct semantics
+  if (header.leapcnt != 0) {
+    return R_NilValue;
+  }
+
+  const R_xlen_t timecnt = header.timecnt;
+  const int64_t typecnt = header.typecnt;
+
+  const unsigned char* p_times = p;
+  const unsigned char* p_indices = p_times + timecnt * time_size;
+  const unsigned char* p_types = p_indices + timecnt;
+
+  int* p_type_offsets = (int*) R_alloc(typecnt, sizeof(int));
+
+  for (int64_t i = 0; i < typecnt; ++i) {
+    p_type_offsets[i] = (int) read_int32(p_types + i * 6);
+  }
+
+  SEXP out = PROTECT(new_zone_data(timecnt, p_zone));
+
+  int64_t* p_transitions = (int64_t*) p_zone->p_transitions;
+  int* p_offsets = (int*) p_zone->p_offsets;
+
+  for (R_xlen_t i = 0; i < timecnt; ++i) {
+    const unsigned char* p_time = p_times + i * time_size;
+    p_transitions[i] = time_size == 8 ? read_int64(p_time) : read_int32(p_time);
+
+    if (i > 0 && p_transitions[i] <= p_transitions[i - 1]) {
+      UNPROTECT(1);
+      return R_NilValue;
+    }
+
+    int64_t index = p_indices[i];
+
+    if (index >= typecnt) {
+      UNPROTECT(1);
+      return R_NilValue;
+    }
+
+    p_offsets[i] = p_type_offsets[index];
+  }
+
+  // Local time type 0 is used before the first transition
+  p_zone->initial_offset = p_type_offsets[0];
+
+  p_zone->has_rule = false;
+
+  if (time_size == 4) {
+    UNPROTECT(1);
+    return out;
+  }
+
+  // Version 2+ footer, a POSIX TZ string surrounded by newlines. It is used
+  // for all times after the last transition.
+  p += tzif_data_size(&header, time_size);
+
+  if (p >= p_end || *p != '\n') {
+    UNPROTECT(1);
+    return out;
+  }
+
+  const unsigned char* p_footer = ++p;
+
+  while (p < p_end && *p != '\n') {
+    ++p;
+  }
+
+  if (p == p_end) {
+    UNPROTECT(1);
+    return R_NilValue;
+  }
+
+  R_xlen_t footer_size = p - p_footer;
+
+  // Empty footer, the last transition applies forever
+  if (footer_size == 0) {
+    UNPROTECT(1);
+    return out;
+  }
+
+  char* footer = R_alloc(footer_size + 1, sizeof(char));
+  memcpy(footer, p_footer, footer_size);
+  footer[footer_size] = '\0';
+
+  if (!parse_rule(footer, &p_zone->rule)) {
+    UNPROTECT(1);
+    return R_NilValue;
+  }
+
+  p_zone->has_rule = true;
+
+  UNPROTECT(1);
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+
+static const unsigned char* read_file(const char* path, R_xlen_t* p_size) {
+  FILE* file = fopen(path, "rb");
+
+  if (file == NULL) {
+    return NULL;
+  }
+
+  unsigned char* buf = NULL;
+  long size = -1;
+
+  if (fseek(file, 0, SEEK_END) == 0) {
+    size = ftell(file);
+  }
+
+  if (size > 0 && size <= TZIF_MAX_FILE_SIZE && fseek(file, 0, SEEK_SET) == 0) {
+    buf = (unsigned char*) R_alloc(size, sizeof(unsigned char));
+
+    if (fread(buf, 1, size, file) != (size_t) size) {
+      buf = NULL;
+    }
+  }
+
+  fclose(file);
+
+  *p_size = size;
+  return buf;
+}
+
+static SEXP load_tzif_file(const char* path, struct warp_zone* p_zone) {
+  R_xlen_t size;
+  const unsigned char* buf = read_file(path, &size);
+
+  if (buf == NULL) {
+    return R_NilValue;
+  }
+
+  return parse_tzif(buf, size, p_zone);
+}
+
+#define PATH_BUFSIZE 4096
+
+// Search in the same places that R and the system tzcode look in. R's own
+// zoneinfo is preferred because it is what R uses when built with its
+// internal tzcode (i.e. on macOS and Windows).
+static SEXP load_tzif_named(const char* name, struct warp_zone* p_zone) {
+  // Don't allow escaping the zoneinfo directory
+  if (strstr(name, "..") != NULL) {
+    return R_NilValue;
+  }
+
+  if (name[0] == '/') {
+    return load_tzif_file(name, p_zone);
+  }
+
+  const char* r_home = getenv("R_HOME");
+
+  const char* dirs[] = {
+    getenv("TZDIR"),
+    r_home,
+    "/usr/share/zoneinfo",
+    "/usr/lib/zoneinfo",
+    "/usr/share/lib/zoneinfo",
+    "/etc/zoneinfo"
+  };
+
+  const int n_dirs = sizeof(dirs) / sizeof(dirs[0]);
+
+  char path[PATH_BUFSIZE];
+
+  for (int i = 0; i < n_dirs; ++i) {
+    const char* dir = dirs[i];
+
+    if (dir == NULL || dir[0] == '\0') {
+      continue;
+    }
+
+    const char* fmt = (dir == r_home) ? "%s/share/zoneinfo/%s" : "%s/%s";
+
+    int n = snprintf(path, PATH_BUFSIZE, fmt, dir, name);
+
+    if (n < 0 || n >= PATH_BUFSIZE) {
+      continue;
+    }
+
+    SEXP out = load_tzif_file(path, p_zone);
+
+    if (out != R_NilValue) {
+      return out;
+    }
+  }
+
+  return R_NilValue;
+}
+
+#undef PATH_BUFSIZE
+
+static SEXP load_utc(struct warp_zone* p_zone) {
+  SEXP out = new_zone_data(0, p_zone);
+  p_zone->initial_offset = 0;
+  p_zone->has_rule = false;
+  return out;
+}
+
+/*
+ * `warp_zone_load()`
+ *
+ * Load the transition data for `time_zone`, a time zone name as found in the
+ * `tzone` attribute of a POSIXct. `""` means local time, which is resolved
+ * through the `TZ` environment variable, and then `/etc/localtime`.
+ *
+ * Returns a raw vector that owns the transition data pointed to by `p_zone`.
+ * It must be protected for as long as `p_zone` is in use. Returns
+ * `R_NilValue` if the zone can't be resolved natively.
+ *
+ * Loaded zones are cached, so each zone is only read from disk once per
+ * session. The cached transition data is shared, and must not be modified.
+ */
+
+static SEXP zone_load(struct warp_zone* p_zone, const char* time_zone);
+
+// [[ include("zone.h") ]]
+SEXP warp_zone_load(struct warp_zone* p_zone, const char* time_zone) {
+  char key[WARP_CACHE_KEY_SIZE];
+  const bool cacheable = warp_cache_key(key, "zone", time_zone, 0);
+
+  if (cacheable) {
+    SEXP cached = warp_cache_get(key);
+
+    if (cached != NULL) {
+      if (cached == R_NilValue) {
+        return R_NilValue;
+      }
+
+      memcpy(p_zone, RAW(VECTOR_ELT(cached, 1)), sizeof(struct warp_zone));
+      return VECTOR_ELT(cached, 0);
+    }
+  }
+
+  SEXP out = PROTECT(zone_load(p_zone, time_zone));
+
+  if (!cacheable) {
+    UNPROTECT(1);
+    return out;
+  }
+
+  if (out == R_NilValue) {
+    warp_cache_set(key, R_NilValue);
+    UNPROTECT(1);
+    return out;
+  }
+
+  // The transition data, and the zone that points into it
+  SEXP entry = PROTECT(Rf_allocVector(VECSXP, 2));
+  SET_VECTOR_ELT(entry, 0, out);
+
+  SEXP zone = Rf_allocVector(RAWSXP, sizeof(struct warp_zone));
+  SET_VECTOR_ELT(entry, 1, zone);
+  memcpy(RAW(zone), p_zone, sizeof(struct warp_zone));
+
+  warp_cache_set(key, entry);
+
+  UNPROTECT(2);
+  return out;
+}
+
+static SEXP zone_load(struct warp_zone* p_zone, const char* time_zone) {
+  if (time_zone[0] == '\0') {
+    time_zone = getenv("TZ");
+
+    if (time_zone == NULL) {
+      return load_tzif_file("/etc/localtime", p_zone);
+    }
+
+    // An empty `TZ` is UTC
+    if (time_zone[0] == '\0') {
+      return load_utc(p_zone);
+    }
+  }
+
+  // POSIX allows `TZ=":America/New_York"`
+  if (time_zone[0] == ':') {
+    ++time_zone;
+  }
+
+  if (str_equal(time_zone, "UTC") || str_equal(time_zone, "GMT")) {
+    return load_utc(p_zone);
+  }
+
+  return load_tzif_named(time_zone, p_zone);
+}
+
+#undef SECONDS_IN_DAY
+#undef SECONDS_IN_HOUR
+#undef TZIF_HEADER_SIZE
+#undef TZIF_MAX_FILE_SIZE
@@ -0,0 +1,155 @@
+#ifndef WARP_ZONE_H
+#define WARP_ZONE_H
+
+#define R_NO_REMAP
+#include <R.h>
+#include <Rinternals.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+
+// -----------------------------------------------------------------------------
+
+/*
+ * A POSIX TZ rule date, as found in the footer of version 2+ TZif files.
+ *
+ * @member type
+ *   One of `'J'` (1-based Julian day, never counting Feb 29th),
+ *   `'N'` (0-based day of the year, counting Feb 29th), or
+ *   `'M'` (`month.week.wday` format).
+ * @member day
+ *   The Julian day, the day of the year, or the week day (0 is Sunday),
+ *   depending on `type`.
+ * @member week
+ *   The week of the month, 1-5, where 5 means "the last". Only for `'M'`.
+ * @member month
+ *   The month, 1-12. Only for `'M'`.
+ * @member time
+ *   The local time of day, in seconds, at which the transition happens.
+ */
+struct warp_zone_rule_date {
+  char type;
+  int day;
+  int week;
+  int month;
+  int time;
+};
+
+/*
+ * @member std_offset
+ *   The UTC offset of standard time, in seconds east of UTC.
+ * @member dst_offset
+ *   The UTC offset of daylight saving time, in seconds east of UTC.
+ * @member has_dst
+ *   Whether or not the rule ever switches to daylight saving time.
+ */
+struct warp_zone_rule {
+  int std_offset;
+  int dst_offset;
+  bool has_dst;
+  struct warp_zone_rule_date start;
+  struct warp_zone_rule_date end;
+};
+
+/*
+ * @member size
+ *   The number of transitions.
+ * @member p_transitions
+ *   The transition times, in seconds since the epoch, in increasing order.
+ * @member p_offsets
+ *   The UTC offset, in seconds east of UTC, that is in effect starting
+ *   at the corresponding transition time.
+ * @member initial_offset
+ *   The UTC offset in effect before the first transition.
+ * @member has_rule
+ *   Whether or not `rule` should be used after the last transition.
+ */
+struct warp_zone {
+  R_xlen_t size;
+  const int64_t* p_transitions;
+  const int* p_offsets;
+  int initial_offset;
+  bool has_rule;
+  struct warp_zone_rule rule;
+};
+
+SEXP warp_zone_load(struct warp_zone* p_zone, const char* time_zone);
+int warp_zone_offset(const struct warp_zone* p_zone, int64_t seconds);
+
+// -----------------------------------------------------------------------------
+
+/*
+ * A cursor over the transitions of a zone, for looking up the offsets of
+ * many values in a row. Lookups that fall in the same offset interval as the
+ * previous one are O(1), and sorted input advances through the transitions
+ * without searching. A cursor is cheap to create, and isn't shared between
+ * threads.
+ *
+ * @member p_zone
+ *   The zone being looked up.
+ * @member index
+ *   The transition that starts the cached interval, `-1` if it starts before
+ *   the first transition, or `-2` if nothing is cached yet.
+ * @member start, end
+ *   The cached interval, `[start, end)`, in seconds since the epoch.
+ * @member offset
+ *   The UTC offset in effect over the cached interval.
+ */
+struct warp_zone_cursor {
+  const struct warp_zone* p_zone;
+  R_xlen_t index;
+  int64_t start;
+  int64_t end;
+  int offset;
+};
+
+int warp_zone_cursor_seek(struct warp_zone_cursor* p_cursor, int64_t seconds);
+
+static inline void warp_zone_cursor_init(struct warp_zone_cursor* p_cursor,
+                                         const struct warp_zone* p_zone) {
+  p_cursor->p_zone = p_zone;
+  p_cursor->index = -2;
+  p_cursor->start = 0;
+  p_cursor->end = 0;
+  p_cursor->offset = 0;
+}
+
+// Same result as `warp_zone_offset()`
+static inline int warp_zone_cursor_offset(struct warp_zone_cursor* p_cursor, int64_t seconds) {
+  if (p_cursor->start <= seconds && seconds < p_cursor->end) {
+    return p_cursor->offset;
+  }
+
+  return warp_zone_cursor_seek(p_cursor, seconds);
+}
+
+// -----------------------------------------------------------------------------
+
+// The range of POSIXct seconds whose local day is handled by the `int` day
+// arithmetic of the POSIXct kernels, with room to spare for the origin.
+// Doubles should be checked against this before anything is cast to
+// `int64_t`.
+#define WARP_ZONE_SMALLEST_SECONDS (((double) INT_MIN + 1 + 11323 + 1) * 86400)
+#define WARP_ZONE_LARGEST_SECONDS (((double) INT_MAX - 1) * 86400)
+
+static inline int zone_local_seconds_to_days(int64_t local) {
+  int64_t days = local / 86400;
+
+  if (local % 86400 < 0) {
+    --days;
+  }
+
+  return (int) days;
+}
+
+// The number of days since 1970-01-01 in the local time of `p_zone`
+static inline int warp_zone_local_days(int64_t seconds, const struct warp_zone* p_zone) {
+  return zone_local_seconds_to_days(seconds + warp_zone_offset(p_zone, seconds));
+}
+
+// Same as `warp_zone_local_days()`, through a cursor over the zone
+static inline int warp_zone_cursor_local_days(int64_t seconds, struct warp_zone_cursor* p_cursor) {
+  return zone_local_seconds_to_days(seconds + warp_zone_cursor_offset(p_cursor, seconds));
+}
+
+#endif